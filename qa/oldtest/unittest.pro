@@ -5,6 +5,8 @@ SUBDIRS += \
 	../src/tools/iconset/unittest \
 	../src/widgets/unittest/iconaction \
 	../src/widgets/unittest/richtext \
+	../src/unittest/contactsortkey \
+	../src/unittest/edbsegmentfile \
 	../src/unittest/psiiconset \
 	../src/unittest/psipopup
 
@@ -21,9 +21,14 @@
 #include "alertable.h"
 
 #include <QIcon>
+#include <QList>
 
 #include "alerticon.h"
 
+// alerts are only animated while they can be seen
+static QList<Alertable*> alertables;
+static int alertViews = 0;
+
 /**
  * Class to simplify alert icon plumbing. You'll have to re-implement
  * alertFrameUpdated() in your subclass.
@@ -32,6 +37,7 @@ Alertable::Alertable(QObject* parent)
 	: QObject(parent)
 {
 	alert_ = 0;
+	alertables.append(this);
 }
 
 /**
@@ -40,6 +46,7 @@ Alertable::Alertable(QObject* parent)
 Alertable::~Alertable()
 {
 	setAlert(0);
+	alertables.removeAll(this);
 }
 
 /**
@@ -76,9 +83,41 @@ void Alertable::setAlert(const PsiIcon* icon)
 
 	if (icon) {
 		alert_ = new AlertIcon(icon);
-		alert_->activated(false);
+		if (alertViews > 0)
+			alert_->activated(false);
 
 		// connect(alert_, SIGNAL(pixmapChanged()), SLOT(alertFrameUpdated()));
 		// alertFrameUpdated();
 	}
 }
+
+/**
+ * Tells that one more view which shows the alerts is visible.  Alerts
+ * are animated while there is at least one, each call must be matched
+ * by removeView() once the view is hidden.
+ */
+void Alertable::addView()
+{
+	if (alertViews++ > 0)
+		return;
+
+	foreach(Alertable* a, alertables) {
+		if (a->alert_)
+			a->alert_->activated(false);
+	}
+}
+
+/**
+ * Tells that a view which showed the alerts is hidden now.
+ * \sa addView()
+ */
+void Alertable::removeView()
+{
+	if (alertViews <= 0 || --alertViews > 0)
+		return;
+
+	foreach(Alertable* a, alertables) {
+		if (a->alert_)
+			a->alert_->stop();
+	}
+}
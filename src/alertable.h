@@ -39,6 +39,9 @@ public:
 
 	void setAlert(const PsiIcon* icon);
 
+	static void addView();
+	static void removeView();
+
 private:
 	AlertIcon* alert_;
 };
@@ -75,6 +75,7 @@
 #include "psirichtext.h"
 #include "messageview.h"
 #include "chatview.h"
+#include "eventdb.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -136,10 +137,9 @@ void ChatDlg::init()
 	chatEdit()->installEventFilter(this);
 	chatView()->setDialog(this);
 	chatView()->setSessionData(false, jid().full(), jid().full()); //FIXME fix nick updating
-#ifdef WEBKIT
 	chatView()->setAccount(account());
-#endif
 	chatView()->init();
+	connect(chatView(), SIGNAL(historyRequested(QDateTime,QDateTime)), SLOT(getHistory(QDateTime,QDateTime)));
 
 	// seems its useless hack
 	//connect(chatView(), SIGNAL(selectionChanged()), SLOT(logSelectionChanged())); //
@@ -857,6 +857,49 @@ QString ChatDlg::whoNick(bool local) const
 	return result;
 }
 
+/**
+ * Reloads messages which were trimmed from the chat view.
+ */
+void ChatDlg::getHistory(const QDateTime &first, const QDateTime &last)
+{
+	EDBHandle *h = new EDBHandle(account()->edb());
+	connect(h, SIGNAL(finished()), SLOT(edbFinished()));
+	// the bounds are whole seconds which are part of the range, while
+	// getByDate() leaves its bounds out
+	h->getByDate(jid(), first.addSecs(-1), last.addSecs(1));
+}
+
+void ChatDlg::edbFinished()
+{
+	EDBHandle *h = qobject_cast<EDBHandle*>(sender());
+	if (!h) {
+		return;
+	}
+
+	QList<MessageView> messages;
+	foreach (const EDBItemPtr &item, h->result()) {
+		MessageEvent::Ptr me = item->event().staticCast<MessageEvent>();
+		const Message &m = me->message();
+		bool local = me->originLocal();
+
+		MessageView mv(MessageView::Message);
+		if (PsiOptions::instance()->getOption("options.html.chat.render").toBool() && m.containsHTML()
+				&& !m.html().body().isNull() && !m.html().body().firstChild().isNull()) {
+			mv.setHtml(m.html().toString("span"));
+		} else {
+			mv.setPlainText(m.body());
+		}
+		mv.setMessageId(m.id());
+		mv.setLocal(local);
+		mv.setNick(whoNick(local));
+		mv.setUserId(local?account()->jid().bare():jid().bare());
+		mv.setDateTime(me->timeStamp());
+		messages += mv;
+	}
+	chatView()->prependMessages(messages);
+	h->deleteLater();
+}
+
 void ChatDlg::appendMessage(const Message &m, bool local)
 {
 	if(trackBar_)
@@ -28,6 +28,7 @@
 #include <QResizeEvent>
 #include <QDropEvent>
 #include <QCloseEvent>
+#include <QDateTime>
 
 #include "advwidget.h"
 
@@ -146,6 +147,8 @@ private slots:
 	void addEmoticon(QString text);
 	void initComposing();
 	void setComposing();
+	void getHistory(const QDateTime &first, const QDateTime &last);
+	void edbFinished();
 
 protected slots:
 	void checkComposing();
@@ -28,8 +28,10 @@
 #include "psirichtext.h"
 #include "common.h"
 #include "iconset.h"
+#include "psiaccount.h"
 
 #include <QWidget>
+#include <QTextBlock>
 #include <QTextOption>
 #include <QScrollBar>
 #include <QTimer>
@@ -38,15 +40,21 @@
 
 static const char *informationalColorOpt = "options.ui.look.colors.messages.informational";
 
+// user state of the first block of each message, to trim the scrollback
+static const int messageStartState = 1;
+
 //----------------------------------------------------------------------------
 // ChatView
 //----------------------------------------------------------------------------
 ChatView::ChatView(QWidget *parent)
 	: PsiTextView(parent)
 	, isMuc_(false)
+	, account_(0)
 	, isEncryptionEnabled_(false)
 	, oldTrackBarPosition(0)
 	, dialog_(0)
+	, prependPos_(-1)
+	, historyPending_(false)
 {
 	setWordWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
 
@@ -59,6 +67,7 @@ ChatView::ChatView(QWidget *parent)
 	connect(this, SIGNAL(selectionChanged()), SLOT(autoCopy()));
 	connect(this, SIGNAL(cursorPositionChanged()), SLOT(autoCopy()));
 #endif
+	connect(verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(scrollBarValueChanged(int)));
 
 	useMessageIcons_ = PsiOptions::instance()->getOption("options.ui.chat.use-message-icons").toBool();
 	if (useMessageIcons_) {
@@ -124,6 +133,9 @@ void ChatView::clear()
 {
 	PsiTextView::clear();
 	addLogIconsResources();
+	oldTrackBarPosition = 0;
+	historyPending_ = false;
+	clearScrollback();
 }
 
 void ChatView::contextMenuEvent(QContextMenuEvent *e)
@@ -246,6 +258,11 @@ QString ChatView::colorString(bool local, bool spooled) const
 
 void ChatView::appendText(const QString &text)
 {
+	if (prependPos_ >= 0) {
+		prependText(text);
+		return;
+	}
+
 	bool doScrollToBottom = atBottom();
 
 	// prevent scrolling back to selected text when
@@ -262,13 +279,157 @@ void ChatView::appendText(const QString &text)
 
 void ChatView::dispatchMessage(const MessageView &mv)
 {
+	// the message goes to the last block if it's empty, or to a new one
+	QTextBlock last = document()->lastBlock();
+	QTextBlock first = last.length() <= 1 ? last : QTextBlock();
+
 	if ((mv.type() == MessageView::Message || mv.type() == MessageView::Subject)
 			&& ChatViewCommon::updateLastMsgTime(mv.dateTime()))
 	{
-		QString color = ColorOpt::instance()->color(informationalColorOpt).name();
-		appendText(QString(useMessageIcons_?"<img src=\"icon:log_icon_time\" />":"") +
-				   QString("<font color=\"%1\">*** %2</font>").arg(color).arg(mv.dateTime().date().toString(Qt::ISODate)));
+		renderDate(mv.dateTime().date());
+	}
+	renderMessageView(mv);
+
+	if (!first.isValid()) {
+		first = last.next();
+	}
+	if (first.isValid() && first.length() > 1) {
+		first.setUserState(messageStartState);
+		messageShown(mv.dateTime());
+		trimScrollback();
+	}
+}
+
+/**
+ * Puts older messages from the history before all others, in response to
+ * historyRequested().
+ */
+void ChatView::prependMessages(const QList<MessageView> &messages)
+{
+	if (!historyPending_) {
+		return; // cleared meanwhile
+	}
+	historyPending_ = false;
+	if (messages.isEmpty() || document()->isEmpty()) {
+		return;
+	}
+
+	int scrollbarValue = verticalScrollBar()->value();
+	int scrollbarMaximum = verticalScrollBar()->maximum();
+
+	QList<QDateTime> times;
+	QDate date;
+	prependPos_ = 0;
+	foreach (const MessageView &mv, messages) {
+		int pos = prependPos_;
+		if (mv.dateTime().date() != date) {
+			date = mv.dateTime().date();
+			renderDate(date);
+		}
+		renderMessageView(mv);
+		if (prependPos_ > pos) {
+			document()->findBlock(pos).setUserState(messageStartState);
+			times += mv.dateTime();
+		}
+	}
+	prependPos_ = -1;
+	historyShown(times);
+
+	// keep what the user was looking at in place
+	verticalScrollBar()->setValue(scrollbarValue + verticalScrollBar()->maximum() - scrollbarMaximum);
+}
+
+/**
+ * Inserts a paragraph with \a text at prependPos_, before the block which
+ * is there.
+ */
+void ChatView::prependText(const QString &text)
+{
+	int size = document()->characterCount();
+	QTextCursor cursor(document());
+	cursor.beginEditBlock();
+	cursor.setPosition(prependPos_);
+
+	// the contents of the block move down to a new one, which has to
+	// take its state along
+	int state = cursor.block().userState();
+	cursor.insertBlock();
+	cursor.block().setUserState(state);
+	cursor.setPosition(prependPos_);
+	cursor.setBlockFormat(QTextBlockFormat());
+	cursor.block().setUserState(-1);
+
+	PsiRichText::insertText(document(), cursor, text);
+	cursor.endEditBlock();
+
+	int added = document()->characterCount() - size;
+	prependPos_ += added;
+	if (oldTrackBarPosition) {
+		oldTrackBarPosition += added;
 	}
+}
+
+/**
+ * Removes the oldest messages when there are more than the scrollback
+ * limit, unless the user is scrolled up to read them.
+ */
+void ChatView::trimScrollback()
+{
+	int count = scrollbackTrimCount(isMuc_, account_ && account_->userAccount().opt_log);
+	if (!count || !atBottom()) {
+		return;
+	}
+
+	// find the first message which stays
+	QTextBlock block = document()->begin();
+	for (int n = 0; block.isValid(); block = block.next()) {
+		if (block.userState() == messageStartState && n++ == count) {
+			break;
+		}
+	}
+	if (!block.isValid()) {
+		return;
+	}
+
+	int end = block.position();
+	QTextBlockFormat blockFormat = block.blockFormat();
+	QTextCursor cursor(document());
+	cursor.beginEditBlock();
+	cursor.setPosition(end, QTextCursor::KeepAnchor);
+	cursor.removeSelectedText();
+	cursor.setBlockFormat(blockFormat);
+	cursor.block().setUserState(messageStartState);
+	cursor.endEditBlock();
+
+	oldTrackBarPosition = qMax(0, oldTrackBarPosition - end);
+	messagesTrimmed(count, !isMuc_);
+	scrollToBottom();
+}
+
+void ChatView::scrollBarValueChanged(int value)
+{
+	QScrollBar *bar = verticalScrollBar();
+	if (value > bar->minimum() || bar->maximum() == bar->minimum()
+			|| historyPending_ || prependPos_ >= 0 || isMuc_) {
+		return;
+	}
+
+	QDateTime first, last;
+	if (takeTrimmedPage(&first, &last)) {
+		historyPending_ = true;
+		emit historyRequested(first, last);
+	}
+}
+
+void ChatView::renderDate(const QDate &date)
+{
+	QString color = ColorOpt::instance()->color(informationalColorOpt).name();
+	appendText(QString(useMessageIcons_?"<img src=\"icon:log_icon_time\" />":"") +
+			   QString("<font color=\"%1\">*** %2</font>").arg(color).arg(date.toString(Qt::ISODate)));
+}
+
+void ChatView::renderMessageView(const MessageView &mv)
+{
 	switch (mv.type()) {
 		case MessageView::Message:
 			if (isMuc_) {
@@ -325,7 +486,7 @@ void ChatView::renderMucMessage(const MessageView &mv)
 		}
 	}
 
-	if(mv.isLocal()) {
+	if(mv.isLocal() && prependPos_ < 0) {
 		scrollToBottom();
 	}
 }
@@ -354,7 +515,7 @@ void ChatView::renderMessage(const MessageView &mv)
 		}
 	}
 
-	if (mv.isLocal()) {
+	if (mv.isLocal() && prependPos_ < 0) {
 		deferredScroll();
 	}
 }
@@ -29,6 +29,8 @@
 #include "psitextview.h"
 #include "chatviewcommon.h"
 
+class PsiAccount;
+
 class ChatEdit;
 class ChatViewBase;
 class MessageView;
@@ -51,9 +53,11 @@ public:
 	void init();
 	void setDialog(QWidget* dialog);
 	void setSessionData(bool isMuc, const QString &jid, const QString name);
+	void setAccount(PsiAccount *acc) { account_ = acc; }
 
 	void appendText(const QString &text);
 	void dispatchMessage(const MessageView &);
+	void prependMessages(const QList<MessageView> &);
 	bool handleCopyEvent(QObject *object, QEvent *event, ChatEdit *chatEdit);
 
 	void deferredScroll();
@@ -82,24 +86,40 @@ protected:
 	void renderSubject(const MessageView &);
 	void renderMucSubject(const MessageView &);
 	void renderUrls(const MessageView &);
+	void renderDate(const QDate &);
+	void renderMessageView(const MessageView &);
 
 protected slots:
 	void autoCopy();
 
 private slots:
 	void slotScroll();
+	void scrollBarValueChanged(int);
 
 signals:
 	void showNM(const QString&);
+	/**
+	 * Emitted when the user scrolled up to messages which were trimmed,
+	 * prependMessages() should be called with the messages between
+	 * \a first and \a last from the history.
+	 */
+	void historyRequested(const QDateTime &first, const QDateTime &last);
+
+private:
+	void prependText(const QString &text);
+	void trimScrollback();
 
 private:
 	bool isMuc_;
+	PsiAccount *account_;
 	bool isEncryptionEnabled_;
 	QString jid_;
 	QString name_;
 	int  oldTrackBarPosition;
 	QPointer<QWidget> dialog_;
 	bool useMessageIcons_;
+	int prependPos_; // where prependMessages() puts the next text, or -1
+	bool historyPending_;
 
 	QPixmap logIconSend;
 	QPixmap logIconReceive;
@@ -32,6 +32,7 @@
 #include <QPalette>
 #include <QDesktopWidget>
 #include <QApplication>
+#include <QTimer>
 
 #include "webview.h"
 //#include "psiapplication.h"
@@ -95,6 +96,16 @@ public slots:
 		emit inited();
 	}
 
+	void messagesTrimmed(int count)
+	{
+		_view->messagesTrimmed(count, !_view->isMuc_);
+	}
+
+	void scrolledToTop()
+	{
+		_view->requestHistory();
+	}
+
 	QString getFont() const
 	{
 		QFont f = ((ChatView*)parent())->font();
@@ -146,9 +157,11 @@ signals:
 ChatView::ChatView(QWidget *parent)
 	: QFrame(parent)
 	, sessionReady_(false)
+	, historyPending_(false)
 	, dialog_(0)
 	, isMuc_(false)
 	, isEncryptionEnabled_(false)
+	, account_(0)
 {
 	jsObject = new ChatViewJSObject(this); /* It's a session bridge between html and c++ part */
 	webView = new WebView(this);
@@ -167,6 +180,12 @@ ChatView::ChatView(QWidget *parent)
 	psiOptionChanged("options.ui.automatically-copy-selected-text"); // init autocopy connection
 #endif
 	connect(jsObject, SIGNAL(inited()), SLOT(sessionInited()));
+
+	// objects sent in one turn of the event loop are rendered together
+	jsTimer_ = new QTimer(this);
+	jsTimer_->setSingleShot(true);
+	jsTimer_->setInterval(0);
+	connect(jsTimer_, SIGNAL(timeout()), SLOT(checkJsBuffer()));
 	connect(webView->page()->mainFrame(),
 			SIGNAL(javaScriptWindowObjectCleared()), SLOT(embedJsObject()));
 }
@@ -277,19 +296,36 @@ void ChatView::psiOptionChanged(const QString &option)
 
 void ChatView::sendJsObject(const QVariantMap &map)
 {
-	sendJsCommand(QString(currentTheme()->jsNamespace() + ".adapter.receiveObject(%1);")
-				  .arg(JSUtil::map2json(map)));
+	jsObjects_.append(map);
+	if (sessionReady_ && !jsTimer_->isActive()) {
+		jsTimer_->start();
+	}
 }
 
 void ChatView::sendJsCommand(const QString &cmd)
 {
+	flushJsObjects(); // they were sent before
 	jsBuffer_.append(cmd);
 	checkJsBuffer();
 }
 
+/**
+ * Turns the queued objects into a single call of the adapter.
+ */
+void ChatView::flushJsObjects()
+{
+	if (!jsObjects_.isEmpty()) {
+		jsBuffer_.append(currentTheme()->jsNamespace() + ".adapter.receiveObjects("
+						 + JSUtil::variant2js(jsObjects_) + ");");
+		jsObjects_.clear();
+	}
+}
+
 void ChatView::checkJsBuffer()
 {
 	if (sessionReady_) {
+		jsTimer_->stop();
+		flushJsObjects();
 		while (!jsBuffer_.isEmpty()) {
 			webView->evaluateJS(jsBuffer_.takeFirst());
 		}
@@ -328,12 +364,80 @@ void ChatView::dispatchMessage(const MessageView &mv)
 		m["type"] = "message";
 		m["mtype"] = "lastDate";
 		sendJsObject(m);
+		messageShown(mv.dateTime());
+	}
+	sendJsObject(messageObject(mv));
+	messageShown(mv.dateTime());
+
+	// the adapter only trims while the view is scrolled to the bottom, and
+	// tells how much it took with messagesTrimmed()
+	int count = scrollbackTrimCount(isMuc_, account_ && account_->userAccount().opt_log);
+	if (count) {
+		QVariantMap m;
+		m["type"] = "trim";
+		m["keep"] = shownMessageCount() - count;
+		sendJsObject(m);
+	}
+}
+
+/**
+ * Puts older messages from the history before all others, in response to
+ * historyRequested().
+ */
+void ChatView::prependMessages(const QList<MessageView> &messages)
+{
+	if (!historyPending_) {
+		return; // cleared meanwhile
+	}
+	historyPending_ = false;
+	if (messages.isEmpty()) {
+		return;
+	}
+
+	QVariantList list;
+	QList<QDateTime> times;
+	QDate date;
+	foreach (const MessageView &mv, messages) {
+		if (mv.dateTime().date() != date) {
+			date = mv.dateTime().date();
+			QVariantMap m;
+			m["date"] = mv.dateTime();
+			m["type"] = "message";
+			m["mtype"] = "lastDate";
+			list += m;
+			times += mv.dateTime();
+		}
+		list += messageObject(mv);
+		times += mv.dateTime();
 	}
+	historyShown(times);
+
+	QVariantMap m;
+	m["type"] = "history";
+	m["messages"] = list;
+	sendJsObject(m);
+}
+
+QVariantMap ChatView::messageObject(const MessageView &mv) const
+{
 	QVariantMap vm = mv.toVariantMap(isMuc_, true);
 	vm["mtype"] = vm["type"];
 	vm["type"] = "message";
 	vm["encrypted"] = isEncryptionEnabled_;
-	sendJsObject(vm);
+	return vm;
+}
+
+void ChatView::requestHistory()
+{
+	if (historyPending_ || isMuc_) {
+		return;
+	}
+
+	QDateTime first, last;
+	if (takeTrimmedPage(&first, &last)) {
+		historyPending_ = true;
+		emit historyRequested(first, last);
+	}
 }
 
 void ChatView::scrollUp()
@@ -353,6 +457,8 @@ void ChatView::clear()
 	QVariantMap m;
 	m["type"] = "clear";
 	sendJsObject(m);
+	historyPending_ = false;
+	clearScrollback();
 }
 
 void ChatView::doTrackBar()
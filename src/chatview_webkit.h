@@ -33,6 +33,7 @@ class ChatView;
 class MessageView;
 class PsiAccount;
 class ChatViewTheme;
+class QTimer;
 
 
 class ChatViewJSObject;
@@ -59,6 +60,7 @@ public:
 	bool handleCopyEvent(QObject *object, QEvent *event, ChatEdit *chatEdit);
 
 	void dispatchMessage(const MessageView &m);
+	void prependMessages(const QList<MessageView> &);
 
 	void clear();
 	void doTrackBar();
@@ -92,15 +94,27 @@ private slots:
 
 signals:
 	void showNM(const QString&);
+	/**
+	 * Emitted when the user scrolled up to messages which were trimmed,
+	 * prependMessages() should be called with the messages between
+	 * \a first and \a last from the history.
+	 */
+	void historyRequested(const QDateTime &first, const QDateTime &last);
 
 private:
 	friend class ChatViewJSObject;
 	ChatViewTheme* currentTheme();
+	QVariantMap messageObject(const MessageView &mv) const;
+	void requestHistory();
+	void flushJsObjects();
 
 	WebView *webView;
 	ChatViewJSObject *jsObject;
 	QStringList jsBuffer_;
+	QVariantList jsObjects_; // go to the adapter together
+	QTimer *jsTimer_;
 	bool sessionReady_;
+	bool historyPending_;
 	QPointer<QWidget> dialog_;
 	bool isMuc_;
 	bool isEncryptionEnabled_;
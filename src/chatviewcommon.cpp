@@ -45,6 +45,102 @@ bool ChatViewCommon::updateLastMsgTime(QDateTime t)
 	return doInsert;
 }
 
+// the history keeps times to the second
+static QDateTime toSeconds(const QDateTime &t)
+{
+	return t.addMSecs(-t.time().msec());
+}
+
+/**
+ * Records the times of older messages which were put before all others.
+ */
+void ChatViewCommon::historyShown(const QList<QDateTime> &times)
+{
+	_shownTimes = times + _shownTimes;
+}
+
+/**
+ * Returns how many of the oldest messages should be removed from the view
+ * to keep it within the scrollback limit, or 0.  A chat is only trimmed
+ * when its account logs the history, \a logged, so that the messages can
+ * be reloaded.  A groupchat can't be reloaded at all and only has a limit
+ * when options.ui.muc.scrollback-limit is set.
+ */
+int ChatViewCommon::scrollbackTrimCount(bool isMuc, bool logged) const
+{
+	if (!isMuc && !logged) {
+		return 0;
+	}
+	int limit = PsiOptions::instance()->getOption(isMuc ? "options.ui.muc.scrollback-limit" : "options.ui.chat.scrollback-limit").toInt();
+	if (limit <= 0 || _shownTimes.count() <= limit) {
+		return 0;
+	}
+	// a tenth more, so that it isn't done again with the next message
+	int count = _shownTimes.count() - limit + limit / 10;
+
+	// and not between messages of the same second, which can't be told
+	// apart in the history
+	while (count < _shownTimes.count()
+		   && toSeconds(_shownTimes.at(count)) == toSeconds(_shownTimes.at(count - 1))) {
+		++count;
+	}
+	return count < _shownTimes.count() ? count : 0;
+}
+
+/**
+ * Forgets the \a count oldest messages after they were removed from the
+ * view.  If they can be reloaded from the history, their time range is
+ * kept for takeTrimmedPage(), in whole seconds.  A second which has
+ * messages left in the view is not part of it, so nothing is shown twice.
+ */
+void ChatViewCommon::messagesTrimmed(int count, bool reloadable)
+{
+	count = qMin(count, _shownTimes.count());
+	if (count <= 0) {
+		return;
+	}
+	if (reloadable) {
+		// delayed messages may be out of order
+		QDateTime first = toSeconds(_shownTimes.first()), last = first;
+		for (int i = 1; i < count; ++i) {
+			first = qMin(first, toSeconds(_shownTimes.at(i)));
+			last = qMax(last, toSeconds(_shownTimes.at(i)));
+		}
+		if (count < _shownTimes.count()) {
+			QDateTime next = toSeconds(_shownTimes.at(count));
+			if (next >= first && next <= last) {
+				last = next.addSecs(-1);
+			}
+		}
+		if (first <= last) {
+			_trimmedPages += qMakePair(first, last);
+		}
+	}
+	_shownTimes.erase(_shownTimes.begin(), _shownTimes.begin() + count);
+}
+
+/**
+ * Takes the time range of the newest messages which were trimmed, to be
+ * reloaded from the history.  Both ends are whole seconds and belong to
+ * it.  Returns false if there are none.
+ */
+bool ChatViewCommon::takeTrimmedPage(QDateTime *first, QDateTime *last)
+{
+	if (_trimmedPages.isEmpty()) {
+		return false;
+	}
+	QPair<QDateTime, QDateTime> page = _trimmedPages.takeLast();
+	*first = page.first;
+	*last = page.second;
+	return true;
+}
+
+void ChatViewCommon::clearScrollback()
+{
+	_shownTimes.clear();
+	_trimmedPages.clear();
+}
+
 QString ChatViewCommon::getMucNickColor(const QString &nick, bool isSelf, QStringList validList)
 {
 	do {
@@ -22,7 +22,9 @@
 #define CHATVIEWBASE_H
 
 #include <QDateTime>
+#include <QList>
 #include <QMap>
+#include <QPair>
 #include <QStringList>
 
 class QWidget;
@@ -41,11 +43,22 @@ public:
 protected:
 	QDateTime _lastMsgTime;
 
+	// scrollback
+	void messageShown(const QDateTime &t) { _shownTimes += t; }
+	int shownMessageCount() const { return _shownTimes.count(); }
+	void historyShown(const QList<QDateTime> &times);
+	int scrollbackTrimCount(bool isMuc, bool logged) const;
+	void messagesTrimmed(int count, bool reloadable);
+	bool takeTrimmedPage(QDateTime *first, QDateTime *last);
+	void clearScrollback();
+
 private:
 	QList<QColor> &generatePalette();
 	bool compatibleColors(const QColor &, const QColor &);
 	int _nickNumber;
 	QMap<QString,int> _nicks;
+	QList<QDateTime> _shownTimes; // of the messages in the view, oldest first
+	QList<QPair<QDateTime, QDateTime> > _trimmedPages;
 };
 
 #endif
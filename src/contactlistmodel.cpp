@@ -548,10 +548,7 @@ QVariant ContactListModel::contactData(const PsiContact* contact, int role) cons
 		return QVariant(contact->userListItem().clients());
 	}
 	else if (role == AvatarRole) {
-		QPixmap pix = contact->isPrivate() ?
-			      contact->account()->avatarFactory()->getMucAvatar(contact->jid()) :
-			      contact->account()->avatarFactory()->getAvatar(contact->jid());
-		return QVariant(pix);
+		return QVariant(contact->avatar());
 	}
 	else if (role == IsMucRole) {
 		return QVariant(contact->userListItem().isConference());
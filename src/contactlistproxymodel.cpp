@@ -29,6 +29,7 @@
 
 ContactListProxyModel::ContactListProxyModel(QObject* parent)
 	: QSortFilterProxyModel(parent)
+	, sortStyle_(SortByName)
 {
 	sort(0, Qt::AscendingOrder);
 	setDynamicSortFilter(true);
@@ -37,6 +38,7 @@ ContactListProxyModel::ContactListProxyModel(QObject* parent)
 void ContactListProxyModel::setSourceModel(QAbstractItemModel* model)
 {
 	Q_ASSERT(dynamic_cast<ContactListModel*>(model));
+	updateSortStyle(static_cast<ContactListModel*>(model));
 	QSortFilterProxyModel::setSourceModel(model);
 	connect(model, SIGNAL(showOfflineChanged()), SLOT(filterParametersChanged()));
 	connect(model, SIGNAL(showSelfChanged()), SLOT(filterParametersChanged()));
@@ -155,15 +157,13 @@ bool ContactListProxyModel::lessThan(const QModelIndex& left, const QModelIndex&
 	if (!item1 || !item2)
 		return false;
 
-	ContactListModel *model = static_cast<ContactListModel*>(sourceModel());
-	if((model->contactSortStyle() == "status") ||
-	   !dynamic_cast<const PsiContact*>(item1->item()) ||
-	   !dynamic_cast<const PsiContact*>(item2->item()) ) {
-		return item1->item()->compare(item2->item());
-	}
-	else {
-		return item1->item()->name().toLower() < item2->item()->name().toLower();
+	// only PsiContact is of ContactType
+	const ContactListItem* i1 = item1->item();
+	const ContactListItem* i2 = item2->item();
+	if (i1->type() == ContactListModel::ContactType && i2->type() == ContactListModel::ContactType) {
+		return static_cast<const PsiContact*>(i1)->lessThan(static_cast<const PsiContact*>(i2), sortStyle_ == SortByStatus);
 	}
+	return i1->compare(i2);
 }
 
 void ContactListProxyModel::filterParametersChanged()
@@ -174,5 +174,11 @@ void ContactListProxyModel::filterParametersChanged()
 
 void ContactListProxyModel::updateSorting()
 {
+	updateSortStyle(static_cast<ContactListModel*>(sourceModel()));
 	invalidate();
 }
+
+void ContactListProxyModel::updateSortStyle(ContactListModel* model)
+{
+	sortStyle_ = (model && model->contactSortStyle() == "status") ? SortByStatus : SortByName;
+}
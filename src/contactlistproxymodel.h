@@ -24,6 +24,7 @@
 #include <QSortFilterProxyModel>
 
 class PsiContactList;
+class ContactListModel;
 
 class ContactListProxyModel : public QSortFilterProxyModel
 {
@@ -50,6 +51,11 @@ protected:
 
 private slots:
 	void filterParametersChanged();
+
+private:
+	enum SortStyle { SortByName, SortByStatus };
+	SortStyle sortStyle_;
+	void updateSortStyle(ContactListModel* model);
 };
 
 #endif
@@ -0,0 +1,72 @@
+/*
+ * contactsortkey.h - precomputed key for sorting contacts in the roster
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef CONTACTSORTKEY_H
+#define CONTACTSORTKEY_H
+
+#include <QString>
+
+/**
+ * The parts of a contact that the roster is sorted by, computed once
+ * when the name or status of the contact changes instead of on every
+ * comparison.  Comparing two keys doesn't allocate.
+ */
+class ContactSortKey
+{
+public:
+	ContactSortKey() : valid_(false), statusRank_(0) {}
+
+	bool isValid() const { return valid_; }
+	void invalidate() { valid_ = false; }
+
+	/**
+	 * \a statusRank is the rankStatus() of the contact, \a name its display
+	 * name and \a comparisonName the name that breaks ties between contacts
+	 * with the same status.
+	 */
+	void update(int statusRank, const QString& name, const QString& comparisonName)
+	{
+		statusRank_ = statusRank;
+		name_ = name.toLower();
+		comparisonName_ = comparisonName.toLower();
+		valid_ = true;
+	}
+
+	bool lessByName(const ContactSortKey& other) const
+	{
+		return name_ < other.name_;
+	}
+
+	bool lessByStatus(const ContactSortKey& other) const
+	{
+		int rank = statusRank_ - other.statusRank_;
+		if (rank == 0)
+			rank = QString::localeAwareCompare(comparisonName_, other.comparisonName_);
+		return rank < 0;
+	}
+
+private:
+	bool valid_;
+	int statusRank_;
+	QString name_;
+	QString comparisonName_;
+};
+
+#endif
@@ -0,0 +1,732 @@
+/*
+ * edbsegmentfile.cpp - event database of compressed history segments
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "edbsegmentfile.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QVector>
+#include <QCache>
+
+#include <limits.h>
+#ifdef Q_OS_WIN
+# include <windows.h>
+#else
+# include <stdio.h>
+#endif
+
+using namespace XMPP;
+
+// The history of a contact lives in the directory "<jid>.history.seg":
+//
+//   NNNNNNNN.seg  sealed blocks, each the qCompress()ed lines of a run of
+//                 events, appended until the segment is SEGMENT_SIZE bytes
+//   blocks.idx    one record per block: segment, offset, size, first event,
+//                 event count, earliest and latest timestamp (time_t)
+//   active.log    "#<first event>" and the lines which aren't sealed yet
+//
+// A block is written to its segment before its record goes to blocks.idx,
+// and active.log is only rewritten after that, so a crash leaves at worst
+// some unreferenced bytes in a segment or lines in active.log which are
+// already sealed.  Both are sorted out when the store is opened.  A new
+// active.log is written next to the old one and renamed over it.
+//
+// When the flat backend is used again, it turns the directory back into
+// "<jid>.history" with exportFlat().  The directory is renamed to
+// "<jid>.history.seg.old" before the new flat file replaces the old one,
+// and removed after that.
+static const int SEGMENT_BLOCK_EVENTS = 256;
+static const int SEGMENT_BLOCK_SIZE = 65536;
+static const qint64 SEGMENT_SIZE = 4 * 1024 * 1024;
+static const int BLOCK_RECORD_SIZE = 32;
+static const int BLOCK_CACHE_SIZE = 8;
+static const int LINE_HEAD_SIZE = 32;
+
+struct SegmentBlock
+{
+	quint32 segment;
+	quint64 offset;
+	quint32 size;
+	quint32 first;
+	quint32 count;
+	quint32 minTime, maxTime;
+};
+
+static QString segmentFileName(const QString &dir, quint32 n)
+{
+	return dir + QString("/%1.seg").arg(n, 8, 10, QChar('0'));
+}
+
+static bool removeDir(const QString &path)
+{
+	QDir dir(path);
+	if(!dir.exists())
+		return true;
+
+	bool ok = true;
+	foreach(const QString &name, dir.entryList(QDir::Files | QDir::Hidden))
+		ok = dir.remove(name) && ok;
+	return QDir().rmdir(path) && ok;
+}
+
+// renames \a from to \a to, replacing it in one step
+static bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_WIN
+	return MoveFileExW((LPCWSTR)QDir::toNativeSeparators(from).utf16(),
+					   (LPCWSTR)QDir::toNativeSeparators(to).utf16(),
+					   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// EDBSegmentFile
+//----------------------------------------------------------------------------
+EDBSegmentFile::EDBSegmentFile()
+:EDBThreaded(openStore, removeStore)
+{
+}
+
+EDBSegmentFile::~EDBSegmentFile()
+{
+}
+
+EDBStore *EDBSegmentFile::openStore(const Jid &j, const QString &fileName)
+{
+	return new Store(j, fileName);
+}
+
+bool EDBSegmentFile::removeStore(const QString &fileName)
+{
+	// a flat history which hasn't been converted yet goes as well
+	QFile::remove(EDBFlatFile::File::indexFileName(fileName));
+	QFile::remove(EDBFlatFile::File::textIndexFileName(fileName));
+	if(QFile::exists(fileName) && !QFile::remove(fileName))
+		return false;
+
+	QString dir = Store::dirName(fileName);
+	removeDir(dir + ".new");
+	removeDir(dir + ".old");
+	QFile::remove(fileName + ".new");
+	return removeDir(dir);
+}
+
+//----------------------------------------------------------------------------
+// EDBSegmentFile::Store
+//----------------------------------------------------------------------------
+class EDBSegmentFile::Store::Private
+{
+public:
+	Private() : cache(BLOCK_CACHE_SIZE) {}
+
+	QString dir;
+	bool valid;
+
+	QVector<SegmentBlock> blocks;
+	QFile blockIndex;
+	QFile segment;
+	quint32 segmentNo;
+	QCache<int, QList<QByteArray> > cache; // decompressed blocks
+
+	int activeFirst;
+	QList<QByteArray> active;
+	QVector<uint> activeTimes;
+	int activeSize;
+	QFile activeLog;
+
+	WritePolicy policy;
+	QByteArray pending;
+	int pendingLines; // the newest active lines, which are in pending
+	QTime pendingSince;
+};
+
+EDBSegmentFile::Store::Store(const Jid &_j, const QString &fileName)
+:EDBStore(_j)
+{
+	d = new Private;
+	d->valid = false;
+	d->segmentNo = 0;
+	d->activeFirst = 0;
+	d->activeSize = 0;
+	d->pendingLines = 0;
+	d->policy.interval = 0;
+	d->policy.maxSize = 0;
+	d->policy.sync = WritePolicy::SyncNever;
+
+	QString dir = dirName(fileName);
+	if(!finishExport(fileName)) {
+		qWarning("EDBSegmentFile::Store: Converting %s to a flat history couldn't be finished.", qPrintable(fileName));
+		return;
+	}
+	if(!QFileInfo(dir).isDir() && QFile::exists(fileName) && !import(fileName)) {
+		qWarning("EDBSegmentFile::Store: Converting %s failed.", qPrintable(fileName));
+		return;
+	}
+
+	d->valid = open(dir);
+}
+
+EDBSegmentFile::Store::~Store()
+{
+	close();
+	delete d;
+}
+
+QString EDBSegmentFile::Store::dirName(const QString &historyFileName)
+{
+	return historyFileName + ".seg";
+}
+
+bool EDBSegmentFile::Store::open(const QString &dir)
+{
+	if(!QDir().mkpath(dir))
+		return false;
+
+	d->dir = dir;
+	return loadBlocks() && loadActive();
+}
+
+void EDBSegmentFile::Store::close()
+{
+	flush();
+	if(d->policy.sync != WritePolicy::SyncNever) {
+		syncFile(&d->segment);
+		syncFile(&d->blockIndex);
+		syncFile(&d->activeLog);
+	}
+	d->segment.close();
+	d->blockIndex.close();
+	d->activeLog.close();
+
+	d->blocks.clear();
+	d->cache.clear();
+	d->active.clear();
+	d->activeTimes.clear();
+	d->activeSize = 0;
+	d->activeFirst = 0;
+}
+
+/**
+ * Converts the flat history \a fileName.  The segments are built in a
+ * directory of their own, which is renamed into place once it's complete,
+ * so an interrupted conversion simply starts over.
+ */
+bool EDBSegmentFile::Store::import(const QString &fileName)
+{
+	QFile in(fileName);
+	if(!in.open(QIODevice::ReadOnly))
+		return false;
+
+	QString dir = dirName(fileName);
+	QString tmpDir = dir + ".new";
+	removeDir(tmpDir);
+	bool ok = open(tmpDir);
+	while(ok && !in.atEnd()) {
+		QByteArray line = in.readLine();
+		if(line.endsWith('\n'))
+			line.chop(1);
+		if(line.endsWith('\r'))
+			line.chop(1);
+		ok = addLine(line);
+	}
+	ok = ok && in.error() == QFile::NoError && flush();
+
+	// everything has to be on disk before the flat history goes away
+	ok = ok && syncFile(&d->segment) && syncFile(&d->blockIndex) && syncFile(&d->activeLog);
+	close();
+	in.close();
+
+	if(!ok || !QDir().rename(tmpDir, dir)) {
+		removeDir(tmpDir);
+		return false;
+	}
+
+	QFile::remove(EDBFlatFile::File::indexFileName(fileName));
+	QFile::remove(EDBFlatFile::File::textIndexFileName(fileName));
+	QFile::remove(fileName);
+	return true;
+}
+
+/**
+ * Writes the segments of \a fileName into a flat history there, when the
+ * flat backend opens a history which was kept in segments.  Lines in
+ * \a fileName, which were logged to it while the segments weren't used,
+ * stay after the converted ones.
+ */
+bool EDBSegmentFile::Store::exportFlat(const Jid &j, const QString &fileName)
+{
+	if(!finishExport(fileName))
+		return false;
+
+	QString dir = dirName(fileName);
+	if(!QFileInfo(dir).isDir())
+		return true;
+	removeDir(dir + ".new"); // an interrupted import
+
+	QString newFile = fileName + ".new";
+	QFile out(newFile);
+	bool ok = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	if(ok) {
+		Store store(j, fileName);
+		ok = store.d->valid && store.writeLines(&out);
+	}
+
+	QFile in(fileName);
+	if(ok && in.exists()) {
+		ok = in.open(QIODevice::ReadOnly);
+		while(ok && !in.atEnd()) {
+			QByteArray block = in.read(SEGMENT_BLOCK_SIZE);
+			ok = out.write(block) == block.size();
+		}
+		ok = ok && in.error() == QFile::NoError;
+		in.close();
+	}
+	ok = ok && out.flush() && syncFile(&out);
+	out.close();
+
+	if(!ok || !QDir().rename(dir, dir + ".old")) {
+		QFile::remove(newFile);
+		return false;
+	}
+	return finishExport(fileName);
+}
+
+/**
+ * Completes exportFlat() once the segments were put aside, also if it was
+ * interrupted there.
+ */
+bool EDBSegmentFile::Store::finishExport(const QString &fileName)
+{
+	QString oldDir = dirName(fileName) + ".old";
+	if(!QFileInfo(oldDir).isDir())
+		return true;
+
+	QString newFile = fileName + ".new";
+	if(QFile::exists(newFile)) {
+		if(!replaceFile(newFile, fileName))
+			return false;
+		// the flat indexes are built again
+		QFile::remove(EDBFlatFile::File::indexFileName(fileName));
+		QFile::remove(EDBFlatFile::File::textIndexFileName(fileName));
+	}
+	removeDir(oldDir);
+	return true;
+}
+
+// writes all lines, sealed or not, to \a out
+bool EDBSegmentFile::Store::writeLines(QIODevice *out)
+{
+	for(int b = 0; b < d->blocks.count(); ++b) {
+		const QList<QByteArray> *lines = blockLines(b);
+		if(!lines || lines->count() != int(d->blocks[b].count))
+			return false;
+		QByteArray data;
+		foreach(const QByteArray &line, *lines) {
+			data += line;
+			data += '\n';
+		}
+		if(out->write(data) != data.size())
+			return false;
+	}
+	foreach(const QByteArray &line, d->active) {
+		if(out->write(line + '\n') != line.size() + 1)
+			return false;
+	}
+	return true;
+}
+
+bool EDBSegmentFile::Store::loadBlocks()
+{
+	d->blockIndex.setFileName(d->dir + "/blocks.idx");
+	if(!d->blockIndex.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+		return false;
+
+	QDataStream in(&d->blockIndex);
+	in.setVersion(QDataStream::Qt_4_6);
+	int count = d->blockIndex.size() / BLOCK_RECORD_SIZE;
+	d->blocks.resize(count);
+	quint32 next = 0;
+	for(int n = 0; n < count; ++n) {
+		SegmentBlock &b = d->blocks[n];
+		in >> b.segment >> b.offset >> b.size >> b.first >> b.count >> b.minTime >> b.maxTime;
+		if(in.status() != QDataStream::Ok || b.first != next) {
+			count = n;
+			break;
+		}
+		next += b.count;
+	}
+	d->blocks.resize(count);
+
+	// cut off a record which was only partly written
+	if(d->blockIndex.size() != qint64(count) * BLOCK_RECORD_SIZE)
+		d->blockIndex.resize(qint64(count) * BLOCK_RECORD_SIZE);
+
+	return openSegment(d->blocks.isEmpty() ? 0 : d->blocks.last().segment);
+}
+
+bool EDBSegmentFile::Store::loadActive()
+{
+	int sealed = d->blocks.isEmpty() ? 0 : d->blocks.last().first + d->blocks.last().count;
+	d->activeFirst = sealed;
+	d->active.clear();
+	d->activeTimes.clear();
+	d->activeSize = 0;
+	d->pending.clear();
+	d->pendingLines = 0;
+
+	// a rewrite which didn't get to replace active.log
+	QFile::remove(d->dir + "/active.log.new");
+
+	d->activeLog.setFileName(d->dir + "/active.log");
+	// unbuffered, like the segment and the block index, so what a failed
+	// write left behind isn't retried when the file is cut back
+	if(!d->activeLog.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+		return false;
+
+	// the last piece is empty, unless a line was only partly written
+	QList<QByteArray> lines = d->activeLog.readAll().split('\n');
+	bool clean = lines.takeLast().isEmpty();
+
+	int first = -1;
+	if(!lines.isEmpty() && lines.first().startsWith('#')) {
+		bool ok;
+		first = lines.takeFirst().mid(1).toInt(&ok);
+		if(!ok)
+			first = -1;
+	}
+
+	// skip the lines which were sealed before active.log was rewritten
+	int skip = first >= 0 && first < sealed ? sealed - first : 0;
+	for(int n = skip; n < lines.count(); ++n) {
+		d->active += lines[n];
+		d->activeTimes += lineTime(lines[n].left(LINE_HEAD_SIZE));
+		d->activeSize += lines[n].size() + 1;
+	}
+
+	if(first != sealed || !clean) {
+		if(!writeActive())
+			return false;
+	}
+
+	if(d->active.count() >= SEGMENT_BLOCK_EVENTS || d->activeSize >= SEGMENT_BLOCK_SIZE)
+		return seal();
+	return true;
+}
+
+// rewrites active.log from memory, which covers anything pending as well
+bool EDBSegmentFile::Store::writeActive()
+{
+	QByteArray data = "#" + QByteArray::number(d->activeFirst) + '\n';
+	foreach(const QByteArray &line, d->active) {
+		data += line;
+		data += '\n';
+	}
+	d->pending.clear();
+	d->pendingLines = 0;
+
+	// the old file stays until the new one is complete on disk
+	QString fileName = d->activeLog.fileName();
+	QFile f(fileName + ".new");
+	bool ok = f.open(QIODevice::WriteOnly | QIODevice::Truncate) && f.write(data) == data.size();
+	ok = ok && f.flush() && syncFile(&f);
+	f.close();
+	if(ok) {
+		d->activeLog.close();
+		ok = replaceFile(f.fileName(), fileName);
+		if(!d->activeLog.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+			ok = false;
+	}
+	if(!ok) {
+		QFile::remove(f.fileName());
+		qWarning("EDBSegmentFile::Store::writeActive(): Writing to %s failed.", qPrintable(d->dir));
+	}
+	return ok;
+}
+
+bool EDBSegmentFile::Store::openSegment(quint32 n)
+{
+	d->segment.close();
+	d->segmentNo = n;
+	d->segment.setFileName(segmentFileName(d->dir, n));
+	return d->segment.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+bool EDBSegmentFile::Store::addLine(const QByteArray &line)
+{
+	if(d->pending.isEmpty())
+		d->pendingSince.start();
+	d->pending += line;
+	d->pending += '\n';
+	d->pendingLines++;
+
+	d->active += line;
+	d->activeTimes += lineTime(line.left(LINE_HEAD_SIZE));
+	d->activeSize += line.size() + 1;
+
+	if(d->active.count() >= SEGMENT_BLOCK_EVENTS || d->activeSize >= SEGMENT_BLOCK_SIZE) {
+		if(!seal()) {
+			// the line is reported as lost, so it mustn't turn up later
+			d->pending.chop(line.size() + 1);
+			d->pendingLines--;
+			dropLines(1);
+			return false;
+		}
+	}
+	return true;
+}
+
+// forgets the \a count newest active lines
+void EDBSegmentFile::Store::dropLines(int count)
+{
+	for(int n = 0; n < count && !d->active.isEmpty(); ++n) {
+		d->activeSize -= d->active.takeLast().size() + 1;
+		d->activeTimes.resize(d->activeTimes.size() - 1);
+	}
+}
+
+/**
+ * Compresses the active lines into a new block and starts over with an
+ * empty active.log.  Returns false if the block couldn't be written, the
+ * lines stay active then.
+ */
+bool EDBSegmentFile::Store::seal()
+{
+	if(d->active.isEmpty())
+		return true;
+
+	QByteArray data;
+	data.reserve(d->activeSize);
+	foreach(const QByteArray &line, d->active) {
+		data += line;
+		data += '\n';
+	}
+	QByteArray block = qCompress(data);
+
+	if(d->segment.size() >= SEGMENT_SIZE && !openSegment(d->segmentNo + 1))
+		return false;
+
+	SegmentBlock b;
+	b.segment = d->segmentNo;
+	b.offset = d->segment.size();
+	b.size = block.size();
+	b.first = d->activeFirst;
+	b.count = d->active.count();
+	b.minTime = UINT_MAX;
+	b.maxTime = 0;
+	foreach(uint t, d->activeTimes) {
+		if(t == 0)
+			continue;
+		b.minTime = qMin(b.minTime, t);
+		b.maxTime = qMax(b.maxTime, t);
+	}
+
+	bool ok = d->segment.seek(b.offset) && d->segment.write(block) == block.size();
+	ok = d->segment.flush() && ok;
+	if(ok) {
+		QByteArray record;
+		QDataStream out(&record, QIODevice::WriteOnly);
+		out.setVersion(QDataStream::Qt_4_6);
+		out << b.segment << b.offset << b.size << b.first << b.count << b.minTime << b.maxTime;
+
+		qint64 at = qint64(d->blocks.count()) * BLOCK_RECORD_SIZE;
+		ok = d->blockIndex.seek(at) && d->blockIndex.write(record) == record.size();
+		ok = d->blockIndex.flush() && ok;
+		if(!ok)
+			d->blockIndex.resize(at);
+	}
+	if(!ok) {
+		qWarning("EDBSegmentFile::Store::seal(): Writing to %s failed.", qPrintable(d->dir));
+		d->segment.resize(b.offset);
+		return false;
+	}
+	if(d->policy.sync == WritePolicy::SyncOnFlush) {
+		syncFile(&d->segment);
+		syncFile(&d->blockIndex);
+	}
+
+	// the newest block is the one most likely to be read next
+	d->blocks.append(b);
+	d->cache.insert(d->blocks.count() - 1, new QList<QByteArray>(d->active));
+
+	d->activeFirst += b.count;
+	d->active.clear();
+	d->activeTimes.clear();
+	d->activeSize = 0;
+
+	// the lines are safe in the block, an active.log which still has them
+	// is sorted out when the store is opened
+	writeActive();
+	return true;
+}
+
+int EDBSegmentFile::Store::blockOf(int id) const
+{
+	int lo = 0;
+	int hi = d->blocks.count() - 1;
+	while(lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if(int(d->blocks[mid].first) <= id)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+const QList<QByteArray> *EDBSegmentFile::Store::blockLines(int block)
+{
+	QList<QByteArray> *lines = d->cache.object(block);
+	if(lines)
+		return lines;
+
+	const SegmentBlock &b = d->blocks[block];
+	QFile f(segmentFileName(d->dir, b.segment));
+	if(!f.open(QIODevice::ReadOnly) || !f.seek(b.offset))
+		return 0;
+
+	lines = new QList<QByteArray>(qUncompress(f.read(b.size)).split('\n'));
+	if(!lines->isEmpty() && lines->last().isEmpty())
+		lines->removeLast();
+	d->cache.insert(block, lines);
+	return lines;
+}
+
+int EDBSegmentFile::Store::total() const
+{
+	return d->activeFirst + d->active.count();
+}
+
+QList<PsiEvent::Ptr> EDBSegmentFile::Store::get(int id, int len)
+{
+	touch();
+
+	QList<PsiEvent::Ptr> events;
+	for(int n = id; n < id + len; ++n) {
+		QByteArray line;
+		if(d->valid && n >= d->activeFirst && n < total()) {
+			line = d->active[n - d->activeFirst];
+		}
+		else if(d->valid && n >= 0 && n < d->activeFirst) {
+			int b = blockOf(n);
+			const QList<QByteArray> *lines = blockLines(b);
+			if(lines)
+				line = lines->value(n - d->blocks[b].first);
+		}
+		events.append(line.isEmpty() ? PsiEvent::Ptr() : lineToEvent(QString::fromUtf8(line)));
+	}
+	return events;
+}
+
+/**
+ * Returns the ids of the events in the blocks whose time range overlaps
+ * \a first to \a last, and of the active events which are within it.
+ */
+QList<int> EDBSegmentFile::Store::findByDate(const QDateTime &first, const QDateTime &last)
+{
+	touch();
+
+	QList<int> ids;
+	if(!d->valid)
+		return ids;
+
+	uint from = first.toTime_t();
+	uint to = last.toTime_t();
+	foreach(const SegmentBlock &b, d->blocks) {
+		if(b.minTime > to || b.maxTime < from)
+			continue;
+		for(quint32 n = 0; n < b.count; ++n)
+			ids.append(b.first + n);
+	}
+	for(int n = 0; n < d->activeTimes.count(); ++n) {
+		uint t = d->activeTimes[n];
+		if(t != 0 && t >= from && t <= to)
+			ids.append(d->activeFirst + n);
+	}
+	return ids;
+}
+
+/**
+ * Appends \a line to the active lines.  This backend has no full-text
+ * index, so \a text and \a textIndex are ignored.
+ */
+bool EDBSegmentFile::Store::append(const QString &line, const QString &text, bool textIndex)
+{
+	Q_UNUSED(text);
+	Q_UNUSED(textIndex);
+
+	touch();
+
+	if(!d->valid || line.isEmpty())
+		return false;
+
+	if(!addLine(line.toUtf8()))
+		return false;
+
+	if(d->policy.interval <= 0 || d->pending.size() >= d->policy.maxSize)
+		return flush();
+	return true;
+}
+
+bool EDBSegmentFile::Store::flush()
+{
+	if(d->pending.isEmpty())
+		return true;
+
+	qint64 size = d->activeLog.size();
+	bool ok = d->activeLog.seek(size) && d->activeLog.write(d->pending) == d->pending.size();
+	ok = d->activeLog.flush() && ok;
+	if(!ok) {
+		qWarning("EDBSegmentFile::Store::flush(): Writing to %s failed.", qPrintable(d->dir));
+
+		// the lines are lost, along with whatever part of them was written
+		d->activeLog.resize(size);
+		dropLines(d->pendingLines);
+		d->pending.clear();
+		d->pendingLines = 0;
+		return false;
+	}
+	if(d->policy.sync == WritePolicy::SyncOnFlush)
+		syncFile(&d->activeLog);
+
+	d->pending.clear();
+	d->pendingLines = 0;
+	return true;
+}
+
+int EDBSegmentFile::Store::flushIfDue()
+{
+	if(d->pending.isEmpty())
+		return -1;
+
+	int left = d->policy.interval - d->pendingSince.elapsed();
+	if(left > 0)
+		return left;
+
+	flush();
+	return -1;
+}
+
+void EDBSegmentFile::Store::setWritePolicy(const WritePolicy &policy)
+{
+	d->policy = policy;
+}
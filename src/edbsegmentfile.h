@@ -0,0 +1,85 @@
+/*
+ * edbsegmentfile.h - event database of compressed history segments
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef EDBSEGMENTFILE_H
+#define EDBSEGMENTFILE_H
+
+#include "eventdb.h"
+
+/**
+ * Event database which keeps the history of each contact in blocks of
+ * compressed lines.  The lines are the same as in EDBFlatFile, and an
+ * existing flat history is converted when it is first opened.  EDBFlatFile
+ * converts it back the same way.
+ */
+class EDBSegmentFile : public EDBThreaded
+{
+	Q_OBJECT
+public:
+	EDBSegmentFile();
+	~EDBSegmentFile();
+
+	class Store;
+
+	static bool removeStore(const QString &fileName);
+
+private:
+	static EDBStore *openStore(const XMPP::Jid &, const QString &fileName);
+};
+
+class EDBSegmentFile::Store : public EDBStore
+{
+public:
+	Store(const XMPP::Jid &_j, const QString &fileName);
+	~Store();
+
+	using EDBStore::get;
+	int total() const;
+	QList<PsiEvent::Ptr> get(int id, int len);
+	QList<int> findByDate(const QDateTime &first, const QDateTime &last);
+	bool append(const QString &line, const QString &text, bool textIndex);
+	bool flush();
+	int flushIfDue();
+	void setWritePolicy(const WritePolicy &);
+
+	static QString dirName(const QString &);
+	static bool exportFlat(const XMPP::Jid &, const QString &fileName);
+
+private:
+	class Private;
+	Private *d;
+
+	bool open(const QString &dir);
+	void close();
+	bool import(const QString &fileName);
+	static bool finishExport(const QString &fileName);
+	bool writeLines(QIODevice *out);
+	bool loadBlocks();
+	bool loadActive();
+	bool writeActive();
+	bool openSegment(quint32 n);
+	bool addLine(const QByteArray &line);
+	void dropLines(int count);
+	bool seal();
+	int blockOf(int id) const;
+	const QList<QByteArray> *blockLines(int block);
+};
+
+#endif
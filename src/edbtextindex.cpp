@@ -0,0 +1,406 @@
+/*
+ * edbtextindex.cpp - full-text index of message history
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "edbtextindex.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <QVector>
+#include <QtAlgorithms>
+
+static const quint32 TEXTINDEX_MAGIC = 0x50534954; // "PSIT"
+static const quint32 TEXTINDEX_VERSION = 1;
+
+static void putVarint(QByteArray *data, quint32 v)
+{
+	while(v >= 0x80) {
+		data->append(char((v & 0x7f) | 0x80));
+		v >>= 7;
+	}
+	data->append(char(v));
+}
+
+static quint32 getVarint(const char **p)
+{
+	quint32 v = 0;
+	int shift = 0;
+	uchar c;
+	do {
+		c = uchar(*(*p)++);
+		v |= quint32(c & 0x7f) << shift;
+		shift += 7;
+	} while(c & 0x80);
+	return v;
+}
+
+static QString reversed(const QString &s)
+{
+	QString r;
+	r.resize(s.length());
+	for(int n = 0; n < s.length(); ++n)
+		r[s.length()-1 - n] = s[n];
+	return r;
+}
+
+// the end of the terms of the sorted list 'list' from 'begin' on which
+// start with 'prefix'
+static QStringList::ConstIterator prefixEnd(const QStringList &list, QStringList::ConstIterator begin, const QString &prefix)
+{
+	QStringList::ConstIterator it = begin;
+	while(it != list.constEnd() && it->startsWith(prefix))
+		++it;
+	return it;
+}
+
+// higher score first, then the newer event
+static bool moreRelevant(const EDBTextIndex::Hit &a, const EDBTextIndex::Hit &b)
+{
+	if(a.second != b.second)
+		return a.second > b.second;
+	return a.first > b.first;
+}
+
+EDBTextIndex::EDBTextIndex(const QString &fileName)
+{
+	fname = fileName;
+	termsSorted = false;
+	v_count = 0;
+	v_journalSize = 0;
+}
+
+EDBTextIndex::~EDBTextIndex()
+{
+}
+
+const QString & EDBTextIndex::fileName() const
+{
+	return fname;
+}
+
+/**
+ * Number of events in the index, which are the events 0 to count()-1.
+ */
+int EDBTextIndex::count() const
+{
+	return v_count;
+}
+
+/**
+ * Number of events which were added to the journal since the last snapshot.
+ */
+int EDBTextIndex::journalSize() const
+{
+	return v_journalSize;
+}
+
+void EDBTextIndex::clear()
+{
+	terms.clear();
+	sortedTerms.clear();
+	reversedTerms.clear();
+	termsSorted = false;
+	v_count = 0;
+	v_journalSize = 0;
+}
+
+bool EDBTextIndex::load()
+{
+	clear();
+
+	QFile file(fname);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_4_6);
+	quint32 magic, version, count, termCount;
+	in >> magic >> version >> count >> termCount;
+	if(in.status() != QDataStream::Ok || magic != TEXTINDEX_MAGIC || version != TEXTINDEX_VERSION)
+		return false;
+
+	terms.reserve(termCount);
+	for(quint32 n = 0; n < termCount && in.status() == QDataStream::Ok; ++n) {
+		QString term;
+		Postings p;
+		in >> term >> p.lastId >> p.count >> p.data;
+		terms.insert(term, p);
+	}
+	if(in.status() != QDataStream::Ok) {
+		clear();
+		return false;
+	}
+	v_count = count;
+
+	// replay the journal up to the first record which is incomplete or
+	// doesn't continue the index, and cut it off there
+	qint64 good = file.pos();
+	while(!in.atEnd()) {
+		quint32 id;
+		QStringList tokens;
+		in >> id >> tokens;
+		if(in.status() != QDataStream::Ok || int(id) != v_count)
+			break;
+
+		addTokens(id, tokens);
+		++v_journalSize;
+		good = file.pos();
+	}
+	file.close();
+
+	if(good < file.size())
+		file.resize(good);
+
+	return true;
+}
+
+bool EDBTextIndex::save()
+{
+	QString tmpName = fname + ".new";
+	QFile file(tmpName);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << TEXTINDEX_MAGIC << TEXTINDEX_VERSION << quint32(v_count) << quint32(terms.count());
+	QHash<QString, Postings>::ConstIterator it = terms.constBegin();
+	for(; it != terms.constEnd(); ++it) {
+		const Postings &p = it.value();
+		out << it.key() << p.lastId << p.count << p.data;
+	}
+	file.close();
+
+	if(out.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+		QFile::remove(tmpName);
+		return false;
+	}
+
+	QFile::remove(fname);
+	if(!QFile::rename(tmpName, fname))
+		return false;
+
+	v_journalSize = 0;
+	return true;
+}
+
+/**
+ * Adds event \a id with body \a text to the index in memory.  Events must
+ * be added in order, so \a id is expected to be count().
+ */
+void EDBTextIndex::add(int id, const QString &text)
+{
+	if(id != v_count)
+		return;
+	addTokens(id, tokenize(text));
+}
+
+/**
+ * Adds event \a id to the index in memory and records it in the journal.
+ */
+bool EDBTextIndex::journal(int id, const QString &text)
+{
+	if(id != v_count)
+		return false;
+
+	QStringList tokens = tokenize(text);
+	addTokens(id, tokens);
+	++v_journalSize;
+
+	QFile file(fname);
+	if(!file.exists() || !file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return false;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << quint32(id) << tokens;
+	return out.status() == QDataStream::Ok;
+}
+
+/**
+ * Records event \a id in the journal of the index file \a fileName without
+ * loading the index.  Does nothing if there is no index file yet.
+ */
+bool EDBTextIndex::appendJournal(const QString &fileName, int id, const QString &text)
+{
+	QFile file(fileName);
+	if(!file.exists() || !file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return false;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << quint32(id) << tokenize(text);
+	return out.status() == QDataStream::Ok;
+}
+
+void EDBTextIndex::addTokens(int id, const QStringList &tokens)
+{
+	for(int pos = 0; pos < tokens.count(); ++pos) {
+		const QString &term = tokens[pos];
+		QHash<QString, Postings>::Iterator it = terms.find(term);
+		if(it == terms.end()) {
+			it = terms.insert(term, Postings());
+			if(termsSorted) {
+				QString r = reversed(term);
+				sortedTerms.insert(qLowerBound(sortedTerms.begin(), sortedTerms.end(), term), term);
+				reversedTerms.insert(qLowerBound(reversedTerms.begin(), reversedTerms.end(), r), r);
+			}
+		}
+
+		Postings &p = it.value();
+		putVarint(&p.data, id - p.lastId);
+		putVarint(&p.data, pos);
+		p.lastId = id;
+		++p.count;
+	}
+	v_count = id + 1;
+}
+
+// builds the sorted term lists which prefix and suffix lookups use, they
+// are kept up to date from then on
+void EDBTextIndex::sortTerms() const
+{
+	if(termsSorted)
+		return;
+
+	sortedTerms = terms.keys();
+	reversedTerms.clear();
+	reversedTerms.reserve(sortedTerms.count());
+	foreach(const QString &term, sortedTerms)
+		reversedTerms += reversed(term);
+	qSort(sortedTerms);
+	qSort(reversedTerms);
+	termsSorted = true;
+}
+
+// adds the postings of 'term' to 'events', by event
+void EDBTextIndex::collect(const QString &term, QHash<int, QVector<int> > *events) const
+{
+	QHash<QString, Postings>::ConstIterator it = terms.find(term);
+	if(it == terms.constEnd())
+		return;
+
+	const Postings &p = it.value();
+	const char *data = p.data.constData();
+	int id = 0;
+	for(quint32 k = 0; k < p.count; ++k) {
+		id += getVarint(&data);
+		(*events)[id].append(getVarint(&data));
+	}
+}
+
+/**
+ * Returns the events which may contain \a str, best first, with the
+ * number of times the words of \a str occur there in sequence as the score.
+ * Events with the same score come newest first.
+ *
+ * The first word of the query may be the end of a word and the last one
+ * the beginning of a word, a query of one word matches the words which
+ * start with it.  Since punctuation isn't indexed, callers have to check
+ * the events themselves to tell exact matches apart.
+ */
+QList<EDBTextIndex::Hit> EDBTextIndex::find(const QString &str) const
+{
+	QList<Hit> hits;
+	QStringList words = tokenize(str);
+	if(words.isEmpty())
+		return hits;
+
+	sortTerms();
+
+	// positions of each query word, by event
+	QVector< QHash<int, QVector<int> > > positions(words.count());
+	for(int n = 0; n < words.count(); ++n) {
+		QHash<int, QVector<int> > &events = positions[n];
+		const QString &word = words[n];
+		if(n == words.count()-1) {
+			QStringList::ConstIterator begin = qLowerBound(sortedTerms.constBegin(), sortedTerms.constEnd(), word);
+			QStringList::ConstIterator end = prefixEnd(sortedTerms, begin, word);
+			for(QStringList::ConstIterator it = begin; it != end; ++it)
+				collect(*it, &events);
+		}
+		else if(n == 0) {
+			QString r = reversed(word);
+			QStringList::ConstIterator begin = qLowerBound(reversedTerms.constBegin(), reversedTerms.constEnd(), r);
+			QStringList::ConstIterator end = prefixEnd(reversedTerms, begin, r);
+			for(QStringList::ConstIterator it = begin; it != end; ++it)
+				collect(reversed(*it), &events);
+		}
+		else {
+			collect(word, &events);
+		}
+		if(events.isEmpty())
+			return hits;
+	}
+
+	QHash<int, QVector<int> >::Iterator it = positions[0].begin();
+	for(; it != positions[0].end(); ++it) {
+		int id = it.key();
+		bool all = true;
+		for(int n = 1; n < words.count() && all; ++n) {
+			QHash<int, QVector<int> >::Iterator e = positions[n].find(id);
+			if(e == positions[n].end())
+				all = false;
+			else
+				qSort(e.value());
+		}
+		if(!all)
+			continue;
+
+		int score = 0;
+		foreach(int pos, it.value()) {
+			bool phrase = true;
+			for(int n = 1; n < words.count() && phrase; ++n) {
+				const QVector<int> &next = positions[n][id];
+				phrase = qBinaryFind(next, pos + n) != next.constEnd();
+			}
+			if(phrase)
+				++score;
+		}
+		if(score > 0)
+			hits.append(Hit(id, score));
+	}
+
+	qSort(hits.begin(), hits.end(), moreRelevant);
+	return hits;
+}
+
+/**
+ * Splits \a text into case-folded words.
+ */
+QStringList EDBTextIndex::tokenize(const QString &text)
+{
+	QStringList tokens;
+	QString folded = text.toCaseFolded();
+	int start = -1;
+	for(int n = 0; n <= folded.length(); ++n) {
+		bool word = false;
+		if(n < folded.length()) {
+			QChar c = folded[n];
+			word = c.isLetterOrNumber() || c.isMark();
+		}
+
+		if(word && start == -1) {
+			start = n;
+		}
+		else if(!word && start != -1) {
+			tokens += folded.mid(start, n - start);
+			start = -1;
+		}
+	}
+	return tokens;
+}
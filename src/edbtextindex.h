@@ -0,0 +1,89 @@
+/*
+ * edbtextindex.h - full-text index of message history
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef EDBTEXTINDEX_H
+#define EDBTEXTINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <QByteArray>
+
+/**
+ * Inverted index of the words in the events of one history file.
+ *
+ * Words are case-folded and stored with their position in the event, so
+ * that phrases can be matched.  Events are identified by their number in the
+ * history file and have to be added in order.
+ *
+ * On disk the index is a snapshot of all postings followed by a journal of
+ * the events added since.  The journal is replayed by load() and folded into
+ * the snapshot by save().
+ */
+class EDBTextIndex
+{
+public:
+	typedef QPair<int, int> Hit; // event id, score
+
+	EDBTextIndex(const QString &fileName);
+	~EDBTextIndex();
+
+	const QString & fileName() const;
+	int count() const;
+	int journalSize() const;
+
+	void clear();
+	bool load();
+	bool save();
+
+	void add(int id, const QString &text);
+	bool journal(int id, const QString &text);
+	QList<Hit> find(const QString &str) const;
+
+	static QStringList tokenize(const QString &text);
+	static bool appendJournal(const QString &fileName, int id, const QString &text);
+
+private:
+	struct Postings
+	{
+		Postings() : lastId(0), count(0) {}
+
+		quint32 lastId;
+		quint32 count;
+		QByteArray data; // varint coded (id delta, position) pairs
+	};
+
+	void addTokens(int id, const QStringList &tokens);
+	void sortTerms() const;
+	void collect(const QString &term, QHash<int, QVector<int> > *events) const;
+
+	QString fname;
+	QHash<QString, Postings> terms;
+	// all terms, and all terms spelled backwards, once a query needed them
+	mutable QStringList sortedTerms, reversedTerms;
+	mutable bool termsSorted;
+	int v_count;
+	int v_journalSize;
+};
+
+#endif
@@ -20,31 +20,45 @@
 
 #include "eventdb.h"
 
-#define FAKEDELAY 0
-
 #include <QVector>
 #include <QFileInfo>
 #include <QDir>
-#include <QTimer>
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicPointer>
 #include <QTextStream>
+#include <QDataStream>
 #include <QDateTime>
+#include <QtAlgorithms>
+#include <QPair>
+
+#include <string.h>
+#include <limits.h>
+#ifdef Q_OS_WIN
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
 
 #include "common.h"
 #include "applicationinfo.h"
 #include "psievent.h"
 #include "jidutil.h"
+#include "psioptions.h"
+#include "edbsegmentfile.h"
 
 using namespace XMPP;
 
 //----------------------------------------------------------------------------
 // EDBItem
 //----------------------------------------------------------------------------
-EDBItem::EDBItem(const PsiEvent::Ptr &event, const QString &id, const QString &prevId, const QString &nextId)
+EDBItem::EDBItem(const PsiEvent::Ptr &event, const QString &id, const QString &prevId, const QString &nextId, int score)
 {
 	e = event;
 	v_id = id;
 	v_prevId = prevId;
 	v_nextId = nextId;
+	v_score = score;
 }
 
 EDBItem::~EDBItem()
@@ -71,6 +85,12 @@ const QString & EDBItem::prevId() const
 	return v_prevId;
 }
 
+// relevance of a find() result, higher is better
+int EDBItem::score() const
+{
+	return v_score;
+}
+
 
 //----------------------------------------------------------------------------
 // EDBHandle
@@ -157,6 +177,17 @@ void EDBHandle::erase(const Jid &j)
 	d->listeningFor = d->edb->op_erase(j);
 }
 
+/**
+ * Builds the full-text index of the history with \a j from scratch,
+ * writeSuccess() tells whether it worked.
+ */
+void EDBHandle::rebuildTextIndex(const Jid &j)
+{
+	d->busy = true;
+	d->lastRequestType = Write;
+	d->listeningFor = d->edb->op_rebuildTextIndex(j);
+}
+
 bool EDBHandle::busy() const
 {
 	return d->busy;
@@ -274,6 +305,11 @@ int EDB::op_erase(const Jid &j)
 	return erase(j);
 }
 
+int EDB::op_rebuildTextIndex(const Jid &j)
+{
+	return rebuildTextIndex(j);
+}
+
 void EDB::resultReady(int req, EDBResult r)
 {
 	// deliver
@@ -298,7 +334,7 @@ void EDB::writeFinished(int req, bool b)
 
 
 //----------------------------------------------------------------------------
-// EDBFlatFile
+// EDBThreaded
 //----------------------------------------------------------------------------
 struct item_file_req
 {
@@ -309,7 +345,10 @@ struct item_file_req
 	int id;
 	int eventId;
 	QString findStr;
-	PsiEvent::Ptr event;
+	QString fileName;
+	QString line, text;
+	bool textIndex;
+	EDBStore::WritePolicy policy;
 
 	QDateTime first, last;
 	enum Type {
@@ -319,61 +358,154 @@ struct item_file_req
 		Type_append,
 		Type_find,
 		Type_getByDate,
-		Type_erase
+		Type_erase,
+		Type_rebuildTextIndex,
+		Type_quit
 	};
+
+	QAtomicPointer<item_file_req> next;
 };
 
-class EDBFlatFile::Private
+// Lock-free queue of requests with any number of producers and a single
+// consumer, after Dmitry Vyukov's intrusive MPSC queue.  Producers only
+// exchange the head pointer, the consumer owns the tail.
+class EDBRequestQueue
 {
 public:
-	Private() {}
+	EDBRequestQueue()
+	{
+		head.fetchAndStoreOrdered(&stub);
+		tail = &stub;
+	}
+
+	void push(item_file_req *r)
+	{
+		r->next.fetchAndStoreRelaxed(0);
+		item_file_req *prev = head.fetchAndStoreOrdered(r);
+		prev->next.fetchAndStoreRelease(r);
+	}
 
+	// returns 0 if the queue is empty or a push is still in progress
+	item_file_req *pop()
+	{
+		item_file_req *t = tail;
+		item_file_req *n = t->next.fetchAndAddAcquire(0);
+		if(t == &stub) {
+			if(!n)
+				return 0;
+			tail = n;
+			t = n;
+			n = n->next.fetchAndAddAcquire(0);
+		}
+		if(n) {
+			tail = n;
+			return t;
+		}
+		if(t != head.fetchAndAddAcquire(0))
+			return 0;
+		push(&stub);
+		n = t->next.fetchAndAddAcquire(0);
+		if(n) {
+			tail = n;
+			return t;
+		}
+		return 0;
+	}
+
+private:
+	QAtomicPointer<item_file_req> head;
+	item_file_req *tail;
+	item_file_req stub;
+};
+
+// Runs the requests of an EDBThreaded on a thread of its own and posts the
+// results back to the thread the EDBThreaded lives in.
+class EDBWorker : public QThread
+{
+public:
+	EDBWorker(EDB *edb, EDBThreaded::OpenStore, EDBThreaded::RemoveStore);
+	~EDBWorker();
+
+	void enqueue(item_file_req *r);
+
+protected:
+	void run();
+
+private:
+	typedef EDBStore File;
+
+	EDB *edb;
+	EDBThreaded::OpenStore openStore;
+	EDBThreaded::RemoveStore removeStore;
+	EDBRequestQueue queue;
+	QSemaphore pending;
 	QList<File*> flist;
-	QList<item_file_req*> rlist;
+
+	void performRequest(item_file_req *r);
+	void closeIdleFiles();
+	void deliver(int id, EDBResult result);
+	void deliverWrite(int id, bool b);
+	File *findFile(const Jid &) const;
+	File *ensureFile(const Jid &, const QString &fileName);
+	bool deleteFile(const Jid &, const QString &fileName);
 };
 
-EDBFlatFile::EDBFlatFile()
+class EDBThreaded::Private
+{
+public:
+	Private() {}
+
+	EDBWorker *worker;
+};
+
+EDBThreaded::EDBThreaded(OpenStore openStore, RemoveStore removeStore)
 :EDB()
 {
+	qRegisterMetaType<EDBResult>("EDBResult");
+
 	d = new Private;
+	d->worker = new EDBWorker(this, openStore, removeStore);
+	d->worker->start();
 }
 
-EDBFlatFile::~EDBFlatFile()
+EDBThreaded::~EDBThreaded()
 {
-	qDeleteAll(d->rlist);
-	qDeleteAll(d->flist);
-	d->flist.clear();
+	// the worker finishes all pending requests before it quits
+	item_file_req *r = new item_file_req;
+	r->type = item_file_req::Type_quit;
+	r->id = -1;
+	d->worker->enqueue(r);
+	d->worker->wait();
+	delete d->worker;
 
 	delete d;
 }
 
-int EDBFlatFile::getLatest(const Jid &j, int len)
+int EDBThreaded::getLatest(const Jid &j, int len)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
 	r->type = item_file_req::Type_getLatest;
 	r->len = len < 1 ? 1: len;
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-int EDBFlatFile::getOldest(const Jid &j, int len)
+int EDBThreaded::getOldest(const Jid &j, int len)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
 	r->type = item_file_req::Type_getOldest;
 	r->len = len < 1 ? 1: len;
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-int EDBFlatFile::get(const Jid &j, const QString &id, int direction, int len)
+int EDBThreaded::get(const Jid &j, const QString &id, int direction, int len)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
@@ -382,29 +514,27 @@ int EDBFlatFile::get(const Jid &j, const QString &id, int direction, int len)
 	r->dir = direction;
 	r->eventId = id.toInt();
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
 
-int EDBFlatFile::getByDate(const XMPP::Jid &jid, QDateTime first, QDateTime last)
+int EDBThreaded::getByDate(const XMPP::Jid &jid, QDateTime first, QDateTime last)
 {
 	item_file_req *r = new item_file_req;
 	r->j = jid;
 	r->type = item_file_req::Type_getByDate;
 	r->len = 1;
 	r->id = genUniqueId();
-	d->rlist.append(r);
 	r->first = first;
 	r->last = last;
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-int EDBFlatFile::find(const QString &str, const Jid &j, const QString &id, int direction)
+int EDBThreaded::find(const QString &str, const Jid &j, const QString &id, int direction)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
@@ -413,105 +543,215 @@ int EDBFlatFile::find(const QString &str, const Jid &j, const QString &id, int d
 	r->dir = direction;
 	r->findStr = str;
 	r->eventId = id.toInt();
+	r->textIndex = PsiOptions::instance()->getOption("options.history.full-text-index").toBool();
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-int EDBFlatFile::append(const Jid &j, const PsiEvent::Ptr &e)
+int EDBThreaded::append(const Jid &j, const PsiEvent::Ptr &e)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
 	r->type = item_file_req::Type_append;
-	r->event = e;
-	if ( !r->event ) {
-		qWarning("EDBFlatFile::append(): Attempted to append incompatible type.");
+	if ( !e ) {
+		qWarning("EDBThreaded::append(): Attempted to append incompatible type.");
 		delete r;
 		return 0;
 	}
+	// the event isn't touched outside of this thread
+	r->line = EDBStore::eventToLine(e);
+	r->text = EDBStore::eventText(e);
+
+	PsiOptions *o = PsiOptions::instance();
+	r->policy.interval = o->getOption("options.history.write-behind.interval").toInt();
+	r->policy.maxSize = o->getOption("options.history.write-behind.max-size").toInt();
+	QString sync = o->getOption("options.history.sync").toString();
+	if(sync == "flush")
+		r->policy.sync = EDBStore::WritePolicy::SyncOnFlush;
+	else if(sync == "close")
+		r->policy.sync = EDBStore::WritePolicy::SyncOnClose;
+	else
+		r->policy.sync = EDBStore::WritePolicy::SyncNever;
+	r->textIndex = PsiOptions::instance()->getOption("options.history.full-text-index").toBool();
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-int EDBFlatFile::erase(const Jid &j)
+int EDBThreaded::erase(const Jid &j)
 {
 	item_file_req *r = new item_file_req;
 	r->j = j;
 	r->type = item_file_req::Type_erase;
 	r->id = genUniqueId();
-	d->rlist.append(r);
 
-	QTimer::singleShot(FAKEDELAY, this, SLOT(performRequests()));
+	d->worker->enqueue(r);
+	return r->id;
+}
+
+int EDBThreaded::rebuildTextIndex(const Jid &j)
+{
+	item_file_req *r = new item_file_req;
+	r->j = j;
+	r->type = item_file_req::Type_rebuildTextIndex;
+	r->id = genUniqueId();
+
+	d->worker->enqueue(r);
 	return r->id;
 }
 
-EDBFlatFile::File *EDBFlatFile::findFile(const Jid &j) const
+void EDBThreaded::worker_resultReady(int id, EDBResult r)
+{
+	resultReady(id, r);
+}
+
+void EDBThreaded::worker_writeFinished(int id, bool b)
 {
-	foreach(File* i, d->flist) {
-		if(i->j.compare(j, false))
+	writeFinished(id, b);
+}
+
+
+//----------------------------------------------------------------------------
+// EDBWorker
+//----------------------------------------------------------------------------
+
+// files which weren't used for this long are closed
+static const int FILE_IDLE_TIMEOUT = 30000;
+
+EDBWorker::EDBWorker(EDB *_edb, EDBThreaded::OpenStore _openStore, EDBThreaded::RemoveStore _removeStore)
+{
+	edb = _edb;
+	openStore = _openStore;
+	removeStore = _removeStore;
+}
+
+EDBWorker::~EDBWorker()
+{
+	item_file_req *r;
+	while((r = queue.pop()))
+		delete r;
+	qDeleteAll(flist);
+}
+
+/**
+ * Queues \a r for the worker thread.  The file name is resolved here, since
+ * ApplicationInfo isn't safe to use from other threads.
+ */
+void EDBWorker::enqueue(item_file_req *r)
+{
+	if(r->type != item_file_req::Type_quit)
+		r->fileName = File::jidToFileName(r->j);
+	queue.push(r);
+	pending.release();
+}
+
+void EDBWorker::run()
+{
+	while(1) {
+		// sleep until the next request, or until some file's write-behind
+		// buffer is due
+		int wait = FILE_IDLE_TIMEOUT;
+		foreach(File *i, flist) {
+			int left = i->flushIfDue();
+			if(left >= 0 && left < wait)
+				wait = left;
+		}
+
+		if(!pending.tryAcquire(1, wait)) {
+			closeIdleFiles();
+			continue;
+		}
+
+		// the semaphore is released only after the push is complete, but
+		// the queue may still be catching up on its stub node
+		item_file_req *r;
+		while(!(r = queue.pop()))
+			yieldCurrentThread();
+
+		if(r->type == item_file_req::Type_quit) {
+			delete r;
+			break;
+		}
+
+		performRequest(r);
+		closeIdleFiles();
+	}
+
+	qDeleteAll(flist);
+	flist.clear();
+}
+
+void EDBWorker::deliver(int id, EDBResult result)
+{
+	// events are QObjects and have to live in the thread that uses them
+	foreach(EDBItemPtr i, result)
+		i->event()->moveToThread(edb->thread());
+	QMetaObject::invokeMethod(edb, "worker_resultReady", Qt::QueuedConnection,
+							  Q_ARG(int, id), Q_ARG(EDBResult, result));
+}
+
+void EDBWorker::deliverWrite(int id, bool b)
+{
+	QMetaObject::invokeMethod(edb, "worker_writeFinished", Qt::QueuedConnection,
+							  Q_ARG(int, id), Q_ARG(bool, b));
+}
+
+void EDBWorker::closeIdleFiles()
+{
+	foreach(File *i, flist) {
+		if(i->idle(FILE_IDLE_TIMEOUT)) {
+			flist.removeAll(i);
+			delete i;
+		}
+	}
+}
+
+EDBStore *EDBWorker::findFile(const Jid &j) const
+{
+	foreach(File* i, flist) {
+		if(i->jid().compare(j, false))
 			return i;
 	}
 	return 0;
 }
 
-EDBFlatFile::File *EDBFlatFile::ensureFile(const Jid &j)
+EDBStore *EDBWorker::ensureFile(const Jid &j, const QString &fileName)
 {
 	File *i = findFile(j);
 	if(!i) {
-		i = new File(Jid(j.bare()));
-		connect(i, SIGNAL(timeout()), SLOT(file_timeout()));
-		d->flist.append(i);
+		i = openStore(Jid(j.bare()), fileName);
+		flist.append(i);
 	}
 	return i;
 }
 
-bool EDBFlatFile::deleteFile(const Jid &j)
+bool EDBWorker::deleteFile(const Jid &j, const QString &fileName)
 {
 	File *i = findFile(j);
-
-	QString fname;
-
 	if (i) {
-		fname = i->fname;
-		d->flist.removeAll(i);
+		flist.removeAll(i);
 		delete i;
 	}
-	else {
-		fname = File::jidToFileName(j);
-	}
 
-	QFileInfo fi(fname);
-	if(fi.exists()) {
-		QDir dir = fi.dir();
-		return dir.remove(fi.fileName());
-	}
-	else
-		return true;
+	return removeStore(fileName);
 }
 
-void EDBFlatFile::performRequests()
+void EDBWorker::performRequest(item_file_req *r)
 {
-	if(d->rlist.isEmpty())
-		return;
-
-	item_file_req *r = d->rlist.takeFirst();
-
-	File *f = ensureFile(r->j);
+	File *f = ensureFile(r->j, r->fileName);
 	int type = r->type;
 	if(type >= item_file_req::Type_getLatest && type <= item_file_req::Type_get) {
 		int id, direction;
 
 		if(type == item_file_req::Type_getLatest) {
-			direction = Backward;
+			direction = EDB::Backward;
 			id = f->total()-1;
 		}
 		else if(type == item_file_req::Type_getOldest) {
-			direction = Forward;
+			direction = EDB::Forward;
 			id = 0;
 		}
 		else if(type == item_file_req::Type_get) {
@@ -519,12 +759,12 @@ void EDBFlatFile::performRequests()
 			id = r->eventId;
 		}
 		else {
-			qWarning("EDBFlatFile::performRequests(): Invalid type.");
+			qWarning("EDBWorker::performRequest(): Invalid type.");
 			return;
 		}
 
 		int len;
-		if(direction == Forward) {
+		if(direction == EDB::Forward) {
 			if(id + r->len > f->total())
 				len = f->total() - id;
 			else
@@ -537,9 +777,14 @@ void EDBFlatFile::performRequests()
 				len = r->len;
 		}
 
+		// read the whole window at once, in file order
+		QList<PsiEvent::Ptr> events;
+		if(len > 0)
+			events = f->get(direction == EDB::Forward ? id : id - (len-1), len);
+
 		EDBResult result;
 		for(int n = 0; n < len; ++n) {
-			PsiEvent::Ptr e(f->get(id));
+			PsiEvent::Ptr e(events[direction == EDB::Forward ? n : len-1 - n]);
 			if(e) {
 				QString prevId, nextId;
 				if(id > 0)
@@ -550,19 +795,48 @@ void EDBFlatFile::performRequests()
 				result.append(ei);
 			}
 
-			if(direction == Forward)
+			if(direction == EDB::Forward)
 				++id;
 			else
 				--id;
 		}
-		resultReady(r->id, result);
+		deliver(r->id, result);
 	}
 	else if(type == item_file_req::Type_append) {
-		writeFinished(r->id, f->append(r->event));
+		f->setWritePolicy(r->policy);
+		deliverWrite(r->id, f->append(r->line, r->text, r->textIndex));
 	}
 	else if(type == item_file_req::Type_find) {
 		int id = r->eventId;
 		EDBResult result;
+		QList<EDBTextIndex::Hit> hits;
+		if(r->textIndex && f->find(r->findStr, &hits)) {
+			// only look at the events the index points to, the best first
+			foreach(const EDBTextIndex::Hit &hit, hits) {
+				if(r->dir == EDB::Forward ? hit.first < id : hit.first > id)
+					continue;
+
+				PsiEvent::Ptr e(f->get(hit.first));
+				if(!e || e->type() != PsiEvent::Message)
+					continue;
+
+				MessageEvent::Ptr me = e.staticCast<MessageEvent>();
+				if(me->message().body().indexOf(r->findStr, 0, Qt::CaseInsensitive) == -1)
+					continue;
+
+				QString prevId, nextId;
+				if(hit.first > 0)
+					prevId = QString::number(hit.first-1);
+				if(hit.first < f->total()-1)
+					nextId = QString::number(hit.first+1);
+				EDBItemPtr ei = EDBItemPtr(new EDBItem(e, QString::number(hit.first), prevId, nextId, hit.second));
+				result.append(ei);
+			}
+			deliver(r->id, result);
+			delete r;
+			return;
+		}
+
 		while(1) {
 			PsiEvent::Ptr e(f->get(id));
 			if(!e)
@@ -585,28 +859,38 @@ void EDBFlatFile::performRequests()
 				}
 			}
 
-			if(r->dir == Forward)
+			if(r->dir == EDB::Forward)
 				++id;
 			else
 				--id;
 		}
-		resultReady(r->id, result);
+		deliver(r->id, result);
 	}
 	else if(type == item_file_req::Type_getByDate ) {
-		int id = 0;
+		// the date index narrows the search down to a few candidates, which
+		// are read in runs of consecutive events
+		QList<int> ids = f->findByDate(r->first, r->last);
 		EDBResult result;
-		for (int i=0; i < f->total(); ++i) {
-			PsiEvent::Ptr e(f->get(id));
-			if(!e)
-				continue;
-
-			QString prevId, nextId;
-			if(id > 0)
-				prevId = QString::number(id-1);
-			if(id < f->total()-1)
-				nextId = QString::number(id+1);
+		for(int n = 0; n < ids.count(); ) {
+			int start = ids[n];
+			int len = 1;
+			while(n + len < ids.count() && ids[n + len] == start + len)
+				++len;
+			n += len;
+
+			QList<PsiEvent::Ptr> events = f->get(start, len);
+			for(int k = 0; k < len; ++k) {
+				PsiEvent::Ptr e(events[k]);
+				if(!e || e->type() != PsiEvent::Message)
+					continue;
+
+				int id = start + k;
+				QString prevId, nextId;
+				if(id > 0)
+					prevId = QString::number(id-1);
+				if(id < f->total()-1)
+					nextId = QString::number(id+1);
 
-			if(e->type() == PsiEvent::Message) {
 				MessageEvent::Ptr me = e.staticCast<MessageEvent>();
 				const Message &m = me->message();
 				if(m.timeStamp() > r->first && m.timeStamp() < r->last ) {
@@ -614,104 +898,267 @@ void EDBFlatFile::performRequests()
 					result.append(ei);
 				}
 			}
-
-			++id;
 		}
-		resultReady(r->id, result);
+		deliver(r->id, result);
 	}
 
 	else if(type == item_file_req::Type_erase) {
-		writeFinished(r->id, deleteFile(f->j));
+		deliverWrite(r->id, deleteFile(f->jid(), r->fileName));
+	}
+	else if(type == item_file_req::Type_rebuildTextIndex) {
+		deliverWrite(r->id, f->rebuildTextIndex());
 	}
 
 	delete r;
 }
 
-void EDBFlatFile::file_timeout()
+
+//----------------------------------------------------------------------------
+// EDBFlatFile
+//----------------------------------------------------------------------------
+EDBFlatFile::EDBFlatFile()
+:EDBThreaded(openFile, removeFile)
+{
+}
+
+EDBFlatFile::~EDBFlatFile()
+{
+}
+
+EDBStore *EDBFlatFile::openFile(const Jid &j, const QString &fileName)
 {
-	File *i = (File *)sender();
-	d->flist.removeAll(i);
-	i->deleteLater();
+	// the history may have been kept in segments since it was last opened
+	if(!EDBSegmentFile::Store::exportFlat(j, fileName))
+		qWarning("EDBFlatFile: Converting %s back from segments failed.", qPrintable(fileName));
+	return new File(j, fileName);
+}
+
+bool EDBFlatFile::removeFile(const QString &fname)
+{
+	// segments which weren't converted back yet go as well
+	return EDBSegmentFile::removeStore(fname);
+}
+
+
+//----------------------------------------------------------------------------
+// EDBStore
+//----------------------------------------------------------------------------
+EDBStore::EDBStore(const Jid &_j)
+{
+	j = _j;
+	touch();
+}
+
+EDBStore::~EDBStore()
+{
+}
+
+const Jid & EDBStore::jid() const
+{
+	return j;
+}
+
+void EDBStore::touch()
+{
+	lastUse.start();
+}
+
+bool EDBStore::idle(int msecs) const
+{
+	return lastUse.elapsed() > msecs;
+}
+
+PsiEvent::Ptr EDBStore::get(int id)
+{
+	return get(id, 1).first();
+}
+
+/**
+ * Looks \a str up in the full-text index.  Returns false if the store has
+ * no index that can answer the query, and the events have to be searched.
+ */
+bool EDBStore::find(const QString &, QList<EDBTextIndex::Hit> *)
+{
+	return false;
+}
+
+/**
+ * Throws the full-text index away and builds it again from the events.
+ * Returns false if the store has no index, or it couldn't be saved.
+ */
+bool EDBStore::rebuildTextIndex()
+{
+	return false;
+}
+
+QString EDBStore::jidToFileName(const XMPP::Jid &j)
+{
+	return ApplicationInfo::historyDir() + "/" + JIDUtil::encode(j.bare()).toLower() + ".history";
+}
+
+// timestamp from the "|date|" field a history line starts with
+uint EDBStore::lineTime(const QByteArray &head)
+{
+	if(!head.startsWith('|'))
+		return 0;
+	int x = head.indexOf('|', 1);
+	if(x == -1)
+		return 0;
+	QDateTime ts = QDateTime::fromString(QString::fromLatin1(head.constData() + 1, x - 1), Qt::ISODate);
+	return ts.isValid() ? ts.toTime_t() : 0;
+}
+
+// forces what has been written to \a f onto the disk
+bool EDBStore::syncFile(QFile *f)
+{
+	if(!f->isOpen())
+		return false;
+#ifdef Q_OS_WIN
+	return _commit(f->handle()) == 0;
+#else
+	return fsync(f->handle()) == 0;
+#endif
+}
+
+// the part of an event that the full-text index covers
+QString EDBStore::eventText(const PsiEvent::Ptr &e)
+{
+	if(!e || e->type() != PsiEvent::Message)
+		return QString();
+	return e.staticCast<MessageEvent>()->message().body();
 }
 
 
 //----------------------------------------------------------------------------
 // EDBFlatFile::File
 //----------------------------------------------------------------------------
+
+// The line index of "<jid>.history" is kept in "<jid>.history.idx", so it
+// doesn't have to be rebuilt every time the history file is opened.  The
+// index file is a header followed by one fixed-size record per line:
+//
+//   header: magic, version, history size, history mtime, end of last line
+//   record: line offset, line timestamp (time_t, 0 if unknown)
+//
+// The index is trusted as is only while the recorded size and mtime match
+// the history file.  If the history file has grown behind our back, only the
+// lines after the recorded end of the last line are scanned.
+static const quint32 INDEX_MAGIC = 0x50534958; // "PSIX"
+static const quint32 INDEX_VERSION = 1;
+static const int INDEX_HEADER_SIZE = 32;
+static const int INDEX_RECORD_SIZE = 12;
+static const int SCAN_BLOCK_SIZE = 65536;
+static const int LINE_HEAD_SIZE = 32;
+
+// the full-text index lives in "<jid>.history.fts" and is built on the
+// first search; its journal is folded into a new snapshot once it gets long
+static const int TEXTINDEX_BATCH = 256;
+static const int TEXTINDEX_MAX_JOURNAL = 1024;
+
+// Events are grouped into blocks for the date index.  For every block it
+// has the latest timestamp of the block and all blocks before it, and the
+// earliest timestamp of the block and all blocks after it.  Both are sorted
+// even when events weren't appended in time order, so the blocks which may
+// hold a time range can be binary searched.
+static const int DATEINDEX_BLOCK = 256;
+
 class EDBFlatFile::File::Private
 {
 public:
 	Private() {}
 
 	QVector<quint64> index;
+	QVector<uint> times;
+	QVector<uint> latestBefore, earliestAfter;
+	int datesIndexed;
+	quint64 indexEnd;
 	bool indexed;
+	QFile idx;
+	EDBTextIndex *fts;
+
+	uchar *map;
+	quint64 mapSize;
+
+	WritePolicy policy;
+	QByteArray pending;
+	QTime pendingSince;
+	QList< QPair<int, QString> > pendingText;
+	quint64 committed;
+	int indexSaved;
 };
 
-EDBFlatFile::File::File(const Jid &_j)
+EDBFlatFile::File::File(const Jid &_j, const QString &fileName)
+:EDBStore(_j)
 {
 	d = new Private;
 	d->indexed = false;
+	d->indexEnd = 0;
+	d->datesIndexed = 0;
+	d->map = 0;
+	d->mapSize = 0;
+	d->fts = 0;
+	d->policy.interval = 0;
+	d->policy.maxSize = 0;
+	d->policy.sync = WritePolicy::SyncNever;
+	d->indexSaved = 0;
 
-	j = _j;
 	valid = false;
-	t = new QTimer(this);
-	connect(t, SIGNAL(timeout()), SLOT(timer_timeout()));
 
 	//printf("[EDB opening -- %s]\n", j.full().latin1());
-	fname = jidToFileName(_j);
+	fname = fileName;
 	f.setFileName(fname);
 	valid = f.open(QIODevice::ReadWrite);
-
-	touch();
+	d->committed = valid ? f.size() : 0;
 }
 
 EDBFlatFile::File::~File()
 {
+	flush();
+	if(d->policy.sync != WritePolicy::SyncNever)
+		syncFile(&f);
+	unmap();
 	if(valid)
 		f.close();
+	if(d->idx.isOpen())
+		d->idx.close();
+	delete d->fts;
 	//printf("[EDB closing -- %s]\n", j.full().latin1());
 
 	delete d;
 }
 
-QString EDBFlatFile::File::jidToFileName(const XMPP::Jid &j)
+QString EDBFlatFile::File::indexFileName(const QString &historyFileName)
 {
-	return ApplicationInfo::historyDir() + "/" + JIDUtil::encode(j.bare()).toLower() + ".history";
+	return historyFileName + ".idx";
+}
+
+QString EDBFlatFile::File::textIndexFileName(const QString &historyFileName)
+{
+	return historyFileName + ".fts";
 }
 
 void EDBFlatFile::File::ensureIndex()
 {
 	if ( valid && !d->indexed ) {
+		// unindexed lines may be waiting to be written
+		flush();
+
 		if (f.isSequential()) {
 			qWarning("EDBFlatFile::File::ensureIndex(): Can't index sequential files.");
 			return;
 		}
 
-		f.reset(); // go to beginning
-		d->index.clear();
-
-		//printf(" file: %s\n", fname.latin1());
-		// build index
-		while(1) {
-			quint64 at = f.pos();
-
-			// locate a newline
-			bool found = false;
-			char c;
-			while (f.getChar(&c)) {
-				if (c == '\n') {
-					found = true;
-					break;
-				}
-			}
-
-			if(!found)
-				break;
-
-			int oldsize = d->index.size();
-			d->index.resize(oldsize+1);
-			d->index[oldsize] = at;
+		d->latestBefore.clear();
+		d->earliestAfter.clear();
+		d->datesIndexed = 0;
+		if(!loadIndexFile()) {
+			d->index.clear();
+			d->times.clear();
+			d->indexEnd = 0;
+			scanIndex(0);
+			saveIndexFile();
 		}
+		updateDateIndex();
 
 		d->indexed = true;
 	}
@@ -722,73 +1169,461 @@ void EDBFlatFile::File::ensureIndex()
 	//printf(" messages: %d\n\n", d->index.size());
 }
 
+void EDBFlatFile::File::scanIndex(quint64 start)
+{
+	QByteArray head;
+	quint64 lineStart = start;
+
+	// scan the mapped file if possible, fall back to reading it in blocks
+	if(ensureMap(start)) {
+		scanBlock((const char *)d->map + start, d->mapSize - start, start, &lineStart, &head);
+	}
+	else if(f.seek(start)) {
+		QByteArray buf(SCAN_BLOCK_SIZE, 0);
+		quint64 at = start;
+		while(1) {
+			qint64 size = f.read(buf.data(), buf.size());
+			if(size <= 0)
+				break;
+			scanBlock(buf.constData(), size, at, &lineStart, &head);
+			at += size;
+		}
+	}
+
+	// a trailing line without a newline isn't indexed yet
+	d->indexEnd = lineStart;
+}
+
+// Indexes the lines which end in the block of 'size' bytes at file offset
+// 'at'.  'lineStart' and 'head' carry the offset and the first bytes of the
+// current line from one block to the next.
+void EDBFlatFile::File::scanBlock(const char *p, qint64 size, quint64 at, quint64 *lineStart, QByteArray *head)
+{
+	const char *end = p + size;
+	const char *ls = p;
+	while(ls < end) {
+		const char *nl = (const char *)memchr(ls, '\n', end - ls);
+		if(head->size() < LINE_HEAD_SIZE)
+			head->append(ls, qMin<qint64>(LINE_HEAD_SIZE - head->size(), (nl ? nl : end) - ls));
+		if(!nl)
+			break;
+
+		d->index.append(*lineStart);
+		d->times.append(lineTime(*head));
+		head->clear();
+		*lineStart = at + (nl + 1 - p);
+		ls = nl + 1;
+	}
+}
+
+// Maps the history file for reading.  The mapping covers the whole file as
+// of the call and is redone only once bytes past its end are needed.
+bool EDBFlatFile::File::ensureMap(quint64 needed)
+{
+	if(d->map && d->mapSize >= needed)
+		return true;
+
+	unmap();
+	qint64 size = f.size();
+	if(size <= 0 || quint64(size) < needed)
+		return false;
+
+	d->map = f.map(0, size);
+	if(!d->map)
+		return false;
+	d->mapSize = size;
+	return true;
+}
+
+void EDBFlatFile::File::unmap()
+{
+	if(d->map) {
+		f.unmap(d->map);
+		d->map = 0;
+		d->mapSize = 0;
+	}
+}
+
+void EDBFlatFile::File::updateDateIndex()
+{
+	for(int id = d->datesIndexed; id < d->times.size(); ++id) {
+		int b = id / DATEINDEX_BLOCK;
+		if(b == d->latestBefore.size()) {
+			d->latestBefore.append(b > 0 ? d->latestBefore[b-1] : 0);
+			d->earliestAfter.append(UINT_MAX);
+		}
+
+		uint t = d->times[id];
+		if(t == 0)
+			continue;
+		if(t > d->latestBefore[b])
+			d->latestBefore[b] = t;
+		// stops right away as long as events come in time order
+		for(int k = b; k >= 0 && d->earliestAfter[k] > t; --k)
+			d->earliestAfter[k] = t;
+	}
+	d->datesIndexed = d->times.size();
+}
+
+/**
+ * Returns the ids of the events with a timestamp between \a first and
+ * \a last, as far as the index can tell.  Only whole seconds are indexed,
+ * so the events themselves have to be checked for exact bounds.
+ */
+QList<int> EDBFlatFile::File::findByDate(const QDateTime &first, const QDateTime &last)
+{
+	touch();
+
+	QList<int> ids;
+	if(!valid)
+		return ids;
+
+	ensureIndex();
+	uint from = first.toTime_t();
+	uint to = last.toTime_t();
+	int lo = qLowerBound(d->latestBefore.constBegin(), d->latestBefore.constEnd(), from) - d->latestBefore.constBegin();
+	int hi = qUpperBound(d->earliestAfter.constBegin(), d->earliestAfter.constEnd(), to) - d->earliestAfter.constBegin();
+	int end = qMin(hi * DATEINDEX_BLOCK, d->times.size());
+	for(int id = lo * DATEINDEX_BLOCK; id < end; ++id) {
+		uint t = d->times[id];
+		if(t != 0 && t >= from && t <= to)
+			ids.append(id);
+	}
+	return ids;
+}
+
+bool EDBFlatFile::File::openIndexFile()
+{
+	if(d->idx.isOpen())
+		return true;
+	d->idx.setFileName(indexFileName(fname));
+	return d->idx.open(QIODevice::ReadWrite);
+}
+
+bool EDBFlatFile::File::loadIndexFile()
+{
+	if(!openIndexFile())
+		return false;
+
+	qint64 idxSize = d->idx.size();
+	if(idxSize < INDEX_HEADER_SIZE || (idxSize - INDEX_HEADER_SIZE) % INDEX_RECORD_SIZE != 0)
+		return false;
+
+	d->idx.reset();
+	QDataStream hs(d->idx.read(INDEX_HEADER_SIZE));
+	quint32 magic, version;
+	quint64 size, end;
+	qint64 mtime;
+	hs >> magic >> version >> size >> mtime >> end;
+	if(hs.status() != QDataStream::Ok || magic != INDEX_MAGIC || version != INDEX_VERSION)
+		return false;
+
+	quint64 curSize = f.size();
+	qint64 curMtime = QFileInfo(fname).lastModified().toTime_t();
+	if(size > curSize || end > size)
+		return false;
+
+	// if the file has been written to since, the indexed part must still
+	// end at a line boundary
+	bool changed = (size != curSize || mtime != curMtime);
+	if(changed && end > 0) {
+		char c;
+		if(!f.seek(end - 1) || !f.getChar(&c) || c != '\n')
+			return false;
+	}
+
+	int count = (idxSize - INDEX_HEADER_SIZE) / INDEX_RECORD_SIZE;
+	QDataStream rs(d->idx.read(qint64(count) * INDEX_RECORD_SIZE));
+	d->index.resize(count);
+	d->times.resize(count);
+	for(int n = 0; n < count; ++n)
+		rs >> d->index[n] >> d->times[n];
+	if(rs.status() != QDataStream::Ok || (count > 0 && d->index[count-1] >= end))
+		return false;
+	d->indexEnd = end;
+
+	if(changed) {
+		scanIndex(end);
+		appendIndexFile(count);
+	}
+
+	return true;
+}
+
+void EDBFlatFile::File::saveIndexFile()
+{
+	if(!openIndexFile())
+		return;
+
+	d->idx.resize(0);
+	appendIndexFile(0);
+}
+
+void EDBFlatFile::File::appendIndexFile(int from)
+{
+	if(!openIndexFile())
+		return;
+
+	QByteArray records;
+	QDataStream rs(&records, QIODevice::WriteOnly);
+	for(int n = from; n < d->index.size(); ++n)
+		rs << d->index[n] << d->times[n];
+
+	QByteArray header;
+	QDataStream hs(&header, QIODevice::WriteOnly);
+	hs << INDEX_MAGIC << INDEX_VERSION << quint64(f.size())
+	   << qint64(QFileInfo(fname).lastModified().toTime_t()) << quint64(d->indexEnd);
+
+	// records go first, so that an interrupted update leaves a header
+	// which doesn't match the records and gets the index rebuilt
+	d->idx.seek(INDEX_HEADER_SIZE + qint64(from) * INDEX_RECORD_SIZE);
+	d->idx.write(records);
+	d->idx.seek(0);
+	d->idx.write(header);
+	d->idx.flush();
+	d->indexSaved = d->index.size();
+}
+
 int EDBFlatFile::File::total() const
 {
 	((EDBFlatFile::File *)this)->ensureIndex();
 	return d->index.size();
 }
 
-void EDBFlatFile::File::touch()
+QList<PsiEvent::Ptr> EDBFlatFile::File::get(int id, int len)
 {
-	t->start(30000);
+	touch();
+
+	QList<PsiEvent::Ptr> events;
+	if(!valid) {
+		for(int n = 0; n < len; ++n)
+			events.append(PsiEvent::Ptr());
+		return events;
+	}
+
+	ensureIndex();
+	int total = d->index.size();
+	int first = qBound(0, id, total);
+	int last = qBound(first, id + len, total); // one past the end
+	for(int n = id; n < first; ++n)
+		events.append(PsiEvent::Ptr());
+
+	if(first < last) {
+		quint64 begin = d->index[first];
+		quint64 end = last < total ? d->index[last] : d->indexEnd;
+		if(end > d->committed)
+			flush();
+
+		if(ensureMap(end)) {
+			// decode the whole window in one go, then split it into lines
+			QString text = QString::fromUtf8((const char *)d->map + begin, end - begin);
+			int at = 0;
+			for(int n = first; n < last; ++n) {
+				int nl = text.indexOf('\n', at);
+				if(nl == -1)
+					nl = text.length();
+				int lineEnd = (nl > at && text[nl-1] == '\r') ? nl-1 : nl;
+				events.append(lineToEvent(text.mid(at, lineEnd - at)));
+				at = nl + 1;
+			}
+		}
+		else {
+			f.seek(begin);
+
+			QTextStream t;
+			t.setDevice(&f);
+			t.setCodec("UTF-8");
+			for(int n = first; n < last; ++n)
+				events.append(lineToEvent(t.readLine()));
+		}
+	}
+
+	while(events.count() < len)
+		events.append(PsiEvent::Ptr());
+	return events;
 }
 
-void EDBFlatFile::File::timer_timeout()
+bool EDBFlatFile::File::find(const QString &str, QList<EDBTextIndex::Hit> *hits)
 {
-	timeout();
+	touch();
+
+	if(!valid || EDBTextIndex::tokenize(str).isEmpty())
+		return false;
+
+	ensureTextIndex();
+	*hits = d->fts->find(str);
+	return true;
 }
 
-PsiEvent::Ptr EDBFlatFile::File::get(int id)
+bool EDBFlatFile::File::rebuildTextIndex()
 {
 	touch();
 
 	if(!valid)
-		return PsiEvent::Ptr();
+		return false;
 
+	// an empty index instead of the one on disk, which is saved even if
+	// there are no events
+	if(!d->fts)
+		d->fts = new EDBTextIndex(textIndexFileName(fname));
+	d->fts->clear();
+	QFile::remove(d->fts->fileName());
+	return ensureTextIndex();
+}
+
+// Loads the full-text index, building it if there is none yet, and adds
+// whatever was appended to the history while the index wasn't maintained.
+// Returns false if the index had to be saved and that failed.
+bool EDBFlatFile::File::ensureTextIndex()
+{
 	ensureIndex();
-	if(id < 0 || id >= (int)d->index.size())
-		return PsiEvent::Ptr();
+	flush();
+	if(!d->fts) {
+		d->fts = new EDBTextIndex(textIndexFileName(fname));
+		d->fts->load();
+	}
 
-	f.seek(d->index[id]);
+	int total = d->index.size();
+	if(d->fts->count() > total)
+		d->fts->clear();
 
-	QTextStream t;
-	t.setDevice(&f);
-	t.setCodec("UTF-8");
-	QString line = t.readLine();
+	int start = d->fts->count();
+	for(int id = start; id < total; id += TEXTINDEX_BATCH) {
+		QList<PsiEvent::Ptr> events = get(id, qMin(TEXTINDEX_BATCH, total - id));
+		for(int n = 0; n < events.count(); ++n)
+			d->fts->add(id + n, eventText(events[n]));
+	}
 
-	return lineToEvent(line);
+	if(d->fts->count() > start || d->fts->journalSize() > TEXTINDEX_MAX_JOURNAL || !QFile::exists(d->fts->fileName()))
+		return d->fts->save();
+	return true;
 }
 
-bool EDBFlatFile::File::append(const PsiEvent::Ptr &e)
+/**
+ * Appends \a line to the history.  The line goes to the write-behind buffer
+ * first, which is written out once it's older than the write policy allows,
+ * gets too large, or some of it needs to be read back.
+ */
+bool EDBFlatFile::File::append(const QString &line, const QString &text, bool textIndex)
 {
 	touch();
 
 	if(!valid)
 		return false;
 
-	QString line = eventToLine(e);
 	if(line.isEmpty())
 		return false;
 
-	f.seek(f.size());
-	quint64 at = f.pos();
+	// the full-text index is keyed by event number
+	if(textIndex)
+		ensureIndex();
 
-	QTextStream t;
-	t.setDevice(&f);
-	t.setCodec("UTF-8");
-	t << line << endl;
-	f.flush();
+	if(d->pending.isEmpty())
+		d->pendingSince.start();
+	quint64 at = d->committed + d->pending.size();
+	d->pending += line.toUtf8();
+	d->pending += '\n';
 
+	// an index which isn't loaded is brought up to date on the next load
 	if ( d->indexed ) {
-		int oldsize = d->index.size();
-		d->index.resize(oldsize+1);
-		d->index[oldsize] = at;
+		int id = d->index.size();
+		d->index.append(at);
+		d->times.append(lineTime(line.left(LINE_HEAD_SIZE).toUtf8()));
+		d->indexEnd = d->committed + d->pending.size();
+		updateDateIndex();
+
+		if(textIndex)
+			d->pendingText.append(qMakePair(id, text));
+	}
+
+	if(d->policy.interval <= 0 || d->pending.size() >= d->policy.maxSize)
+		return flush();
+	return true;
+}
+
+/**
+ * Writes out the write-behind buffer, along with the index entries of the
+ * lines in it.  If that fails, the lines are dropped along with their
+ * entries.
+ */
+bool EDBFlatFile::File::flush()
+{
+	if(d->pending.isEmpty())
+		return true;
+
+	bool ok = f.seek(d->committed) && f.write(d->pending) == d->pending.size();
+	ok = f.flush() && ok;
+	if(!ok) {
+		qWarning("EDBFlatFile::File::flush(): Writing to %s failed.", qPrintable(fname));
+
+		// the lines are lost, so must be their index entries, and whatever
+		// part of them made it to the file
+		f.resize(d->committed);
+		d->pending.clear();
+		d->pendingText.clear();
+		if(d->indexed) {
+			int count = d->index.size();
+			while(count > 0 && d->index[count-1] >= d->committed)
+				--count;
+			d->index.resize(count);
+			d->times.resize(count);
+			d->indexEnd = d->committed;
+			d->indexSaved = qMin(d->indexSaved, count);
+
+			d->latestBefore.clear();
+			d->earliestAfter.clear();
+			d->datesIndexed = 0;
+			updateDateIndex();
+		}
+		return false;
 	}
+	if(d->policy.sync == WritePolicy::SyncOnFlush)
+		syncFile(&f);
+
+	d->pending.clear();
+	d->committed = f.size();
+
+	if(d->indexed && d->indexSaved < d->index.size())
+		appendIndexFile(d->indexSaved);
+
+	typedef QPair<int, QString> PendingText;
+	foreach(const PendingText &p, d->pendingText) {
+		if(d->fts)
+			d->fts->journal(p.first, p.second);
+		else
+			EDBTextIndex::appendJournal(textIndexFileName(fname), p.first, p.second);
+	}
+	d->pendingText.clear();
+	if(d->fts && d->fts->journalSize() > TEXTINDEX_MAX_JOURNAL)
+		d->fts->save();
 
 	return true;
 }
 
-PsiEvent::Ptr EDBFlatFile::File::lineToEvent(const QString &line)
+/**
+ * Flushes the write-behind buffer if it has been held back long enough.
+ * Returns the number of msecs until it has to be flushed, or -1 if there is
+ * nothing to flush.
+ */
+int EDBFlatFile::File::flushIfDue()
+{
+	if(d->pending.isEmpty())
+		return -1;
+
+	int left = d->policy.interval - d->pendingSince.elapsed();
+	if(left > 0)
+		return left;
+
+	flush();
+	return -1;
+}
+
+void EDBFlatFile::File::setWritePolicy(const WritePolicy &policy)
+{
+	d->policy = policy;
+}
+
+PsiEvent::Ptr EDBStore::lineToEvent(const QString &line)
 {
 	// -- read the line --
 	QString sTime, sType, sOrigin, sFlags, sText, sSubj, sUrl, sUrlDesc;
@@ -895,7 +1730,7 @@ PsiEvent::Ptr EDBFlatFile::File::lineToEvent(const QString &line)
 	return PsiEvent::Ptr();
 }
 
-QString EDBFlatFile::File::eventToLine(const PsiEvent::Ptr &e)
+QString EDBStore::eventToLine(const PsiEvent::Ptr &e)
 {
 	int subflags = 0;
 	QString sTime, sType, sOrigin, sFlags;
@@ -22,27 +22,32 @@
 #define EVENTDB_H
 
 #include <QObject>
+#include <QCoreApplication>
 #include <QTimer>
+#include <QTime>
 #include <QFile>
 #include <QSharedPointer>
 #include <QDateTime>
 
 #include "xmpp_jid.h"
 #include "psievent.h"
+#include "edbtextindex.h"
 
 class EDBItem
 {
 public:
-	EDBItem(const PsiEvent::Ptr &, const QString &id, const QString &nextId, const QString &prevId);
+	EDBItem(const PsiEvent::Ptr &, const QString &id, const QString &nextId, const QString &prevId, int score = 0);
 	~EDBItem();
 
 	PsiEvent::Ptr event() const;
 	const QString & id() const;
 	const QString & nextId() const;
 	const QString & prevId() const;
+	int score() const;
 
 private:
 	QString v_id, v_prevId, v_nextId;
+	int v_score;
 	PsiEvent::Ptr e;
 };
 
@@ -66,6 +71,7 @@ public:
 	void find(const QString &, const XMPP::Jid &, const QString &id, int direction);
 	void append(const XMPP::Jid &, const PsiEvent::Ptr &);
 	void erase(const XMPP::Jid &);
+	void rebuildTextIndex(const XMPP::Jid &);
 
 	bool busy() const;
 	const EDBResult result() const;
@@ -102,6 +108,7 @@ protected:
 	virtual int append(const XMPP::Jid &, const PsiEvent::Ptr &)=0;
 	virtual int find(const QString &, const XMPP::Jid &, const QString &id, int direction)=0;
 	virtual int erase(const XMPP::Jid &)=0;
+	virtual int rebuildTextIndex(const XMPP::Jid &)=0;
 	void resultReady(int, EDBResult);
 	void writeFinished(int, bool);
 
@@ -120,14 +127,71 @@ private:
 	int op_find(const QString &, const XMPP::Jid &, const QString &id, int direction);
 	int op_append(const XMPP::Jid &, const PsiEvent::Ptr&);
 	int op_erase(const XMPP::Jid &);
+	int op_rebuildTextIndex(const XMPP::Jid &);
 };
 
-class EDBFlatFile : public EDB
+/**
+ * History of one contact, as kept by an EDBThreaded backend.  Events are
+ * numbered from 0 in the order they were appended and are stored as lines
+ * in the format of eventToLine().  Stores are only used by the worker thread.
+ */
+class EDBStore
+{
+	Q_DECLARE_TR_FUNCTIONS(EDBFlatFile::File)
+public:
+	// how appended lines are held back before they are written
+	struct WritePolicy
+	{
+		enum Sync { SyncNever, SyncOnClose, SyncOnFlush };
+
+		int interval; // msecs, 0 to write right away
+		int maxSize;  // bytes
+		Sync sync;
+	};
+
+	EDBStore(const XMPP::Jid &);
+	virtual ~EDBStore();
+
+	const XMPP::Jid & jid() const;
+	void touch();
+	bool idle(int msecs) const;
+
+	virtual int total() const=0;
+	PsiEvent::Ptr get(int);
+	virtual QList<PsiEvent::Ptr> get(int id, int len)=0;
+	virtual bool find(const QString &, QList<EDBTextIndex::Hit> *hits);
+	virtual bool rebuildTextIndex();
+	virtual QList<int> findByDate(const QDateTime &first, const QDateTime &last)=0;
+	virtual bool append(const QString &line, const QString &text, bool textIndex)=0;
+	virtual bool flush()=0;
+	virtual int flushIfDue()=0;
+	virtual void setWritePolicy(const WritePolicy &)=0;
+
+	static QString jidToFileName(const XMPP::Jid &);
+	static QString eventToLine(const PsiEvent::Ptr&);
+	static QString eventText(const PsiEvent::Ptr&);
+	static uint lineTime(const QByteArray &);
+
+protected:
+	PsiEvent::Ptr lineToEvent(const QString &);
+	static bool syncFile(QFile *);
+
+	XMPP::Jid j;
+	QTime lastUse;
+};
+
+/**
+ * Base of the backends which keep one EDBStore per contact and run all
+ * requests on a worker thread.
+ */
+class EDBThreaded : public EDB
 {
 	Q_OBJECT
 public:
-	EDBFlatFile();
-	~EDBFlatFile();
+	typedef EDBStore *(*OpenStore)(const XMPP::Jid &, const QString &fileName);
+	typedef bool (*RemoveStore)(const QString &fileName);
+
+	~EDBThreaded();
 
 	int getLatest(const XMPP::Jid &, int len);
 	int getOldest(const XMPP::Jid &, int len);
@@ -136,56 +200,74 @@ public:
 	int find(const QString &, const XMPP::Jid &, const QString &id, int direction);
 	int append(const XMPP::Jid &, const PsiEvent::Ptr&);
 	int erase(const XMPP::Jid &);
+	int rebuildTextIndex(const XMPP::Jid &);
 
-	class File;
+protected:
+	EDBThreaded(OpenStore, RemoveStore);
 
 private slots:
-	void performRequests();
-	void file_timeout();
+	void worker_resultReady(int, EDBResult);
+	void worker_writeFinished(int, bool);
 
 private:
 	class Private;
 	Private *d;
-
-	File *findFile(const XMPP::Jid &) const;
-	File *ensureFile(const XMPP::Jid &);
-	bool deleteFile(const XMPP::Jid &);
 };
 
-class EDBFlatFile::File : public QObject
+class EDBFlatFile : public EDBThreaded
 {
 	Q_OBJECT
 public:
-	File(const XMPP::Jid &_j);
-	~File();
+	EDBFlatFile();
+	~EDBFlatFile();
 
-	int total() const;
-	void touch();
-	PsiEvent::Ptr get(int);
-	bool append(const PsiEvent::Ptr &);
+	class File;
 
-	static QString jidToFileName(const XMPP::Jid &);
+private:
+	static EDBStore *openFile(const XMPP::Jid &, const QString &fileName);
+	static bool removeFile(const QString &fileName);
+};
 
-signals:
-	void timeout();
+class EDBFlatFile::File : public EDBStore
+{
+public:
+	File(const XMPP::Jid &_j, const QString &fileName);
+	~File();
 
-private slots:
-	void timer_timeout();
+	using EDBStore::get;
+	int total() const;
+	QList<PsiEvent::Ptr> get(int id, int len);
+	bool find(const QString &, QList<EDBTextIndex::Hit> *hits);
+	bool rebuildTextIndex();
+	QList<int> findByDate(const QDateTime &first, const QDateTime &last);
+	bool append(const QString &line, const QString &text, bool textIndex);
+	bool flush();
+	int flushIfDue();
+	void setWritePolicy(const WritePolicy &);
+
+	static QString indexFileName(const QString &);
+	static QString textIndexFileName(const QString &);
 
 public:
-	XMPP::Jid j;
 	QString fname;
 	QFile f;
 	bool valid;
-	QTimer *t;
 
 	class Private;
 	Private *d;
 
 private:
-	PsiEvent::Ptr lineToEvent(const QString &);
-	QString eventToLine(const PsiEvent::Ptr&);
 	void ensureIndex();
+	void scanIndex(quint64 start);
+	void scanBlock(const char *p, qint64 size, quint64 at, quint64 *lineStart, QByteArray *head);
+	bool ensureMap(quint64 needed);
+	void unmap();
+	bool openIndexFile();
+	bool loadIndexFile();
+	void saveIndexFile();
+	void appendIndexFile(int from);
+	void updateDateIndex();
+	bool ensureTextIndex();
 };
 
 #endif
@@ -26,6 +26,7 @@
 #include "accountlabel.h"
 #include "psioptions.h"
 #include "fileutil.h"
+#include "filetransferio.h"
 #include "xmpp_tasks.h"
 
 typedef quint64 LARGE_TYPE;
@@ -130,7 +131,8 @@ public:
 	qlonglong fileSize, sent, offset, length;
 	QString desc;
 	bool sending;
-	QFile f;
+	FileTransferIO *io;
+	bool pumping;
 	int shift;
 	int complement;
 	QString activeFile;
@@ -141,6 +143,8 @@ FileTransferHandler::FileTransferHandler(PsiAccount *pa, FileTransfer *ft)
 	d = new Private;
 	d->pa = pa;
 	d->c = 0;
+	d->io = 0;
+	d->pumping = false;
 
 	if(ft) {
 		d->sending = false;
@@ -171,6 +175,7 @@ FileTransferHandler::~FileTransferHandler()
 		d->ft->close();
 		delete d->ft;
 	}
+	delete d->io;
 	delete d;
 }
 
@@ -194,7 +199,7 @@ void FileTransferHandler::send(const XMPP::Jid &to, const QString &fname, const
 		d->ft->setProxy(proxy);
 	mapSignals();
 
-	d->f.setFileName(fname);
+	setFile(fname);
 
 	// try to make thumbnail
 	QImage img(fname);
@@ -252,6 +257,33 @@ QPixmap FileTransferHandler::fileIcon() const
 	return icon;
 }
 
+/**
+ * Returns the name of the algorithm of hash().
+ */
+QString FileTransferHandler::hashAlgorithm() const
+{
+	return FileTransferIO::hashAlgorithm();
+}
+
+/**
+ * Returns the hash of the whole file once hashReady() was emitted.  The
+ * file is hashed while it's read or written, for a resumed transfer the
+ * part which was there already is hashed along.
+ */
+QByteArray FileTransferHandler::hash() const
+{
+	return d->io ? d->io->hash() : QByteArray();
+}
+
+/**
+ * Returns true while the file is hashed, which can go on after the
+ * transfer is done.
+ */
+bool FileTransferHandler::isHashing() const
+{
+	return d->io && d->io->isHashing();
+}
+
 QString FileTransferHandler::description() const
 {
 	return d->desc;
@@ -290,7 +322,7 @@ void FileTransferHandler::accept(const QString &saveName, const QString &fileNam
 	d->filePath.chop(5);
 	d->offset = offset;
 	d->length = d->fileSize;
-	d->f.setFileName(saveName);
+	setFile(saveName);
 	d->ft->accept(offset);
 }
 
@@ -361,20 +393,10 @@ void FileTransferHandler::ft_connected()
 
 	if(d->sending) {
 		// open the file, and set the correct offset
-		bool ok = false;
-		if(d->f.open(QIODevice::ReadOnly)) {
-			if(d->offset == 0) {
-				ok = true;
-			}
-			else {
-				if(d->f.seek(d->offset))
-					ok = true;
-			}
-		}
-		if(!ok) {
+		if(!d->io->open(QIODevice::ReadOnly, d->offset)) {
 			delete d->ft;
 			d->ft = 0;
-			error(ErrFile, 0, d->f.errorString());
+			error(ErrFile, 0, d->io->errorString());
 			return;
 		}
 
@@ -388,24 +410,14 @@ void FileTransferHandler::ft_connected()
 		QIODevice::OpenMode m = QIODevice::ReadWrite;
 		if(d->offset == 0)
 			m |= QIODevice::Truncate;
-		bool ok = false;
-		if(d->f.open(m)) {
-			if(d->offset == 0) {
-				ok = true;
-			}
-			else {
-				if(d->f.seek(d->offset))
-					ok = true;
-			}
-		}
-		if(!ok) {
+		if(!d->io->open(m, d->offset)) {
 			delete d->ft;
 			d->ft = 0;
-			error(ErrFile, 0, d->f.errorString());
+			error(ErrFile, 0, d->io->errorString());
 			return;
 		}
 
-		d->activeFile = d->f.fileName();
+		d->activeFile = d->io->fileName();
 		active_file_add(d->activeFile);
 
 		// done already?  this means a file size of zero
@@ -420,14 +432,9 @@ void FileTransferHandler::ft_readyRead(const QByteArray &a)
 {
 	if(!d->sending) {
 		//printf("%d bytes read\n", a.size());
-		int r = d->f.write(a.data(), a.size());
-		if(r < 0) {
-			d->f.close();
-			delete d->ft;
-			d->ft = 0;
-			error(ErrFile, 0, d->f.errorString());
-			return;
-		}
+		// written behind in another thread, a disk which can't keep up
+		//   fails the transfer with io_error()
+		d->io->write(a);
 		d->sent += a.size();
 		doFinish();
 	}
@@ -439,20 +446,20 @@ void FileTransferHandler::ft_bytesWritten(qint64 x)
 		//printf("%d bytes written\n", x);
 		d->sent += x;
 		if(d->sent == d->fileSize) {
-			d->f.close();
+			d->io->close();
 			delete d->ft;
 			d->ft = 0;
 		}
 		else
-			QTimer::singleShot(0, this, SLOT(trySend()));
+			trySend();
 		progress(calcProgressStep(d->sent, d->complement, d->shift), d->sent);
 	}
 }
 
 void FileTransferHandler::ft_error(int x)
 {
-	if(d->f.isOpen())
-		d->f.close();
+	if(d->io)
+		d->io->close();
 	delete d->ft;
 	d->ft = 0;
 
@@ -470,11 +477,15 @@ void FileTransferHandler::ft_error(int x)
 
 void FileTransferHandler::trySend()
 {
-	// Since trySend comes from singleShot which is an "uncancelable"
+	// Since trySend can come from singleShot which is an "uncancelable"
 	//   action, we should protect that d->ft is valid, for good measure
 	if(!d->ft)
 		return;
 
+	// writeFileData() could report the data as written right away
+	if(d->pumping)
+		return;
+
 	// When FileTransfer emits error, you are not allowed to call
 	//   dataSizeNeeded() afterwards.  Simetime ago, we changed to using
 	//   QueuedConnection for error() signal delivery (see mapSignals()).
@@ -484,36 +495,73 @@ void FileTransferHandler::trySend()
 	//   is internally active by checking if s5bConnection() is null.
 	//   FIXME: this probably breaks other file transfer methods, whenever
 	//   we get those.  Probably we need a real fix in Iris..
-	if(!d->ft->bsConnection())
-		return;
-
-	int blockSize = d->ft->dataSizeNeeded();
-	QByteArray a(blockSize, 0);
-	int r = 0;
-	if(blockSize > 0)
-		r = d->f.read(a.data(), a.size());
-	if(r < 0) {
-		d->f.close();
-		delete d->ft;
-		d->ft = 0;
-		error(ErrFile, 0, d->f.errorString());
-		return;
+	// hand over all the connection takes and the file has ready, the
+	//   file is read ahead in another thread.  if it isn't ready yet,
+	//   io_readyRead() continues
+	d->pumping = true;
+	int blockSize;
+	while(d->ft && d->ft->bsConnection() && (blockSize = d->ft->dataSizeNeeded()) > 0) {
+		QByteArray a = d->io->read(blockSize);
+		if(a.isEmpty()) {
+			if(d->io->atEnd()) {
+				d->io->close();
+				delete d->ft;
+				d->ft = 0;
+				error(ErrFile, 0, tr("Unexpected end of file."));
+			}
+			break;
+		}
+		d->ft->writeFileData(a);
 	}
-	if(r < (int)a.size())
-		a.resize(r);
-	d->ft->writeFileData(a);
+	d->pumping = false;
 }
 
 void FileTransferHandler::doFinish()
 {
 	if(d->sent == d->fileSize) {
-		d->f.close();
+		// a received file is finished once it's written
+		if(!d->sending) {
+			d->io->flush();
+			return;
+		}
+
+		d->io->close();
 		delete d->ft;
 		d->ft = 0;
 	}
 	progress(calcProgressStep(d->sent, d->complement, d->shift), d->sent);
 }
 
+void FileTransferHandler::io_readyRead()
+{
+	trySend();
+}
+
+void FileTransferHandler::io_flushed()
+{
+	delete d->ft;
+	d->ft = 0;
+	progress(calcProgressStep(d->sent, d->complement, d->shift), d->sent);
+}
+
+void FileTransferHandler::io_error(const QString &s)
+{
+	d->io->close();
+	delete d->ft;
+	d->ft = 0;
+	error(ErrFile, 0, s);
+}
+
+void FileTransferHandler::setFile(const QString &fileName)
+{
+	delete d->io;
+	d->io = new FileTransferIO(fileName);
+	connect(d->io, SIGNAL(readyRead()), SLOT(io_readyRead()));
+	connect(d->io, SIGNAL(flushed()), SLOT(io_flushed()));
+	connect(d->io, SIGNAL(hashReady()), SIGNAL(hashReady()));
+	connect(d->io, SIGNAL(error(const QString &)), SLOT(io_error(const QString &)));
+}
+
 void FileTransferHandler::mapSignals()
 {
 	connect(d->ft, SIGNAL(accepted()), SLOT(ft_accepted()));
@@ -1103,6 +1151,7 @@ public:
 	int dist;
 	bool done;
 	QString error;
+	QString hash;
 	int height;
 	int margin;
 	ColumnWidthManager *cm;
@@ -1401,6 +1450,8 @@ public:
 		s += QString("\n") + FileTransDlg::tr("Size") + QString(": %1").arg(size);
 		if(done) {
 			s += QString("\n") + FileTransDlg::tr("[Done]");
+			if(!hash.isEmpty())
+				s += QString("\n") + hash;
 		}
 		else {
 			s += QString("\n") + FileTransDlg::tr("Transferred") + QString(": %1").arg(sent);
@@ -1590,6 +1641,7 @@ public:
 	int id;
 	int p;
 	qlonglong sent;
+	bool hashing; // done, only the hash is still to come
 
 	int at;
 	qlonglong last[10];
@@ -1598,6 +1650,7 @@ public:
 	{
 		h = 0;
 		at = 0;
+		hashing = false;
 	}
 
 	~TransferMapping()
@@ -1737,17 +1790,29 @@ public:
 				findItem(i->id)->fileicon = i->h->fileIcon();
 			}
 
+			// the hasher may still be at it, ft_hashReady() follows then
+			i->hashing = i->h->isHashing();
+			setHash(i);
+
 			PsiAccount *pa = i->h->account();
 			pa->playSound(PsiAccount::eFTComplete);
 		}
 
 		parent->setProgress(i->id, i->p, i->h->totalSteps(), i->sent, bps, updateAll);
 
-		if(done) {
+		if(done && !i->hashing) {
 			transferList.removeAll(i);
 			delete i;
 		}
 	}
+
+	void setHash(TransferMapping *i)
+	{
+		QByteArray hash = i->h->hash();
+		FileTransItem *fi = findItem(i->id);
+		if(fi && !hash.isEmpty())
+			fi->hash = i->h->hashAlgorithm().toUpper() + ": " + hash.toHex();
+	}
 };
 
 FileTransDlg::FileTransDlg(PsiCon *psi)
@@ -1890,6 +1955,7 @@ void FileTransDlg::takeTransfer(FileTransferHandler *h, int p, qlonglong sent)
 	FileTransItem *fi = d->findItem(i->id);
 	d->lv->scrollToItem(fi);
 
+	connect(h, SIGNAL(hashReady()), SLOT(ft_hashReady()));
 	if(p == i->h->totalSteps()) {
 		d->updateProgress(i, true);
 	}
@@ -1945,10 +2011,27 @@ void FileTransDlg::ft_error(int x, int, const QString &s)
 	setError(id, str);
 }
 
+void FileTransDlg::ft_hashReady()
+{
+	TransferMapping *i = d->findMapping((FileTransferHandler *)sender());
+	if(!i)
+		return;
+
+	// the tooltip is made up when it's shown, it picks the hash up
+	d->setHash(i);
+	if(i->hashing) {
+		d->transferList.removeAll(i);
+		// this is called from a signal of the handler
+		i->h->deleteLater();
+		i->h = 0;
+		delete i;
+	}
+}
+
 void FileTransDlg::updateItems()
 {
 	foreach (TransferMapping *i, d->transferList) {
-		if(i->h) {
+		if(i->h && !i->hashing) {
 			i->logSent();
 			d->updateProgress(i);
 		}
@@ -38,7 +38,9 @@ public:
 	QString saveName() const;
 	QString filePath() const;
 	QPixmap fileIcon() const;
-
+	QString hashAlgorithm() const;
+	QByteArray hash() const;
+	bool isHashing() const;
 
 	void send(const Jid &to, const QString &fname, const QString &desc);
 	void accept(const QString &saveName, const QString &fileName, qlonglong offset=0);
@@ -48,6 +50,7 @@ signals:
 	void statusMessage(const QString &s);
 	void connected();
 	void progress(int p, qlonglong sent);
+	void hashReady();
 	void error(int, int, const QString &s);
 
 private slots:
@@ -69,11 +72,17 @@ private slots:
 	void trySend();
 	void doFinish();
 
+	// file
+	void io_readyRead();
+	void io_flushed();
+	void io_error(const QString &);
+
 private:
 	class Private;
 	Private *d;
 
 	void mapSignals();
+	void setFile(const QString &fileName);
 };
 
 class FileRequestDlg : public QDialog, public Ui::FileTrans
@@ -131,6 +140,7 @@ private slots:
 	void clearFinished();
 	void ft_progress(int p, qlonglong sent);
 	void ft_error(int, int, const QString &s);
+	void ft_hashReady();
 	void updateItems();
 
 	void itemCancel(int);
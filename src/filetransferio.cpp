@@ -0,0 +1,484 @@
+/*
+ * filetransferio.cpp - file access of a file transfer in its own thread
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "filetransferio.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+// the size of the blocks which are read ahead, and how many of them
+#define FTIO_BLOCK_SIZE 65536
+#define FTIO_READ_AHEAD 2
+// how many blocks may wait to be written before the transfer fails
+#define FTIO_WRITE_LIMIT 256
+
+// SHA-256 needs Qt 5
+#if QT_VERSION >= 0x050000
+#	define FTIO_HASH QCryptographicHash::Sha256
+#	define FTIO_HASH_NAME "sha-256"
+#else
+#	define FTIO_HASH QCryptographicHash::Sha1
+#	define FTIO_HASH_NAME "sha-1"
+#endif
+
+//----------------------------------------------------------------------------
+// FileTransferIO::Hasher
+//----------------------------------------------------------------------------
+
+// Hashes the file on a handle of its own, from the start up to where the
+// worker is, so neither the part before the offset of a resumed transfer
+// nor the hashing itself holds up the transfer.
+class FileTransferIO::Hasher : public QThread
+{
+public:
+	Worker *w;
+	QFile file;
+	QCryptographicHash hasher;
+
+	Hasher(Worker *_w, const QString &fileName)
+		: w(_w)
+		, file(fileName)
+		, hasher(FTIO_HASH)
+	{
+	}
+
+protected:
+	void run();
+};
+
+//----------------------------------------------------------------------------
+// FileTransferIO::Worker
+//----------------------------------------------------------------------------
+
+class FileTransferIO::Worker : public QThread
+{
+	Q_OBJECT
+public:
+	QFile file;
+	bool reading;
+	qint64 offset;
+	Hasher hashThread;
+
+	QMutex mutex;
+	QWaitCondition cond;
+	bool stop, failed;
+	QString errorString;
+
+	// hashing
+	QWaitCondition hashCond;
+	qint64 hashable;        // the file is final up to here
+	bool complete;          // and won't grow anymore
+	bool hashStop;
+	QByteArray hash;        // set once the whole file was hashed
+
+	// reading
+	QList<QByteArray> blocks; // read ahead
+	QList<QByteArray> spare;  // taken by read(), reused if not shared anymore
+	int pos;                  // of the next byte in blocks.first()
+	bool eof, starving;
+
+	// writing
+	QList<QByteArray> queue;
+	qint64 queued; // bytes in queue or being written
+	bool flushing;
+
+	Worker(const QString &fileName)
+		: file(fileName)
+		, reading(true)
+		, offset(0)
+		, hashThread(this, fileName)
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		stop = failed = false;
+		hashable = 0;
+		complete = hashStop = false;
+		hash.clear();
+		blocks.clear();
+		spare.clear();
+		pos = 0;
+		eof = starving = false;
+		queue.clear();
+		queued = 0;
+		flushing = false;
+	}
+
+	// stops the hasher, which takes at most another block
+	void stopHashing()
+	{
+		mutex.lock();
+		hashStop = true;
+		hashCond.wakeAll();
+		mutex.unlock();
+		hashThread.wait();
+	}
+
+	// called with the mutex locked, error() is up to the caller
+	void fail(const QString &s)
+	{
+		failed = true;
+		hashStop = true;
+		hashCond.wakeAll();
+		cond.wakeAll();
+		errorString = s;
+	}
+
+signals:
+	void readyRead();
+	void flushed();
+	void hashReady();
+	void error(const QString &);
+
+protected:
+	void run()
+	{
+		if ( reading )
+			readAhead();
+		else
+			writeBehind();
+	}
+
+private:
+	// called with the mutex locked
+	void setHashable(qint64 pos, bool end)
+	{
+		hashable = pos;
+		complete = end;
+		hashCond.wakeAll();
+	}
+
+	void readAhead()
+	{
+		QMutexLocker locker(&mutex);
+		while ( !stop && !eof && !failed ) {
+			if ( blocks.count() >= FTIO_READ_AHEAD ) {
+				cond.wait(&mutex);
+				continue;
+			}
+
+			QByteArray block = spare.isEmpty() ? QByteArray() : spare.takeLast();
+			locker.unlock();
+			block.resize(FTIO_BLOCK_SIZE);
+			qint64 r = file.read(block.data(), block.size());
+			qint64 at = file.pos();
+			// the whole file could be taken before another read()
+			bool end = r == 0 || (r > 0 && file.atEnd());
+			locker.relock();
+
+			if ( r < 0 ) {
+				fail(file.errorString());
+				emit error(errorString);
+				break;
+			}
+			if ( r > 0 ) {
+				block.resize(int(r));
+				blocks += block;
+			}
+			if ( end ) {
+				eof = true;
+			}
+			setHashable(at, end);
+
+			if ( starving ) {
+				starving = false;
+				emit readyRead();
+			}
+		}
+	}
+
+	void writeBehind()
+	{
+		QMutexLocker locker(&mutex);
+		while ( !stop && !failed ) {
+			if ( queue.isEmpty() ) {
+				if ( flushing ) {
+					// the hasher finishes on its own
+					setHashable(hashable, true);
+					file.close();
+					emit flushed();
+					break;
+				}
+				cond.wait(&mutex);
+				continue;
+			}
+
+			QList<QByteArray> data = queue;
+			queue.clear();
+			locker.unlock();
+			bool ok = true;
+			foreach(const QByteArray &a, data) {
+				if ( file.write(a) != a.size() ) {
+					ok = false;
+					break;
+				}
+			}
+			// for the handle of the hasher
+			ok = ok && file.flush();
+			qint64 at = file.pos();
+			locker.relock();
+
+			foreach(const QByteArray &a, data) {
+				queued -= a.size();
+			}
+			if ( !ok ) {
+				fail(file.errorString());
+				emit error(errorString);
+			}
+			else {
+				setHashable(at, false);
+			}
+		}
+	}
+};
+
+void FileTransferIO::Hasher::run()
+{
+	hasher.reset();
+	bool ok = file.open(QIODevice::ReadOnly);
+
+	QByteArray block(FTIO_BLOCK_SIZE, 0);
+	qint64 pos = 0;
+	QMutexLocker locker(&w->mutex);
+	while ( ok && !w->hashStop ) {
+		if ( pos >= w->hashable ) {
+			if ( w->complete ) {
+				w->hash = hasher.result();
+				break;
+			}
+			w->hashCond.wait(&w->mutex);
+			continue;
+		}
+
+		qint64 end = w->hashable;
+		locker.unlock();
+		qint64 r = file.read(block.data(), qMin(end - pos, qint64(block.size())));
+		if ( r > 0 ) {
+			hasher.addData(block.constData(), int(r));
+			pos += r;
+		}
+		locker.relock();
+
+		// the file is gone or shorter than it should be, there is no hash
+		if ( r <= 0 ) {
+			break;
+		}
+	}
+	bool stopped = w->hashStop;
+	locker.unlock();
+	file.close();
+
+	// there is a hash now, or there won't be one
+	if ( !stopped ) {
+		QMetaObject::invokeMethod(w, "hashReady", Qt::QueuedConnection);
+	}
+}
+
+//----------------------------------------------------------------------------
+// FileTransferIO
+//----------------------------------------------------------------------------
+
+FileTransferIO::FileTransferIO(const QString &fileName, QObject *parent)
+	: QObject(parent)
+{
+	d = new Worker(fileName);
+	connect(d, SIGNAL(readyRead()), SIGNAL(readyRead()));
+	connect(d, SIGNAL(flushed()), SIGNAL(flushed()));
+	connect(d, SIGNAL(hashReady()), SIGNAL(hashReady()));
+	connect(d, SIGNAL(error(const QString &)), SIGNAL(error(const QString &)));
+}
+
+FileTransferIO::~FileTransferIO()
+{
+	close();
+	d->stopHashing();
+	delete d;
+}
+
+QString FileTransferIO::fileName() const
+{
+	return d->file.fileName();
+}
+
+QString FileTransferIO::errorString() const
+{
+	QMutexLocker locker(&d->mutex);
+	return d->errorString;
+}
+
+/**
+ * Opens the file with \a mode at \a offset and starts the worker.  The
+ * file is read when \a mode doesn't include QIODevice::WriteOnly, and
+ * written otherwise.
+ */
+bool FileTransferIO::open(QIODevice::OpenMode mode, qint64 offset)
+{
+	close();
+	d->stopHashing();
+
+	if ( !d->file.open(mode) || (offset != 0 && !d->file.seek(offset)) ) {
+		d->errorString = d->file.errorString();
+		d->file.close();
+		return false;
+	}
+
+	d->reset();
+	d->reading = !(mode & QIODevice::WriteOnly);
+	d->offset = offset;
+	d->hashable = offset;
+	d->start();
+	d->hashThread.start();
+	return true;
+}
+
+/**
+ * Stops the worker and closes the file.  Data which wasn't written yet
+ * is dropped, call flush() to write it.  When the file was read to the
+ * end, the hasher goes on, and hashReady() is emitted when it's done.
+ */
+void FileTransferIO::close()
+{
+	d->mutex.lock();
+	d->stop = true;
+	if ( !d->complete ) {
+		d->hashStop = true;
+	}
+	d->cond.wakeAll();
+	d->hashCond.wakeAll();
+	d->mutex.unlock();
+	d->wait();
+
+	if ( d->file.isOpen() ) {
+		d->file.close();
+	}
+}
+
+/**
+ * Returns up to \a maxSize bytes which were already read, without waiting
+ * for the disk.  If nothing is there, readyRead() is emitted as soon as
+ * something is.
+ */
+QByteArray FileTransferIO::read(int maxSize)
+{
+	QMutexLocker locker(&d->mutex);
+	if ( d->blocks.isEmpty() ) {
+		d->starving = !d->eof && !d->failed;
+		return QByteArray();
+	}
+	if ( maxSize <= 0 ) {
+		return QByteArray();
+	}
+
+	const QByteArray &block = d->blocks.first();
+	QByteArray data;
+	if ( d->pos == 0 && block.size() <= maxSize ) {
+		data = block;
+	}
+	else {
+		data = block.mid(d->pos, maxSize);
+	}
+
+	d->pos += data.size();
+	if ( d->pos >= block.size() ) {
+		d->spare += d->blocks.takeFirst();
+		d->pos = 0;
+		d->cond.wakeAll();
+	}
+	return data;
+}
+
+/**
+ * Returns true when the whole file was read and taken by read().
+ */
+bool FileTransferIO::atEnd() const
+{
+	QMutexLocker locker(&d->mutex);
+	return d->eof && d->blocks.isEmpty();
+}
+
+/**
+ * Queues \a data to be written, without waiting for the disk.  The data
+ * is shared, not copied.  When the disk is so far behind that more than
+ * 16 MB would be waiting, the transfer fails instead of filling the
+ * memory, and error() is emitted once control returns to the event loop.
+ */
+void FileTransferIO::write(const QByteArray &data)
+{
+	QMutexLocker locker(&d->mutex);
+	if ( d->stop || d->failed ) {
+		return;
+	}
+	if ( d->queued + data.size() > qint64(FTIO_WRITE_LIMIT) * FTIO_BLOCK_SIZE ) {
+		d->queue.clear();
+		d->queued = 0;
+		d->fail(tr("The file can't be written as fast as it's received."));
+		QMetaObject::invokeMethod(d, "error", Qt::QueuedConnection, Q_ARG(QString, d->errorString));
+		return;
+	}
+	d->queue += data;
+	d->queued += data.size();
+	d->cond.wakeAll();
+}
+
+/**
+ * Writes all queued data and closes the file, flushed() is emitted when
+ * it's done.
+ */
+void FileTransferIO::flush()
+{
+	QMutexLocker locker(&d->mutex);
+	d->flushing = true;
+	d->cond.wakeAll();
+}
+
+/**
+ * Returns the name of the algorithm of hash(), as in XEP-0300.
+ */
+QString FileTransferIO::hashAlgorithm()
+{
+	return FTIO_HASH_NAME;
+}
+
+/**
+ * Returns the hash of the whole file once hashReady() was emitted, and
+ * an empty QByteArray before or if the file couldn't be read back.
+ */
+QByteArray FileTransferIO::hash() const
+{
+	QMutexLocker locker(&d->mutex);
+	return d->hash;
+}
+
+/**
+ * Returns true while the file is hashed, hashReady() follows then.
+ */
+bool FileTransferIO::isHashing() const
+{
+	return d->hashThread.isRunning();
+}
+
+#include "filetransferio.moc"
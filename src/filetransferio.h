@@ -0,0 +1,93 @@
+/*
+ * filetransferio.h - file access of a file transfer in its own thread
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef FILETRANSFERIO_H
+#define FILETRANSFERIO_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+
+/**
+ * Reads or writes the file of a transfer in a worker thread, so a slow
+ * disk doesn't stall the GUI thread which talks to the network.
+ *
+ * When reading, the worker keeps two blocks read ahead, and read() only
+ * takes what is already there.  When writing, write() queues the data
+ * and returns at once, the worker writes it behind; a disk which falls
+ * too far behind fails the transfer.  Blocks are reused when the
+ * consumer doesn't hold on to them.
+ *
+ * Another thread hashes the whole file on a handle of its own, including
+ * the part before the offset of a resumed transfer, and follows the
+ * worker from there.
+ */
+class FileTransferIO : public QObject
+{
+	Q_OBJECT
+public:
+	FileTransferIO(const QString &fileName, QObject *parent = 0);
+	~FileTransferIO();
+
+	QString fileName() const;
+	QString errorString() const;
+
+	bool open(QIODevice::OpenMode mode, qint64 offset);
+	void close();
+
+	QByteArray read(int maxSize);
+	bool atEnd() const;
+
+	void write(const QByteArray &data);
+	void flush();
+
+	static QString hashAlgorithm();
+	QByteArray hash() const;
+	bool isHashing() const;
+
+signals:
+	/**
+	 * Emitted when data arrives after a read() which returned less than
+	 * was asked for.
+	 */
+	void readyRead();
+
+	/**
+	 * Emitted after flush() once all data is written and the file is
+	 * closed.
+	 */
+	void flushed();
+
+	/**
+	 * Emitted when the hasher is done with the whole file, whether or not
+	 * there is a hash().  It goes on after close() and flushed().
+	 */
+	void hashReady();
+
+	void error(const QString &);
+
+private:
+	class Hasher;
+	class Worker;
+	Worker *d;
+};
+
+#endif
@@ -26,6 +26,7 @@
 #include <QItemDelegate>
 #include <QMimeData>
 #include <QMenu>
+#include <QTimer>
 
 #include "psitooltip.h"
 #include "psiaccount.h"
@@ -321,16 +322,8 @@ void GCUserViewItem::setIcon(const QPixmap &icon)
 
 bool GCUserViewItem::operator<(const QTreeWidgetItem& it) const
 {
-	GCUserViewItem *item = (GCUserViewItem*)(&it);
-	if(PsiOptions::instance()->getOption("options.ui.muc.userlist.contact-sort-style").toString() == "status") {
-		int rank = rankStatus(s.type()) - rankStatus(item->s.type());
-		if (rank == 0)
-			rank = QString::localeAwareCompare(text(0).toLower(), it.text(0).toLower());
-		return rank < 0;
-	}
-	else {
-		return text(0).toLower() < it.text(0).toLower();
-	}
+	GCUserView *uv = (GCUserView*)treeWidget();
+	return uv->lessThan(this, (const GCUserViewItem*)(&it));
 }
 
 
@@ -360,7 +353,11 @@ void GCUserViewGroupItem::updateText()
 GCUserView::GCUserView(QWidget* parent)
 	: QTreeWidget(parent)
 	, gcDlg_(0)
+	, nickListDirty_(true)
+	, groupUpdatePending_(false)
 {
+	sortByStatus_ = PsiOptions::instance()->getOption("options.ui.muc.userlist.contact-sort-style").toString() == "status";
+
 	header()->hide();
 	setRootIsDecorated(false);
 	sortByColumn(0);
@@ -403,15 +400,24 @@ QMimeData* GCUserView::mimeData(QList<QTreeWidgetItem *>items) const
 
 void GCUserView::clear()
 {
+	items_.clear();
+	jids_.clear();
+	nickListDirty_ = true;
+
 	int topCount = topLevelItemCount();
 	for(int num = 0; num < topCount; num++) {
 		GCUserViewGroupItem *j = (GCUserViewGroupItem*)topLevelItem(num);
 		qDeleteAll(j->takeChildren());
 	}
+	updateGroups();
 }
 
 void GCUserView::updateAll()
 {
+	// the sort style only changes here, where the groups are sorted anyway,
+	// so that they stay ordered for insertItem()
+	sortByStatus_ = PsiOptions::instance()->getOption("options.ui.muc.userlist.contact-sort-style").toString() == "status";
+
 	int topCount = topLevelItemCount();
 	for(int num = 0; num < topCount; num++) {
 		GCUserViewGroupItem *j = (GCUserViewGroupItem*)topLevelItem(num);
@@ -424,54 +430,28 @@ void GCUserView::updateAll()
 	}
 }
 
+/**
+ * Returns the nicks of all occupants, sorted case-insensitively.  The list
+ * is kept until an occupant joins or leaves, as it's used for completion.
+ */
 QStringList GCUserView::nickList() const
 {
-	QStringList list;
-
-	int topCount = topLevelItemCount();
-	for(int num = 0; num < topCount; num++) {
-		GCUserViewGroupItem *j = (GCUserViewGroupItem*)topLevelItem(num);
-		int count = j->childCount();
-		for(int num = 0; num < count; num++) {
-			QTreeWidgetItem *lvi = j->child(num);
-			list << lvi->text(0);
-		}
+	if(nickListDirty_) {
+		nickList_ = items_.keys();
+		qSort(nickList_.begin(), nickList_.end(), caseInsensitiveLessThan);
+		nickListDirty_ = false;
 	}
-
-	qSort(list.begin(), list.end(), caseInsensitiveLessThan);
-	return list;
+	return nickList_;
 }
 
 bool GCUserView::hasJid(const Jid& jid)
 {
-	int topCount = topLevelItemCount();
-	for(int num = 0; num < topCount; num++) {
-		GCUserViewGroupItem *j = (GCUserViewGroupItem*)topLevelItem(num);
-		int count = j->childCount();
-		for(int num = 0; num < count; num++) {
-			GCUserViewItem *lvi = (GCUserViewItem*) j->child(num);
-			if(!lvi->s.mucItem().jid().isEmpty() && lvi->s.mucItem().jid().compare(jid,false))
-				return true;
-		}
-	}
-
-	return false;
+	return jid.isValid() && jids_.contains(jid.bare());
 }
 
 QTreeWidgetItem *GCUserView::findEntry(const QString &nick)
 {
-	int topCount = topLevelItemCount();
-	for(int num = 0; num < topCount; num++) {
-		GCUserViewGroupItem *j = (GCUserViewGroupItem*)topLevelItem(num);
-		int count = j->childCount();
-		for(int num = 0; num < count; num++) {
-			QTreeWidgetItem *lvi = j->child(num);
-			if(lvi->text(0) == nick)
-				return lvi;
-		}
-	}
-
-	return 0;
+	return items_.value(nick);
 }
 
 QTreeWidgetItem *GCUserView::findEntry(const QModelIndex &index)
@@ -479,27 +459,112 @@ QTreeWidgetItem *GCUserView::findEntry(const QModelIndex &index)
 	return itemFromIndex(index);
 }
 
-void GCUserView::updateEntry(const QString &nick, const Status &s)
+bool GCUserView::lessThan(const GCUserViewItem *a, const GCUserViewItem *b) const
 {
-	GCUserViewGroupItem* gr;
-	GCUserViewItem *lvi = (GCUserViewItem *)findEntry(nick);
-	if (lvi && lvi->s.mucItem().role() != s.mucItem().role()) {
-		gr = findGroup(lvi->s.mucItem().role());
-		delete lvi;
-		gr->updateText();
-		lvi = NULL;
+	if(sortByStatus_) {
+		int rank = rankStatus(a->s.type()) - rankStatus(b->s.type());
+		if (rank == 0)
+			rank = QString::localeAwareCompare(a->text(0).toLower(), b->text(0).toLower());
+		return rank < 0;
+	}
+	else {
+		return a->text(0).toLower() < b->text(0).toLower();
+	}
+}
+
+// the children of each group are kept sorted, so new items are put in place
+// with a binary search instead of sorting the group again
+void GCUserView::insertItem(GCUserViewGroupItem *gr, GCUserViewItem *lvi)
+{
+	int lo = 0, hi = gr->childCount();
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(lessThan((GCUserViewItem*)gr->child(mid), lvi))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	gr->insertChild(lo, lvi);
+}
 
-	gr = findGroup(s.mucItem().role());
+void GCUserView::takeItem(GCUserViewItem *lvi)
+{
+	QTreeWidgetItem *gr = lvi->parent();
+	gr->takeChild(gr->indexOfChild(lvi));
+}
+
+void GCUserView::addJid(const Status &s)
+{
+	const Jid &jid = s.mucItem().jid();
+	if(!jid.isEmpty() && jid.isValid())
+		++jids_[jid.bare()];
+}
+
+void GCUserView::removeJid(const Status &s)
+{
+	const Jid &jid = s.mucItem().jid();
+	if(jid.isEmpty() || !jid.isValid())
+		return;
+
+	QHash<QString, int>::Iterator it = jids_.find(jid.bare());
+	if(it != jids_.end() && --it.value() == 0)
+		jids_.erase(it);
+}
+
+// the occupant counts in the group headings are updated once for a whole
+// burst of presences, like the one received when joining a room
+void GCUserView::scheduleGroupUpdate()
+{
+	if(!groupUpdatePending_) {
+		groupUpdatePending_ = true;
+		QTimer::singleShot(0, this, SLOT(updateGroups()));
+	}
+}
+
+void GCUserView::updateGroups()
+{
+	groupUpdatePending_ = false;
+	int topCount = topLevelItemCount();
+	for(int num = 0; num < topCount; num++)
+		((GCUserViewGroupItem*)topLevelItem(num))->updateText();
+}
+
+void GCUserView::updateEntry(const QString &nick, const Status &s)
+{
+	GCUserViewGroupItem* gr = findGroup(s.mucItem().role());
+	GCUserViewItem *lvi = items_.value(nick);
 	if(!lvi) {
-		lvi = new GCUserViewItem(gr);
+		lvi = new GCUserViewItem(0);
 		lvi->setText(0, nick);
-		gr->updateText();
+		lvi->s = s;
+		insertItem(gr, lvi);
+		items_.insert(nick, lvi);
+		nickListDirty_ = true;
+		scheduleGroupUpdate();
+	}
+	else {
+		removeJid(lvi->s);
+		bool moved = lvi->parent() != gr;
+		if(moved || (sortByStatus_ && rankStatus(lvi->s.type()) != rankStatus(s.type()))) {
+			bool selected = lvi->isSelected();
+			bool current = currentItem() == lvi;
+			takeItem(lvi);
+			lvi->s = s;
+			insertItem(gr, lvi);
+			lvi->setSelected(selected);
+			if(current)
+				setCurrentItem(lvi);
+			if(moved)
+				scheduleGroupUpdate();
+		}
+		else {
+			lvi->s = s;
+		}
 	}
 
-	lvi->s = s;
+	addJid(s);
 	lvi->setIcon(PsiIconset::instance()->status(lvi->s).pixmap());
-	gr->sortChildren(0, Qt::AscendingOrder);
+	update(indexFromItem(lvi));
 }
 
 GCUserViewGroupItem* GCUserView::findGroup(MUCItem::Role a) const
@@ -522,11 +587,12 @@ GCUserViewGroupItem* GCUserView::findGroup(MUCItem::Role a) const
 
 void GCUserView::removeEntry(const QString &nick)
 {
-	GCUserViewItem *lvi = (GCUserViewItem *)findEntry(nick);
+	GCUserViewItem *lvi = items_.take(nick);
 	if(lvi) {
-		GCUserViewGroupItem* gr = findGroup(lvi->s.mucItem().role());
+		removeJid(lvi->s);
+		nickListDirty_ = true;
 		delete lvi;
-		gr->updateText();
+		scheduleGroupUpdate();
 	}
 }
 
@@ -23,6 +23,7 @@
 #define GCUSERVIEW_H
 
 #include <QTreeWidget>
+#include <QHash>
 
 #include "xmpp_status.h"
 
@@ -87,6 +88,8 @@ public:
 	void doContextMenu(QTreeWidgetItem* it);
 	void setLooks();
 
+	bool lessThan(const GCUserViewItem *, const GCUserViewItem *) const;
+
 protected:
 	enum Role { Moderator = 0, Participant = 1, Visitor = 2 };
 
@@ -102,11 +105,23 @@ signals:
 
 private slots:
 	void qlv_doubleClicked(const QModelIndex& index);
+	void updateGroups();
 
 private:
 	void contextMenuRequested(const QPoint& p);
+	void insertItem(GCUserViewGroupItem *, GCUserViewItem *);
+	void takeItem(GCUserViewItem *);
+	void addJid(const Status &);
+	void removeJid(const Status &);
+	void scheduleGroupUpdate();
 
 	GCMainDlg* gcDlg_;
+	QHash<QString, GCUserViewItem*> items_; // by nick
+	QHash<QString, int> jids_; // occupants by bare real jid
+	mutable QStringList nickList_;
+	mutable bool nickListDirty_;
+	bool sortByStatus_;
+	bool groupUpdatePending_;
 };
 
 #endif
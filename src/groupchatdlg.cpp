@@ -680,9 +680,7 @@ GCMainDlg::GCMainDlg(PsiAccount *pa, const Jid &j, TabManager *tabManager)
 	ui_.lb_ident->setAccount(account());
 	ui_.lb_ident->setShowJid(false);
 	ui_.log->setSessionData(true, jid().full(), jid().full()); //FIXME change conference name
-#ifdef WEBKIT
 	ui_.log->setAccount(account());
-#endif
 
 	connect(ui_.log, SIGNAL(showNM(QString)), this, SLOT(showNM(QString)));
 	connect(URLObject::getInstance(), SIGNAL(openURL(QString)), SLOT(openURL(QString)));
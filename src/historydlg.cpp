@@ -23,6 +23,7 @@
 #include <QScrollBar>
 #include <QMenu>
 #include <QProgressDialog>
+#include <QtAlgorithms>
 
 #include "historydlg.h"
 #include "psiaccount.h"
@@ -94,6 +95,12 @@ static QStringList wrapString(const QString &str, int wid)
 	return lines;
 }
 
+// orders search results by score, keeping the order of equal ones
+static bool betterMatch(const EDBItemPtr &a, const EDBItemPtr &b)
+{
+	return a->score() > b->score();
+}
+
 
 class HistoryDlg::Private
 {
@@ -490,7 +497,11 @@ void HistoryDlg::edbFinished()
 			}
 			else if (d->reqType == TypeFind)
 			{
-				displayResult(r, EDB::Forward);
+				// the best match ends up at the bottom, where the view
+				// is scrolled to
+				EDBResult ranked = r;
+				qStableSort(ranked.begin(), ranked.end(), betterMatch);
+				displayResult(ranked, EDB::Forward);
 				highlightBlocks(ui_.searchField->text());
 			}
 
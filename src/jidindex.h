@@ -0,0 +1,130 @@
+/*
+ * jidindex.h - hash index of roster items by jid
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef JIDINDEX_H
+#define JIDINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include "xmpp_jid.h"
+
+/**
+ * Index of items of type T, which have to provide jid(), for the lookups
+ * that used to scan the whole roster.
+ *
+ * Items without a resource are kept by bare jid and items with a resource
+ * (like private chats with groupchat occupants) by full jid.  The jid of an
+ * item must not change while it is in the index.  Lookups return the items
+ * in the order they were inserted, so they match a scan of a list to which
+ * the items were appended.
+ */
+template<class T>
+class JidIndex
+{
+public:
+	JidIndex() : next_(0) {}
+
+	void insert(T *item)
+	{
+		const XMPP::Jid &j = item->jid();
+		Entry e = { next_++, item };
+		if(j.resource().isEmpty())
+			bare_[j.bare()].append(e);
+		else
+			full_[j.full()].append(e);
+	}
+
+	void remove(T *item)
+	{
+		const XMPP::Jid &j = item->jid();
+		bool bare = j.resource().isEmpty();
+		Hash &hash = bare ? bare_ : full_;
+		typename Hash::Iterator it = hash.find(bare ? j.bare() : j.full());
+		if(it == hash.end())
+			return;
+
+		Bucket &b = it.value();
+		for(int n = 0; n < b.count(); ++n) {
+			if(b[n].item == item) {
+				b.removeAt(n);
+				break;
+			}
+		}
+		if(b.isEmpty())
+			hash.erase(it);
+	}
+
+	void clear()
+	{
+		bare_.clear();
+		full_.clear();
+	}
+
+	/**
+	 * Returns the first item with the full jid \a j.
+	 */
+	T *find(const XMPP::Jid &j) const
+	{
+		const Bucket b = j.resource().isEmpty() ? bare_.value(j.bare()) : full_.value(j.full());
+		foreach(const Entry &e, b) {
+			if(e.item->jid().compare(j))
+				return e.item;
+		}
+		return 0;
+	}
+
+	/**
+	 * Returns the items which presence or messages from \a j are relevant
+	 * to: the items with the bare jid of \a j and no resource, and the items
+	 * with the full jid \a j.
+	 */
+	QList<T*> findRelevant(const XMPP::Jid &j) const
+	{
+		QList<T*> list;
+		const Bucket bare = bare_.value(j.bare());
+		const Bucket full = j.resource().isEmpty() ? Bucket() : full_.value(j.full());
+
+		// merge both buckets in insertion order
+		int a = 0, b = 0;
+		while(a < bare.count() || b < full.count()) {
+			const Entry &e = (b == full.count() || (a < bare.count() && bare[a].seq < full[b].seq)) ? bare[a++] : full[b++];
+			if(e.item->jid().compare(j, false))
+				list.append(e.item);
+		}
+		return list;
+	}
+
+private:
+	struct Entry
+	{
+		quint64 seq;
+		T *item;
+	};
+	typedef QList<Entry> Bucket;
+	typedef QHash<QString, Bucket> Hash;
+
+	Hash bare_;
+	Hash full_;
+	quint64 next_;
+};
+
+#endif
@@ -22,60 +22,124 @@
 #include <QStringList>
 #include <QDateTime>
 
-QString JSUtil::map2json(const QVariantMap &map)
+// All of it appends to one string in a single pass over the values, as
+// whole chat histories are encoded at once.
+
+static void appendEscaped(QString &out, const QString &str)
 {
-	QStringList ret;
-	QMapIterator<QString, QVariant> i(map);
-	while (i.hasNext()) {
-		i.next();
-		ret.append(QString("\"%1\":").arg(escapeStringCopy(i.key())) +
-				   variant2js(i.value()));
+	out.reserve(out.size() + str.size());
+	const QChar *p = str.constData();
+	const QChar *end = p + str.size();
+	for (; p != end; ++p) {
+		switch (p->unicode()) {
+			case '\r':
+				if (p + 1 != end && p[1] == QLatin1Char('\n')) {
+					++p; // windows
+				}
+				// fall through
+			case '\n':
+			case 8232: // ctrl+enter
+				out += QLatin1String("\\\n");
+				break;
+			case '\\':
+				out += QLatin1String("\\\\");
+				break;
+			case '"':
+				out += QLatin1String("\\\"");
+				break;
+			default:
+				out += *p;
+		}
 	}
-	return QString("{%1}").arg(ret.join(","));
 }
 
-QString JSUtil::variant2js(const QVariant &value)
+static void appendString(QString &out, const QString &str)
+{
+	out += QLatin1Char('"');
+	appendEscaped(out, str);
+	out += QLatin1Char('"');
+}
+
+static void appendValue(QString &out, const QVariant &value);
+
+static void appendMap(QString &out, const QVariantMap &map)
+{
+	out += QLatin1Char('{');
+	for (QVariantMap::ConstIterator i = map.constBegin(); i != map.constEnd(); ++i) {
+		if (i != map.constBegin()) {
+			out += QLatin1Char(',');
+		}
+		appendString(out, i.key());
+		out += QLatin1Char(':');
+		appendValue(out, i.value());
+	}
+	out += QLatin1Char('}');
+}
+
+static void appendValue(QString &out, const QVariant &value)
 {
-	QString strVal;
 	switch (value.type()) {
 		case QVariant::String:
 		case QVariant::Color:
-			strVal = value.toString();
-			escapeString(strVal);
-			strVal = QString("\"%1\"").arg(strVal);
+			appendString(out, value.toString());
 			break;
 		case QVariant::StringList:
 			{
 				QStringList sl = value.toStringList();
+				out += QLatin1Char('[');
 				for (int i=0; i<sl.count(); i++) {
-					escapeString(sl[i]);
-					sl[i] = QString("\"%1\"").arg(sl[i]);
+					if (i) {
+						out += QLatin1Char(',');
+					}
+					appendString(out, sl[i]);
 				}
-				strVal = QString("[%1]").arg(sl.join(","));
+				out += QLatin1Char(']');
 			}
 			break;
 		case QVariant::DateTime:
-			strVal = QString("new Date(%1)").arg(value.toDateTime().toString("yyyy,M-1,d,h,m,s"));
+			out += QString("new Date(%1)").arg(value.toDateTime().toString("yyyy,M-1,d,h,m,s"));
 			break;
 		case QVariant::Date:
-			strVal = QString("new Date(%1)").arg(value.toDate().toString("yyyy,M-1,d"));
+			out += QString("new Date(%1)").arg(value.toDate().toString("yyyy,M-1,d"));
 			break;
 		case QVariant::Map:
-			strVal = map2json(value.toMap());
+			appendMap(out, value.toMap());
+			break;
+		case QVariant::List:
+			{
+				QVariantList list = value.toList();
+				out += QLatin1Char('[');
+				for (int i=0; i<list.count(); i++) {
+					if (i) {
+						out += QLatin1Char(',');
+					}
+					appendValue(out, list[i]);
+				}
+				out += QLatin1Char(']');
+			}
 			break;
 		default:
-			strVal = value.toString();
+			out += value.toString();
 	}
-	return strVal;
 }
 
-void JSUtil::escapeString(QString& str)
+QString JSUtil::map2json(const QVariantMap &map)
+{
+	QString ret;
+	appendMap(ret, map);
+	return ret;
+}
+
+QString JSUtil::variant2js(const QVariant &value)
 {
+	QString ret;
+	appendValue(ret, value);
+	return ret;
+}
 
-	str.replace("\r\n", "\n");  //windows
-	str.replace("\r", "\n");    //mac
-	str.replace("\\", "\\\\");
-	str.replace("\"", "\\\"");
-	str.replace("\n", "\\\n");
-	str.replace(QChar(8232), "\\\n"); //ctrl+enter
+void JSUtil::escapeString(QString& str)
+{
+	QString ret;
+	appendEscaped(ret, str);
+	str = ret;
 }
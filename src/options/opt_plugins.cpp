@@ -213,6 +213,11 @@ void OptionsTabPlugins::showPluginInfo()
 		infoDialog->setWindowTitle(QString("%1 %2").arg(infoDialog->windowTitle()).arg(name));
 		infoDialog->setWindowIcon(QIcon(IconsetFactory::iconPixmap("psi/logo_128")));
 		ui_.te_info->setText(PluginManager::instance()->pluginInfo(name));
+		const QString stats = PluginManager::instance()->hookStats(name);
+		if ( !stats.isEmpty() ) {
+			ui_.te_info->append(QString());
+			ui_.te_info->append(stats);
+		}
 		infoDialog->setAttribute(Qt::WA_DeleteOnClose);
 		infoDialog->show();
 	}
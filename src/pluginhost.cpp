@@ -17,6 +17,7 @@
 #include <QString>
 #include <QStringList>
 #include <QTextEdit>
+#include <QElapsedTimer>
 //#include "xmpp_message.h"
 #include "psioptions.h"
 #include "psiaccount.h"
@@ -53,6 +54,49 @@
 #include "textutil.h"
 #include "chattabaccessor.h"
 
+// Calls taking longer than this are reported, in ms
+static const int SLOW_HOOK_TIME = 100;
+
+static const char* hookNames[PluginHost::HookCount] = {
+	QT_TRANSLATE_NOOP("PluginHost", "Incoming stanzas"),
+	QT_TRANSLATE_NOOP("PluginHost", "Outgoing stanzas"),
+	QT_TRANSLATE_NOOP("PluginHost", "Events"),
+	QT_TRANSLATE_NOOP("PluginHost", "Incoming messages"),
+	QT_TRANSLATE_NOOP("PluginHost", "Outgoing messages")
+};
+
+/**
+ * Adds the time spent in a hook of the plugin to the counters of its host.
+ */
+class PluginHost::HookTimer
+{
+public:
+	HookTimer(PluginHost* host, Hook hook) : host_(host), hook_(hook)
+	{
+		timer_.start();
+	}
+
+	~HookTimer()
+	{
+#if QT_VERSION >= 0x040800
+		const qint64 nsecs = timer_.nsecsElapsed();
+#else
+		const qint64 nsecs = timer_.elapsed() * 1000000;
+#endif
+		HookStats &stats = host_->hookStats_[hook_];
+		stats.calls++;
+		stats.nsecs += nsecs;
+		if (nsecs / 1000000 >= SLOW_HOOK_TIME) {
+			qWarning("Plugin %s spent %d ms on: %s", qPrintable(host_->name_), int(nsecs / 1000000), hookNames[hook_]);
+		}
+	}
+
+private:
+	PluginHost* host_;
+	Hook hook_;
+	QElapsedTimer timer_;
+};
+
 /**
  * \brief Constructs a host/wrapper for a plugin.
  *
@@ -77,7 +121,14 @@ PluginHost::PluginHost(PluginManager* manager, const QString& pluginFile)
 	, enabled_(false)
 	, hasInfo_(false)
 	, infoString_(QString())
+	, stanzaFilter_(0)
+	, eventFilter_(0)
+	, iqFilter_(false)
 {
+	for (int n = 0; n < HookCount; ++n) {
+		hookStats_[n].calls = 0;
+		hookStats_[n].nsecs = 0;
+	}
 	load();	// reads plugin name, etc
 	unload();
 }
@@ -232,6 +283,9 @@ bool PluginHost::load()
 				icon_ = QIcon(psiPlugin->icon());
 				hasToolBarButton_ = qobject_cast<ToolbarIconAccessor*>(plugin_) ? true : false;
 				hasGCToolBarButton_ = qobject_cast<GCToolbarIconAccessor*>(plugin_) ? true : false;
+				stanzaFilter_ = qobject_cast<StanzaFilter*>(plugin_);
+				eventFilter_ = qobject_cast<EventFilter*>(plugin_);
+				iqFilter_ = qobject_cast<IqFilter*>(plugin_) ? true : false;
 				PluginInfoProvider *pip = qobject_cast<PluginInfoProvider*>(plugin_);
 				if (pip) {
 					hasInfo_ = true;
@@ -280,6 +334,9 @@ bool PluginHost::unload()
 			delete loader_;
 			plugin_ = 0;
 			loader_ = 0;
+			stanzaFilter_ = 0;
+			eventFilter_ = 0;
+			iqFilter_ = false;
 			delete iconset_;
 			iconset_ = 0;
 			connected_ = false;
@@ -446,6 +503,9 @@ bool PluginHost::enable()
 		}
 
 		enabled_ = qobject_cast<PsiPlugin*>(plugin_)->enable();
+		if (enabled_) {
+			manager_->updateDispatch();
+		}
 	}
 
 	return enabled_;
@@ -463,6 +523,9 @@ bool PluginHost::disable()
 {
 	if (enabled_) {
 		enabled_ = !qobject_cast<PsiPlugin*>(plugin_)->disable();
+		if (!enabled_) {
+			manager_->updateDispatch();
+		}
 	}
 	return !enabled_;
 }
@@ -475,6 +538,48 @@ bool PluginHost::isEnabled() const
 	return enabled_;
 }
 
+/**
+ * \brief Returns true if the plugin implements StanzaFilter.
+ */
+bool PluginHost::isStanzaFilter() const
+{
+	return stanzaFilter_ != 0;
+}
+
+/**
+ * \brief Returns true if the plugin implements IqFilter.
+ */
+bool PluginHost::isIqFilter() const
+{
+	return iqFilter_;
+}
+
+/**
+ * \brief Returns true if the plugin implements EventFilter.
+ */
+bool PluginHost::isEventFilter() const
+{
+	return eventFilter_ != 0;
+}
+
+/**
+ * \brief Returns the number of calls to each filter of the plugin
+ * and the time spent in them, to help finding slow plugins.
+ */
+QString PluginHost::hookStats() const
+{
+	QStringList lines;
+	for (int n = 0; n < HookCount; ++n) {
+		if (hookStats_[n].calls) {
+			lines += tr("%1: %2 calls, %3 ms")
+				.arg(tr(hookNames[n]))
+				.arg(hookStats_[n].calls)
+				.arg(hookStats_[n].nsecs / 1000000.0, 0, 'f', 1);
+		}
+	}
+	return lines.join("\n");
+}
+
 
 //-- for StanzaFilter and IqNamespaceFilter -------------------------
 
@@ -488,57 +593,52 @@ bool PluginHost::isEnabled() const
  *
  * \param account Identifier of the PsiAccount responsible
  * \param xml Incoming XML (may be modified)
+ * \param iqType Type of the iq stanza, NoIq for other stanzas
+ * \param iqNs Namespace of the iq payload
  * \return Continue processing the XML stanza; true if the stanza should be silently discarded.
  */
-bool PluginHost::incomingXml(int account, const QDomElement &e)
+bool PluginHost::incomingXml(int account, const QDomElement &e, IqType iqType, const QString &iqNs)
 {
+	HookTimer timer(this, IncomingXmlHook);
 	bool handled = false;
 
 	// try stanza filter first
-	StanzaFilter* sf = qobject_cast<StanzaFilter*>(plugin_);
-	if (sf && sf->incomingStanza(account, e)) {
+	if (stanzaFilter_ && stanzaFilter_->incomingStanza(account, e)) {
 		handled = true;
 	}
 	// try iq filters
-	else if (e.tagName() == "iq") {
-		// get iq namespace
-		QString ns;
-		for (QDomNode n = e.firstChild(); !n.isNull(); n = n.nextSibling()) {
-			QDomElement i = n.toElement();
-			if (!i.isNull() && i.hasAttribute("xmlns")) {
-				ns = i.attribute("xmlns");
-				break;
-			}
-		}
-
+	else if (iqType != NoIq && (!iqNsFilters_.isEmpty() || !iqNsxFilters_.isEmpty())) {
 		// choose handler function depending on iq type
 		bool (IqNamespaceFilter::*handler)(int account, const QDomElement& xml) = 0;
-		const QString type = e.attribute("type");
-		if (type == "get") {
-			handler = &IqNamespaceFilter::iqGet;
-		} else if (type == "set") {
-			handler = &IqNamespaceFilter::iqSet;
-		} else if (type == "result") {
-			handler = &IqNamespaceFilter::iqResult;
-		} else if (type == "error") {
-			handler = &IqNamespaceFilter::iqError;
+		switch (iqType) {
+			case IqGet:
+				handler = &IqNamespaceFilter::iqGet;
+				break;
+			case IqSet:
+				handler = &IqNamespaceFilter::iqSet;
+				break;
+			case IqResult:
+				handler = &IqNamespaceFilter::iqResult;
+				break;
+			default:
+				handler = &IqNamespaceFilter::iqError;
+				break;
 		}
 
-		if (handler) {
-			// normal filters
-			foreach (IqNamespaceFilter* f, iqNsFilters_.values(ns)) {
-				if ((f->*handler)(account, e)) {
-					handled = true;
-					break;
-				}
+		// normal filters
+		QMultiHash<QString, IqNamespaceFilter*>::const_iterator it = iqNsFilters_.constFind(iqNs);
+		for (; !handled && it != iqNsFilters_.constEnd() && it.key() == iqNs; ++it) {
+			if ((it.value()->*handler)(account, e)) {
+				handled = true;
 			}
+		}
 
-			// regex filters
-			QMapIterator<QRegExp, IqNamespaceFilter*> i(iqNsxFilters_);
-			while (!handled && i.hasNext()) {
-				if (i.key().indexIn(ns) >= 0 && (i.value()->*handler)(account, e)) {
-					handled = true;
-				}
+		// regex filters
+		QMapIterator<QRegExp, IqNamespaceFilter*> i(iqNsxFilters_);
+		while (!handled && i.hasNext()) {
+			i.next();
+			if (i.key().indexIn(iqNs) >= 0 && (i.value()->*handler)(account, e)) {
+				handled = true;
 			}
 		}
 	}
@@ -549,9 +649,9 @@ bool PluginHost::incomingXml(int account, const QDomElement &e)
 
 bool PluginHost::outgoingXml(int account, QDomElement &e)
 {
+	HookTimer timer(this, OutgoingXmlHook);
 	bool handled = false;
-	StanzaFilter *ef = qobject_cast<StanzaFilter*>(plugin_);
-	if (ef && ef->outgoingStanza(account, e)) {
+	if (stanzaFilter_ && stanzaFilter_->outgoingStanza(account, e)) {
 		handled = true;
 	}
 	return handled;
@@ -573,9 +673,9 @@ bool PluginHost::outgoingXml(int account, QDomElement &e)
  */
 bool PluginHost::processEvent(int account, QDomElement& e)
 {
+	HookTimer timer(this, EventHook);
 	bool handled = false;
-	EventFilter *ef = qobject_cast<EventFilter*>(plugin_);
-	if (ef && ef->processEvent(account, e)) {
+	if (eventFilter_ && eventFilter_->processEvent(account, e)) {
 		handled = true;
 	}
 	return handled;
@@ -598,9 +698,9 @@ bool PluginHost::processEvent(int account, QDomElement& e)
  */
 bool PluginHost::processMessage(int account, const QString& jidFrom, const QString& body, const QString& subject)
 {
+	HookTimer timer(this, MessageHook);
 	bool handled = false;
-	EventFilter *ef = qobject_cast<EventFilter*>(plugin_);
-	if (ef && ef->processMessage(account, jidFrom, body, subject)) {
+	if (eventFilter_ && eventFilter_->processMessage(account, jidFrom, body, subject)) {
 		handled = true;
 	}
 	return handled;
@@ -608,9 +708,9 @@ bool PluginHost::processMessage(int account, const QString& jidFrom, const QStri
 
 bool PluginHost::processOutgoingMessage(int account, const QString& jidTo, QString& body, const QString& type, QString& subject)
 {
+	HookTimer timer(this, OutgoingMessageHook);
 	bool handled = false;
-	EventFilter *ef = qobject_cast<EventFilter*>(plugin_);
-	if (ef && ef->processOutgoingMessage(account, jidTo, body, type, subject)) {
+	if (eventFilter_ && eventFilter_->processOutgoingMessage(account, jidTo, body, type, subject)) {
 		handled = true;
 	}
 	return handled;
@@ -618,9 +718,8 @@ bool PluginHost::processOutgoingMessage(int account, const QString& jidTo, QStri
 
 void PluginHost::logout(int account)
 {
-	EventFilter *ef = qobject_cast<EventFilter*>(plugin_);
-	if (ef) {
-		ef->logout(account);
+	if (eventFilter_) {
+		eventFilter_->logout(account);
 	}
 }
 
@@ -715,7 +814,7 @@ QString PluginHost::escape(const QString &str)
  */
 void PluginHost::addIqNamespaceFilter(const QString &ns, IqNamespaceFilter *filter)
 {
-	if (iqNsFilters_.values(ns).contains(filter)) {
+	if (iqNsFilters_.contains(ns, filter)) {
 #ifndef PLUGINS_NO_DEBUG
 		qDebug("pluginmanager: blocked attempt to register the same filter again");
 #endif
@@ -10,6 +10,7 @@
 #include <QVariant>
 #include <QRegExp>
 #include <QMultiMap>
+#include <QMultiHash>
 #include <QPointer>
 #include <QTextEdit>
 
@@ -38,6 +39,8 @@ class QPluginLoader;
 
 class PluginManager;
 class IqNamespaceFilter;
+class StanzaFilter;
+class EventFilter;
 
 class PluginHost: public QObject, public StanzaSendingHost, public IqFilteringHost, public OptionAccessingHost, public ShortcutAccessingHost, public IconFactoryAccessingHost,
 	public ActiveTabAccessingHost, public ApplicationInfoAccessingHost, public AccountInfoAccessingHost, public PopupAccessingHost, public ContactStateAccessingHost
@@ -73,8 +76,18 @@ public:
 	bool disable();
 	bool isEnabled() const;
 
+	// capabilities, for the dispatch tables of PluginManager
+	bool isStanzaFilter() const;
+	bool isIqFilter() const;
+	bool isEventFilter() const;
+
+	// time spent in the plugin
+	enum Hook { IncomingXmlHook, OutgoingXmlHook, EventHook, MessageHook, OutgoingMessageHook, HookCount };
+	QString hookStats() const;
+
 	// for StanzaFilter and IqNamespaceFilter
-	bool incomingXml(int account, const QDomElement& e);
+	enum IqType { NoIq, IqGet, IqSet, IqResult, IqError };
+	bool incomingXml(int account, const QDomElement& e, IqType iqType, const QString& iqNs);
 	bool outgoingXml(int account, QDomElement &e);
 
 	// for EventFilter
@@ -222,7 +235,20 @@ private:
 	bool hasInfo_;
 	QString infoString_;
 
-	QMultiMap<QString, IqNamespaceFilter*> iqNsFilters_;
+	// interfaces of plugin_ called for every stanza
+	StanzaFilter* stanzaFilter_;
+	EventFilter* eventFilter_;
+	bool iqFilter_;
+
+	struct HookStats
+	{
+		quint64 calls;
+		qint64 nsecs;
+	};
+	HookStats hookStats_[HookCount];
+	class HookTimer;
+
+	QMultiHash<QString, IqNamespaceFilter*> iqNsFilters_;
 	QMultiMap<QRegExp, IqNamespaceFilter*> iqNsxFilters_;
 	QList< QVariantHash > buttons_;
 	QList< QVariantHash > gcbuttons_;
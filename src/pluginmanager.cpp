@@ -221,6 +221,42 @@ void PluginManager::optionChanged(const QString& option)
 	}
 }
 
+/**
+ * Rebuilds the lists of plugins that get the stanzas and events,
+ * so that dispatching doesn't have to check every plugin.
+ */
+void PluginManager::updateDispatch()
+{
+	incomingXmlHosts_.clear();
+	eventFilterHosts_.clear();
+	outgoingXmlHosts_.clear();
+	eventFilterHostsByFile_.clear();
+
+	foreach (PluginHost* host, pluginsByPriority_) {
+		if (!host->isEnabled()) {
+			continue;
+		}
+		if (host->isStanzaFilter() || host->isIqFilter()) {
+			incomingXmlHosts_.append(host);
+		}
+		if (host->isEventFilter()) {
+			eventFilterHosts_.append(host);
+		}
+	}
+
+	foreach (PluginHost* host, pluginByFile_) {
+		if (!host->isEnabled()) {
+			continue;
+		}
+		if (host->isStanzaFilter()) {
+			outgoingXmlHosts_.append(host);
+		}
+		if (host->isEventFilter()) {
+			eventFilterHostsByFile_.append(host);
+		}
+	}
+}
+
 /**
  * Loads all available plugins
  */
@@ -378,7 +414,7 @@ void PluginManager::setShortcuts()
 bool PluginManager::processMessage(PsiAccount* account, const QString& jidFrom, const QString& body, const QString& subject)
 {
 	bool handled = false;
-	foreach (PluginHost* host, pluginsByPriority_) {
+	foreach (PluginHost* host, eventFilterHosts_) {
 		if (host->processMessage(accountIds_.id(account), jidFrom, body, subject)) {
 			handled = true;
 			break;
@@ -401,7 +437,7 @@ bool PluginManager::processEvent(PsiAccount* account, QDomElement& event)
 {
 	bool handled = false;
 	const int acc_id = accountIds_.id(account);
-	foreach (PluginHost* host, pluginsByPriority_) {
+	foreach (PluginHost* host, eventFilterHosts_) {
 		if (host->processEvent(acc_id, event)) {
 			handled = true;
 			break;
@@ -417,7 +453,7 @@ bool PluginManager::processOutgoingMessage(PsiAccount* account, const QString& j
 {
 	bool handled = false;
 	const int acc_id = accountIds_.id(account);
-	foreach (PluginHost* host, pluginByFile_.values()) {
+	foreach (PluginHost* host, eventFilterHostsByFile_) {
 		if (host->processOutgoingMessage(acc_id, jidTo, body, type, subject)) {
 			handled = true;
 			break;
@@ -429,7 +465,7 @@ bool PluginManager::processOutgoingMessage(PsiAccount* account, const QString& j
 void PluginManager::processOutgoingStanza(PsiAccount* account, QDomElement &stanza)
 {
 	const int acc_id = accountIds_.id(account);
-	foreach (PluginHost* host, pluginByFile_.values()) {
+	foreach (PluginHost* host, outgoingXmlHosts_) {
 		if (host->outgoingXml(acc_id, stanza)) {
 			break;
 		}
@@ -442,7 +478,7 @@ void PluginManager::processOutgoingStanza(PsiAccount* account, QDomElement &stan
 void PluginManager::logout(PsiAccount* account)
 {
 	const int acc_id = accountIds_.id(account);
-	foreach (PluginHost* host, pluginByFile_.values()) {
+	foreach (PluginHost* host, eventFilterHostsByFile_) {
 		host->logout(acc_id);
 	}
 }
@@ -461,9 +497,37 @@ void PluginManager::logout(PsiAccount* account)
  */
 bool PluginManager::incomingXml(int account, const QDomElement &xml)
 {
+	if (incomingXmlHosts_.isEmpty()) {
+		return false;
+	}
+
+	// iq type and namespace are the same for all plugins
+	PluginHost::IqType iqType = PluginHost::NoIq;
+	QString ns;
+	if (xml.tagName() == "iq") {
+		const QString type = xml.attribute("type");
+		if (type == "get") {
+			iqType = PluginHost::IqGet;
+		} else if (type == "set") {
+			iqType = PluginHost::IqSet;
+		} else if (type == "result") {
+			iqType = PluginHost::IqResult;
+		} else if (type == "error") {
+			iqType = PluginHost::IqError;
+		}
+
+		for (QDomNode n = xml.firstChild(); !n.isNull(); n = n.nextSibling()) {
+			QDomElement i = n.toElement();
+			if (!i.isNull() && i.hasAttribute("xmlns")) {
+				ns = i.attribute("xmlns");
+				break;
+			}
+		}
+	}
+
 	bool handled = false;
-	foreach (PluginHost* host, pluginsByPriority_) {
-		if (host->incomingXml(account, xml)) {
+	foreach (PluginHost* host, incomingXmlHosts_) {
+		if (host->incomingXml(account, xml, iqType, ns)) {
 			handled = true;
 			break;
 		}
@@ -783,6 +847,14 @@ QString PluginManager::pluginInfo(const QString& plugin) const
 	return info;
 }
 
+QString PluginManager::hookStats(const QString& plugin) const
+{
+	QString stats;
+	if (hosts_.contains(plugin))
+		stats = hosts_[plugin]->hookStats();
+	return stats;
+}
+
 QIcon PluginManager::icon(const QString& plugin) const
 {
 	QIcon icon;
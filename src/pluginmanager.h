@@ -90,6 +90,7 @@ public:
 				  QString& body, QDomElement& html, bool local);
 
 	QString pluginInfo(const QString& plugin) const;
+	QString hookStats(const QString& plugin) const;
 	bool hasInfoProvider(const QString& plugin) const;
 	QIcon icon(const QString& plugin) const;
 
@@ -103,6 +104,7 @@ private:
 	bool verifyStanza(const QString& stanza);
 	QList<PluginHost*> updatePluginsList();
 	void loadPluginIfEnabled(PluginHost* plugin);
+	void updateDispatch();
 
 	static PluginManager* instance_;
 
@@ -119,6 +121,15 @@ private:
 	//sorted by priority
 	QList<PluginHost*> pluginsByPriority_;
 
+	// enabled plugins implementing the filters called for every stanza,
+	// rebuilt by updateDispatch() when a plugin is enabled or disabled
+	//sorted by priority
+	QList<PluginHost*> incomingXmlHosts_;
+	QList<PluginHost*> eventFilterHosts_;
+	//sorted by file
+	QList<PluginHost*> outgoingXmlHosts_;
+	QList<PluginHost*> eventFilterHostsByFile_;
+
 
 	QList<QCA::DirWatch*> dirWatchers_;
 
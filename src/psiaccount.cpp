@@ -47,6 +47,7 @@
 
 #include "psiaccount.h"
 #include "psiiconset.h"
+#include "xmlringbuffer.h"
 #include "psicon.h"
 #include "profiles.h"
 #include "xmpp_tasks.h"
@@ -70,6 +71,7 @@
 #include "changepwdlg.h"
 #include "xmlconsole.h"
 #include "userlist.h"
+#include "jidindex.h"
 #include "psievent.h"
 #include "jidutil.h"
 #include "eventdlg.h"
@@ -377,6 +379,49 @@ struct ReconnectData
 	int timeout;
 };
 
+// options read for every incoming stanza or event
+static const OptionKey messagesExcludeMucFromIgnoreOption("options.messages.exclude-muc-from-ignore");
+static const OptionKey messagesForceIncomingMessageTypeOption("options.messages.force-incoming-message-type");
+static const OptionKey messagesIgnoreHeadlinesOption("options.messages.ignore-headlines");
+static const OptionKey messagesIgnoreNonRosterContactsOption("options.messages.ignore-non-roster-contacts");
+static const OptionKey messagesSendComposingEventsOption("options.messages.send-composing-events");
+static const OptionKey subscriptionsAutomaticallyAllowAuthorizationOption("options.subscriptions.automatically-allow-authorization");
+static const OptionKey chatAlertForAlreadyOpenChatsOption("options.ui.chat.alert-for-already-open-chats");
+static const OptionKey chatAutoPopupOption("options.ui.chat.auto-popup");
+static const OptionKey contactlistRaiseOnNewEventOption("options.ui.contactlist.raise-on-new-event");
+static const OptionKey contactlistUseStatusChangeAnimationOption("options.ui.contactlist.use-status-change-animation");
+static const OptionKey fileTransferAutoPopupOption("options.ui.file-transfer.auto-popup");
+static const OptionKey messageAutoPopupOption("options.ui.message.auto-popup");
+static const OptionKey messageAutoPopupHeadlinesOption("options.ui.message.auto-popup-headlines");
+static const OptionKey mucAllowHighlightEventsOption("options.ui.muc.allow-highlight-events");
+static const OptionKey passivePopupsComposingOption("options.ui.notifications.passive-popups.composing");
+static const OptionKey passivePopupsIncomingChatOption("options.ui.notifications.passive-popups.incoming-chat");
+static const OptionKey passivePopupsIncomingFileTransferOption("options.ui.notifications.passive-popups.incoming-file-transfer");
+static const OptionKey passivePopupsIncomingHeadlineOption("options.ui.notifications.passive-popups.incoming-headline");
+static const OptionKey passivePopupsIncomingMessageOption("options.ui.notifications.passive-popups.incoming-message");
+static const OptionKey passivePopupsStatusOfflineOption("options.ui.notifications.passive-popups.status.offline");
+static const OptionKey passivePopupsStatusOnlineOption("options.ui.notifications.passive-popups.status.online");
+static const OptionKey passivePopupsStatusOtherChangesOption("options.ui.notifications.passive-popups.status.other-changes");
+static const OptionKey passivePopupsSuppressWhileAwayOption("options.ui.notifications.passive-popups.suppress-while-away");
+static const OptionKey passivePopupsSuppressWhileDndOption("options.ui.notifications.passive-popups.suppress-while-dnd");
+static const OptionKey popupDialogsSuppressWhenNotOnRosterOption("options.ui.notifications.popup-dialogs.suppress-when-not-on-roster");
+static const OptionKey popupDialogsSuppressWhileAwayOption("options.ui.notifications.popup-dialogs.suppress-while-away");
+static const OptionKey requestReceiptsOption("options.ui.notifications.request-receipts");
+static const OptionKey sendReceiptsOption("options.ui.notifications.send-receipts");
+static const OptionKey soundsChatMessageOption("options.ui.notifications.sounds.chat-message");
+static const OptionKey soundsCompletedFileTransferOption("options.ui.notifications.sounds.completed-file-transfer");
+static const OptionKey soundsContactOfflineOption("options.ui.notifications.sounds.contact-offline");
+static const OptionKey soundsContactOnlineOption("options.ui.notifications.sounds.contact-online");
+static const OptionKey soundsGroupchatMessageOption("options.ui.notifications.sounds.groupchat-message");
+static const OptionKey soundsIncomingFileTransferOption("options.ui.notifications.sounds.incoming-file-transfer");
+static const OptionKey soundsIncomingHeadlineOption("options.ui.notifications.sounds.incoming-headline");
+static const OptionKey soundsIncomingMessageOption("options.ui.notifications.sounds.incoming-message");
+static const OptionKey soundsNewChatOption("options.ui.notifications.sounds.new-chat");
+static const OptionKey soundsOutgoingChatOption("options.ui.notifications.sounds.outgoing-chat");
+static const OptionKey soundsSilentWhileAwayOption("options.ui.notifications.sounds.silent-while-away");
+static const OptionKey soundsSystemMessageOption("options.ui.notifications.sounds.system-message");
+static const OptionKey successfulSubscriptionOption("options.ui.notifications.successful-subscription");
+
 static const int RECONNECT_TIMEOUT_ERROR = -10;
 
 static QList<ReconnectData> reconnectData()
@@ -441,8 +486,6 @@ public:
 		, stream(0)
 		, tls(0)
 		, tlsHandler(0)
-		, xmlRingbuf(1000)
-		, xmlRingbufWrite(0)
 		, onlineContactsCount(0)
 		, doPopups_(true)
 		, reconnectTimeoutTimer_(0)
@@ -532,12 +575,12 @@ public:
 	QPointer<QCATLSHandler> tlsHandler;
 	bool usingSSL;
 
-	QVector<xmlRingElem> xmlRingbuf;
-	int xmlRingbufWrite;
+	XmlRingBuffer xmlRingbuf;
 
 	QHostAddress localAddress;
 
 	QList<PsiContact*> contacts;
+	JidIndex<PsiContact> contactIndex;
 	int onlineContactsCount;
 
 private:
@@ -551,12 +594,12 @@ public:
 
 		if (lastManualStatus().isAvailable()) {
 			if (lastManualStatus().type() == XMPP::Status::DND &&
-			    PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.suppress-while-dnd").toBool())
+			    PsiOptions::instance()->getOption(passivePopupsSuppressWhileDndOption).toBool())
 			{
 				return true;
 			}
 			if ((lastManualStatus().type() == XMPP::Status::Away || lastManualStatus().type() == XMPP::Status::XA) &&
-			    PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.suppress-while-away").toBool())
+			    PsiOptions::instance()->getOption(passivePopupsSuppressWhileAwayOption).toBool())
 			{
 				return true;
 			}
@@ -574,7 +617,7 @@ public:
 			if (lastManualStatus().type() == XMPP::Status::DND)
 				return true;
 			if ((lastManualStatus().type() == XMPP::Status::Away || lastManualStatus().type() == XMPP::Status::XA) &&
-				PsiOptions::instance()->getOption("options.ui.notifications.popup-dialogs.suppress-while-away").toBool())
+				PsiOptions::instance()->getOption(popupDialogsSuppressWhileAwayOption).toBool())
 			{
 				return true;
 			}
@@ -589,6 +632,7 @@ private slots:
 		Q_ASSERT(contacts.contains(contact));
 		emit account->removedContact(contact);
 		contacts.removeAll(contact);
+		contactIndex.remove(contact);
 	}
 
 	/**
@@ -601,6 +645,7 @@ private slots:
 		// PsiContactGroup* parent = groupsForUserListItem(u).first();
 		PsiContact* contact = new PsiContact(u, account);
 		contacts.append(contact);
+		contactIndex.insert(contact);
 		connect(contact, SIGNAL(destroyed(PsiContact*)), SLOT(removeContact(PsiContact*)));
 		emit account->addedContact(contact);
 		return contact;
@@ -609,11 +654,7 @@ private slots:
 public:
 	PsiContact* findContact(const Jid& jid) const
 	{
-		foreach(PsiContact* contact, contacts)
-			if (contact->find(jid))
-				return contact;
-
-		return 0;
+		return contactIndex.find(jid);
 	}
 
 	PsiContact* findContactOrSelf(const Jid& jid) const
@@ -722,11 +763,6 @@ public:
 	}
 
 public slots:
-	void queueChanged()
-	{
-		eventQueue->toFile(pathToProfileEvents());
-	}
-
 	void loadQueue()
 	{
 		bool soundEnabled = PsiOptions::instance()->getOption("options.ui.notifications.sounds.enable").toBool();
@@ -737,6 +773,10 @@ public slots:
 		if ( fi.exists() )
 			eventQueue->fromFile(pathToProfileEvents());
 
+		// the queue is saved incrementally from now on
+		eventQueue->setJournalFile(pathToProfileEvents());
+		eventQueue->compact();
+
 		PsiOptions::instance()->setOption("options.ui.notifications.sounds.enable", soundEnabled);
 		doPopups_ = true;
 	}
@@ -756,17 +796,37 @@ public slots:
 
 	void client_xmlIncoming(const QString &s)
 	{
-		xmlRingbuf[xmlRingbufWrite].type = RingXmlIn;
-		xmlRingbuf[xmlRingbufWrite].xml = s;
-		xmlRingbuf[xmlRingbufWrite].time = QDateTime::currentDateTime();
-		xmlRingbufWrite = (xmlRingbufWrite + 1) % xmlRingbuf.count();
+		xmlRingbuf.append(RingXmlIn, s);
 	}
 	void client_xmlOutgoing(const QString &s)
 	{
-		xmlRingbuf[xmlRingbufWrite].type = RingXmlOut;
-		xmlRingbuf[xmlRingbufWrite].xml = s;
-		xmlRingbuf[xmlRingbufWrite].time = QDateTime::currentDateTime();
-		xmlRingbufWrite = (xmlRingbufWrite + 1) % xmlRingbuf.count();
+		xmlRingbuf.append(RingXmlOut, s);
+	}
+
+	// the traffic is only captured while the buffer is enabled
+	void updateXmlRingbuf()
+	{
+		const int size = PsiOptions::instance()->getOption("options.xml-console.ringbuffer-size").toInt() * 1024;
+		if (size == xmlRingbuf.capacity()) {
+			return;
+		}
+
+		xmlRingbuf.setCapacity(size);
+		if (xmlRingbuf.capacity()) {
+			connect(client, SIGNAL(xmlIncoming(const QString &)), SLOT(client_xmlIncoming(const QString &)), Qt::UniqueConnection);
+			connect(client, SIGNAL(xmlOutgoing(const QString &)), SLOT(client_xmlOutgoing(const QString &)), Qt::UniqueConnection);
+		}
+		else {
+			disconnect(client, SIGNAL(xmlIncoming(const QString &)), this, SLOT(client_xmlIncoming(const QString &)));
+			disconnect(client, SIGNAL(xmlOutgoing(const QString &)), this, SLOT(client_xmlOutgoing(const QString &)));
+		}
+	}
+
+	void optionChanged(const QString &option)
+	{
+		if (option == "options.xml-console.ringbuffer-size") {
+			updateXmlRingbuf();
+		}
 	}
 
 	void client_stanzaElementOutgoing(QDomElement &s)
@@ -824,13 +884,13 @@ public:
 	// implementation for QList<PsiAccount::xmlRingElem> PsiAccount::dumpRingbuf()
 	QList< xmlRingElem > dumpRingbuf()
 	{
-		xmlRingElem el;
 		QList< xmlRingElem > ret;
-		for(int i=0; i < xmlRingbuf.count(); i++) {
-			el = xmlRingbuf[(xmlRingbufWrite + i) % xmlRingbuf.count()];
-			if (!el.xml.isEmpty()) {
-				ret += el;
-			}
+		foreach (const XmlRingBuffer::Entry &e, xmlRingbuf.entries()) {
+			xmlRingElem el;
+			el.type = e.type;
+			el.time = e.time;
+			el.xml = e.xml;
+			ret += el;
 		}
 		return ret;
 	}
@@ -1111,7 +1171,6 @@ PsiAccount::PsiAccount(const UserAccount &acc, PsiContactList *parent, TabManage
 
 	d->eventQueue = new EventQueue(this);
 	connect(d->eventQueue, SIGNAL(queueChanged()), SIGNAL(queueChanged()));
-	connect(d->eventQueue, SIGNAL(queueChanged()), d, SLOT(queueChanged()));
 	connect(d->eventQueue, SIGNAL(eventFromXml(PsiEvent::Ptr)), SLOT(eventFromXml(PsiEvent::Ptr)));
 	d->self = UserListItem(true);
 	d->self.setSubscription(Subscription::Both);
@@ -1178,8 +1237,8 @@ PsiAccount::PsiAccount(const UserAccount &acc, PsiContactList *parent, TabManage
 	connect(d->client, SIGNAL(groupChatError(const Jid &, int, const QString &)), SLOT(client_groupChatError(const Jid &, int, const QString &)));
 	connect(d->client, SIGNAL(beginImportRoster()), SIGNAL(beginBulkContactUpdate()));
 	connect(d->client, SIGNAL(endImportRoster()), SIGNAL(endBulkContactUpdate()));
-	connect(d->client, SIGNAL(xmlIncoming(const QString &)), d, SLOT(client_xmlIncoming(const QString &)));
-	connect(d->client, SIGNAL(xmlOutgoing(const QString &)), d, SLOT(client_xmlOutgoing(const QString &)));
+	d->updateXmlRingbuf();
+	connect(PsiOptions::instance(), SIGNAL(optionChanged(const QString&)), d, SLOT(optionChanged(const QString&)));
 	connect(d->client, SIGNAL(stanzaElementOutgoing(QDomElement &)), d, SLOT(client_stanzaElementOutgoing(QDomElement &)));
 
 	// Privacy manager
@@ -1557,7 +1616,10 @@ void PsiAccount::setUserAccount(const UserAccount &_acc)
 		if(oldfi.exists()) {
 			QDir dir = oldfi.dir();
 			dir.rename(oldfi.fileName(), newfi.fileName());
+			dir.rename(oldfi.fileName() + ".journal", newfi.fileName() + ".journal");
 		}
+		if(!d->eventQueue->journalFile().isEmpty())
+			d->eventQueue->setJournalFile(newfi.filePath());
 	}
 
 	if(d->stream) {
@@ -1606,6 +1668,7 @@ void PsiAccount::deleteQueueFile()
 	if(fi.exists()) {
 		QDir dir = fi.dir();
 		dir.remove(fi.fileName());
+		dir.remove(fi.fileName() + ".journal");
 	}
 }
 
@@ -2565,7 +2628,7 @@ void PsiAccount::client_resourceAvailable(const Jid &j, const Resource &r)
 		u->setPresenceError("");
 		cpUpdate(*u, r.name(), true);
 
-		if(doAnim && PsiOptions::instance()->getOption("options.ui.contactlist.use-status-change-animation").toBool())
+		if(doAnim && PsiOptions::instance()->getOption(contactlistUseStatusChangeAnimationOption).toBool())
 			profileAnimateNick(u->jid());
 
 	}
@@ -2574,7 +2637,7 @@ void PsiAccount::client_resourceAvailable(const Jid &j, const Resource &r)
 		playSound(eOnline);
 
 	// Do the popup test earlier (to avoid needless JID lookups)
-	if ((popupType == PopupOnline && PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.online").toBool()) || (popupType == PopupStatusChange && PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.other-changes").toBool())) {
+	if ((popupType == PopupOnline && PsiOptions::instance()->getOption(passivePopupsStatusOnlineOption).toBool()) || (popupType == PopupStatusChange && PsiOptions::instance()->getOption(passivePopupsStatusOtherChangesOption).toBool())) {
 		if(notifyOnlineOk && doPopup && !d->blockTransportPopupList->find(j, popupType == PopupOnline) && !d->noPopup(IncomingStanza)) {
 			UserListItem *u = findFirstRelevant(j);
 			PopupManager::PopupType pt = PopupManager::AlertNone;
@@ -2583,7 +2646,7 @@ void PsiAccount::client_resourceAvailable(const Jid &j, const Resource &r)
 			else if ( popupType == PopupStatusChange )
 				pt = PopupManager::AlertStatusChange;
 
-			if ((popupType == PopupOnline && PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.online").toBool()) || (popupType == PopupStatusChange && PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.other-changes").toBool())) {
+			if ((popupType == PopupOnline && PsiOptions::instance()->getOption(passivePopupsStatusOnlineOption).toBool()) || (popupType == PopupStatusChange && PsiOptions::instance()->getOption(passivePopupsStatusOtherChangesOption).toBool())) {
 				psi()->popupManager()->doPopup(this, pt, j, r, u, PsiEvent::Ptr(), false);
 			}
 		}
@@ -2667,11 +2730,11 @@ void PsiAccount::client_resourceUnavailable(const Jid &j, const Resource &r)
 		playSound(eOffline);
 
 	// Do the popup test earlier (to avoid needless JID lookups)
-	if(PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.offline").toBool() &&
+	if(PsiOptions::instance()->getOption(passivePopupsStatusOfflineOption).toBool() &&
 	   doPopup && !d->blockTransportPopupList->find(j) && !d->noPopup(IncomingStanza)) {
 		UserListItem *u = findFirstRelevant(j);
 
-		if (PsiOptions::instance()->getOption("options.ui.notifications.passive-popups.status.offline").toBool()) {
+		if (PsiOptions::instance()->getOption(passivePopupsStatusOfflineOption).toBool()) {
 			psi()->popupManager()->doPopup(this, PopupManager::AlertOffline, j, r, u, PsiEvent::Ptr(), false);
 		}
 	}
@@ -2761,7 +2824,7 @@ void PsiAccount::processIncomingMessage(const Message &_m)
 		return;
 
 	// skip headlines?
-	if(_m.type() == "headline" && PsiOptions::instance()->getOption("options.messages.ignore-headlines").toBool())
+	if(_m.type() == "headline" && PsiOptions::instance()->getOption(messagesIgnoreHeadlinesOption).toBool())
 		return;
 
 	if (_m.getForm().registrarType() == "urn:xmpp:captcha") {
@@ -2808,9 +2871,9 @@ void PsiAccount::processIncomingMessage(const Message &_m)
 	QList<UserListItem*> ul = findRelevant(m.from());
 
 	// ignore events from non-roster JIDs?
-	if (ul.isEmpty() && PsiOptions::instance()->getOption("options.messages.ignore-non-roster-contacts").toBool())
+	if (ul.isEmpty() && PsiOptions::instance()->getOption(messagesIgnoreNonRosterContactsOption).toBool())
 	{
-		if (PsiOptions::instance()->getOption("options.messages.exclude-muc-from-ignore").toBool())
+		if (PsiOptions::instance()->getOption(messagesExcludeMucFromIgnoreOption).toBool())
 		{
 #ifdef GROUPCHAT
 			GCMainDlg *w = findDialog<GCMainDlg*>(Jid(_m.from().bare()));
@@ -2859,7 +2922,7 @@ void PsiAccount::processIncomingMessage(const Message &_m)
 
 		// change the type?
 		if (m.type() != "headline" && m.invite().isEmpty() && m.mucInvites().isEmpty()) {
-			const QString type = PsiOptions::instance()->getOption("options.messages.force-incoming-message-type").toString();
+			const QString type = PsiOptions::instance()->getOption(messagesForceIncomingMessageTypeOption).toString();
 			if (type == "message")
 				m.setType("");
 			else if (type == "chat")
@@ -2884,7 +2947,7 @@ void PsiAccount::processIncomingMessage(const Message &_m)
 		//	m.setType("");
 
 		if( m.messageReceipt() == ReceiptRequest && !m.id().isEmpty() &&
-			PsiOptions::instance()->getOption("options.ui.notifications.send-receipts").toBool()) {
+			PsiOptions::instance()->getOption(sendReceiptsOption).toBool()) {
 			UserListItem *u;
 			if(j.compare(d->self.jid(), false) || groupchats().contains(j.bare()) || (!d->loginStatus.isInvisible() && (u = d->userList.find(j)) && (u->subscription().type() == Subscription::To || u->subscription().type() == Subscription::Both))) {
 				Message tm(m.from());
@@ -3226,37 +3289,37 @@ void PsiAccount::playSound(PsiAccount::SoundType _onevent)
 	QString str;
 	switch (onevent) {
 	case eMessage:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.incoming-message").toString();
+		str = PsiOptions::instance()->getOption(soundsIncomingMessageOption).toString();
 		break;
 	case eChat1:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.new-chat").toString();
+		str = PsiOptions::instance()->getOption(soundsNewChatOption).toString();
 		break;
 	case eChat2:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.chat-message").toString();
+		str = PsiOptions::instance()->getOption(soundsChatMessageOption).toString();
 		break;
 	case eGroupChat:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.groupchat-message").toString();
+		str = PsiOptions::instance()->getOption(soundsGroupchatMessageOption).toString();
 		break;
 	case eHeadline:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.incoming-headline").toString();
+		str = PsiOptions::instance()->getOption(soundsIncomingHeadlineOption).toString();
 		break;
 	case eSystem:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.system-message").toString();
+		str = PsiOptions::instance()->getOption(soundsSystemMessageOption).toString();
 		break;
 	case eOnline:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.contact-online").toString();
+		str = PsiOptions::instance()->getOption(soundsContactOnlineOption).toString();
 		break;
 	case eOffline:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.contact-offline").toString();
+		str = PsiOptions::instance()->getOption(soundsContactOfflineOption).toString();
 		break;
 	case eSend:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.outgoing-chat").toString();
+		str = PsiOptions::instance()->getOption(soundsOutgoingChatOption).toString();
 		break;
 	case eIncomingFT:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.incoming-file-transfer").toString();
+		str = PsiOptions::instance()->getOption(soundsIncomingFileTransferOption).toString();
 		break;
 	case eFTComplete:
-		str = PsiOptions::instance()->getOption("options.ui.notifications.sounds.completed-file-transfer").toString();
+		str = PsiOptions::instance()->getOption(soundsCompletedFileTransferOption).toString();
 		break;
 	default:
 		Q_ASSERT(false);
@@ -3273,7 +3336,7 @@ void PsiAccount::playSound(PsiAccount::SoundType _onevent)
 		return;
 
 	// no away sounds?
-	if(PsiOptions::instance()->getOption("options.ui.notifications.sounds.silent-while-away").toBool() && (s == STATUS_AWAY || s == STATUS_XA))
+	if(PsiOptions::instance()->getOption(soundsSilentWhileAwayOption).toBool() && (s == STATUS_AWAY || s == STATUS_XA))
 		return;
 
 	d->psi->playSound(str);
@@ -3745,14 +3808,8 @@ QList<UserListItem*> PsiAccount::findRelevant(const Jid &j) const
 	if(j.compare(d->self.jid(), false))
 		list.append(&d->self);
 	else {
-		foreach(UserListItem* u, d->userList) {
-			if(!u->jid().compare(j, false))
-				continue;
-
-			if(!u->jid().resource().isEmpty()) {
-				if(u->jid().resource() != j.resource())
-					continue;
-			} else {
+		foreach(UserListItem* u, d->userList.findRelevant(j)) {
+			if(u->jid().resource().isEmpty()) {
 				// skip status changes from muc participants
 				// if the MUC somehow got into userList.
 				if (!j.resource().isEmpty() && d->groupchats.contains(j.bare())) continue;
@@ -4669,7 +4726,7 @@ void PsiAccount::dj_sendMessage(const Message &m, bool log)
 	UserListItem *u = findFirstRelevant(m.to());
 	Message nm = m;
 
-	if(PsiOptions::instance()->getOption("options.messages.force-incoming-message-type").toString() == "current-open") {
+	if(PsiOptions::instance()->getOption(messagesForceIncomingMessageTypeOption).toString() == "current-open") {
 		if(u) {
 			switch(u->lastMessageType()) {
 				case 0: nm.setType(""); break;
@@ -5107,7 +5164,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 			return;
 		}
 		else if (m.messageReceipt() == ReceiptReceived) {
-			if (o->getOption("options.ui.notifications.request-receipts").toBool()) {
+			if (o->getOption(requestReceiptsOption).toBool()) {
 				foreach (ChatDlg *c, findChatDialogs(e->from(), false)) {
 					if (c->autoSelectContact()  || c->jid().resource().isEmpty() || e->from().resource() == c->jid().resource()) {
 						if (c->autoSelectContact())
@@ -5124,7 +5181,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 			if (m.carbonDirection() == Message::Sent) {
 				return; // ignore own composing for carbon. TODO should we?
 			}
-			if (o->getOption("options.messages.send-composing-events").toBool()) {
+			if (o->getOption(messagesSendComposingEventsOption).toBool()) {
 				ChatDlg *c = findChatDialogEx(e->from());
 				if (c) {
 					c->setJid(e->from());
@@ -5166,7 +5223,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 				c->incomingMessage(m);
 				soundType = eChat2;
 				if (m.carbonDirection() != Message::Sent &&
-                    ((o->getOption("options.ui.chat.alert-for-already-open-chats").toBool() && !c->isActiveTab())
+                    ((o->getOption(chatAlertForAlreadyOpenChatsOption).toBool() && !c->isActiveTab())
                      || (c->isTabbed() && c->getManagingTabDlg()->isHidden()))) {
 
 					// to alert the chat also, we put it in the queue
@@ -5175,7 +5232,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 				else {
 					putToQueue = false;
 #ifdef YAPSI
-					if (!d->noPopup(activationType) && o->getOption("options.ui.chat.auto-popup").toBool()) {
+					if (!d->noPopup(activationType) && o->getOption(chatAutoPopupOption).toBool()) {
 						openChat(e->from(), activationType);
 					}
 #endif
@@ -5199,7 +5256,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 #ifdef GROUPCHAT
 		else if (m.type() == "groupchat") {
 			putToQueue = false;
-			bool allowMucEvents = o->getOption("options.ui.muc.allow-highlight-events").toBool();
+			bool allowMucEvents = o->getOption(mucAllowHighlightEventsOption).toBool();
 			if (activationType != FromXml) {
 				GCMainDlg *c = findDialog<GCMainDlg*>(e->from());
 				if (c) {
@@ -5283,7 +5340,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 			}
 			else if (userListItem && userListItem->inList()) {
 #else
-			if(o->getOption("options.subscriptions.automatically-allow-authorization").toBool()) {
+			if(o->getOption(subscriptionsAutomaticallyAllowAuthorizationOption).toBool()) {
 #endif
 				// Check if we want to request auth as well
 				UserListItem *u = d->userList.find(ae->from());
@@ -5297,7 +5354,7 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 			}
 		}
 		else if(ae->authType() == "subscribed") {
-			if(!o->getOption("options.ui.notifications.successful-subscription").toBool())
+			if(!o->getOption(successfulSubscriptionOption).toBool())
 				putToQueue = false;
 		}
 		else if(ae->authType() == "unsubscribe") {
@@ -5329,12 +5386,12 @@ void PsiAccount::handleEvent(const PsiEvent::Ptr &e, ActivationType activationTy
 			r = *(u->priority());
 		}
 
-		if ((popupType == PopupManager::AlertChat      && o->getOption("options.ui.notifications.passive-popups.incoming-chat").toBool())     ||
-		    (popupType == PopupManager::AlertMessage   && o->getOption("options.ui.notifications.passive-popups.incoming-message").toBool())  ||
-		    (popupType == PopupManager::AlertHeadline  && o->getOption("options.ui.notifications.passive-popups.incoming-headline").toBool()) ||
-		    (popupType == PopupManager::AlertFile      && o->getOption("options.ui.notifications.passive-popups.incoming-file-transfer").toBool()) ||
-		    (popupType == PopupManager::AlertAvCall    && o->getOption("options.ui.notifications.passive-popups.incoming-message").toBool()) ||
-		    (popupType == PopupManager::AlertComposing && o->getOption("options.ui.notifications.passive-popups.composing").toBool()))
+		if ((popupType == PopupManager::AlertChat      && o->getOption(passivePopupsIncomingChatOption).toBool())     ||
+		    (popupType == PopupManager::AlertMessage   && o->getOption(passivePopupsIncomingMessageOption).toBool())  ||
+		    (popupType == PopupManager::AlertHeadline  && o->getOption(passivePopupsIncomingHeadlineOption).toBool()) ||
+		    (popupType == PopupManager::AlertFile      && o->getOption(passivePopupsIncomingFileTransferOption).toBool()) ||
+		    (popupType == PopupManager::AlertAvCall    && o->getOption(passivePopupsIncomingMessageOption).toBool()) ||
+		    (popupType == PopupManager::AlertComposing && o->getOption(passivePopupsComposingOption).toBool()))
 		{
 #ifdef PSI_PLUGINS
 			if(e->type() != PsiEvent::Plugin) {
@@ -5482,7 +5539,7 @@ void PsiAccount::queueEvent(const PsiEvent::Ptr &e, ActivationType activationTyp
 	d->eventQueue->enqueue(e);
 
 	updateReadNext(e->jid());
-	if(PsiOptions::instance()->getOption("options.ui.contactlist.raise-on-new-event").toBool())
+	if(PsiOptions::instance()->getOption(contactlistRaiseOnNewEventOption).toBool())
 		d->psi->raiseMainwin();
 
 	// update the roster
@@ -5503,27 +5560,27 @@ void PsiAccount::queueEvent(const PsiEvent::Ptr &e, ActivationType activationTyp
 			MessageEvent::Ptr me = e.staticCast<MessageEvent>();
 			const Message &m = me->message();
 			if (m.type() == "chat")
-				doPopup = PsiOptions::instance()->getOption("options.ui.chat.auto-popup").toBool();
+				doPopup = PsiOptions::instance()->getOption(chatAutoPopupOption).toBool();
 			else if (m.type() == "headline")
-				doPopup = PsiOptions::instance()->getOption("options.ui.message.auto-popup-headlines").toBool();
+				doPopup = PsiOptions::instance()->getOption(messageAutoPopupHeadlinesOption).toBool();
 			else
-				doPopup = PsiOptions::instance()->getOption("options.ui.message.auto-popup").toBool();
+				doPopup = PsiOptions::instance()->getOption(messageAutoPopupOption).toBool();
 		}
 		else if (e->type() == PsiEvent::File) {
-			doPopup = PsiOptions::instance()->getOption("options.ui.file-transfer.auto-popup").toBool();
+			doPopup = PsiOptions::instance()->getOption(fileTransferAutoPopupOption).toBool();
 		}
 #ifdef PSI_PLUGINS
 		else if (e->type() == PsiEvent::Plugin)
 			doPopup = false;
 #endif
 		else {
-			doPopup = PsiOptions::instance()->getOption("options.ui.message.auto-popup").toBool();
+			doPopup = PsiOptions::instance()->getOption(messageAutoPopupOption).toBool();
 		}
 
 		// Popup
 		if (doPopup) {
 			UserListItem *u = find(e->jid());
-			if (u && (!PsiOptions::instance()->getOption("options.ui.notifications.popup-dialogs.suppress-when-not-on-roster").toBool() || u->inList()))
+			if (u && (!PsiOptions::instance()->getOption(popupDialogsSuppressWhenNotOnRosterOption).toBool() || u->inList()))
 				openNextEvent(*u, activationType);
 		}
 	}
@@ -5770,7 +5827,7 @@ ChatDlg* PsiAccount::openChat(const Jid& j, ActivationType activationType)
 
 void PsiAccount::chatMessagesRead(const Jid &j)
 {
-//	if(PsiOptions::instance()->getOption("options.ui.chat.alert-for-already-open-chats").toBool()) {
+//	if(PsiOptions::instance()->getOption(chatAlertForAlreadyOpenChatsOption).toBool()) {
 		processChats(j);
 //	}
 }
@@ -6390,7 +6447,7 @@ void PsiAccount::optionsUpdate()
 	setRCEnabled(o->getOption("options.external-control.adhoc-remote-control.enable").toBool());
 
 	// Roster item exchange
-	d->rosterItemExchangeTask->setIgnoreNonRoster(o->getOption("options.messages.ignore-non-roster-contacts").toBool());
+	d->rosterItemExchangeTask->setIgnoreNonRoster(o->getOption(messagesIgnoreNonRosterContactsOption).toBool());
 
 	// Caps manager
 	d->client->capsManager()->setEnabled(o->getOption("options.service-discovery.enable-entity-capabilities").toBool());
@@ -6630,13 +6687,11 @@ QList<PsiAccount::xmlRingElem> PsiAccount::dumpRingbuf()
 }
 
 /**
- * Frees ringbuffer memory and makes it compact.
+ * Drops the contents of the ringbuffer.
  */
 void PsiAccount::clearRingbuf()
 {
 	d->xmlRingbuf.clear();
-	d->xmlRingbufWrite = 0;
-	d->xmlRingbuf.resize(10);
 }
 
 /**
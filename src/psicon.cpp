@@ -63,6 +63,7 @@
 #include "pgputil.h"
 #endif
 #include "eventdb.h"
+#include "edbsegmentfile.h"
 #include "proxy.h"
 #ifdef PSIMNG
 #include "psimng.h"
@@ -356,7 +357,7 @@ PsiCon::PsiCon()
 	d->ftwin = 0;
 #endif
 
-	d->edb = new EDBFlatFile;
+	d->edb = 0;
 
 	d->s5bServer = 0;
 	d->tuneManager = 0;
@@ -459,6 +460,12 @@ bool PsiCon::init()
 	// do some late migration work
 	d->optionsMigration.lateMigration();
 
+	// the history backend is picked once the options are loaded
+	if(options->getOption("options.history.backend").toString() == "segments")
+		d->edb = new EDBSegmentFile;
+	else
+		d->edb = new EDBFlatFile;
+
 #ifdef USE_PEP
 	// Create the tune controller
 	d->tuneManager = new TuneControllerManager();
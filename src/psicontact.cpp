@@ -25,6 +25,7 @@
 
 #include "avatars.h"
 #include "common.h"
+#include "contactsortkey.h"
 #ifndef NEWCONTACTLIST
 # include "contactview.h"
 #endif
@@ -68,6 +69,7 @@ public:
 		, isValid_(true)
 		, isAnimated_(false)
 		, isAlwaysVisible_(false)
+		, avatarCached_(false)
 		, contact_(contact)
 #ifdef YAPSI
 		, gender_(XMPP::VCard::UnknownGender)
@@ -110,6 +112,9 @@ public:
 	bool isValid_;
 	bool isAnimated_;
 	bool isAlwaysVisible_;
+	QPixmap avatar_;
+	bool avatarCached_;
+	ContactSortKey sortKey_;
 #ifdef YAPSI
 	bool showOnlineTemporarily_;
 	bool reconnecting_;
@@ -134,9 +139,17 @@ public:
 		return u_.jid().withResource(resource);
 	}
 
+	const ContactSortKey& sortKey()
+	{
+		if (!sortKey_.isValid())
+			sortKey_.update(rankStatus(oldStatus_.type()), contact_->name(), contact_->comparisonName());
+		return sortKey_;
+	}
+
 	void setStatus(XMPP::Status status)
 	{
 		status_ = status;
+		sortKey_.invalidate();
 #ifdef YAPSI
 		reconnecting_ = false;
 #endif
@@ -153,6 +166,7 @@ private slots:
 		showOnlineTemporarily_ = false;
 #endif
 		oldStatus_ = status_;
+		sortKey_.invalidate();
 		emit contact_->updated();
 	}
 
@@ -217,6 +231,7 @@ const UserListItem& PsiContact::userListItem() const
 void PsiContact::update(const UserListItem& u)
 {
 	d->u_ = u;
+	d->sortKey_.invalidate();
 	Status status = d->status(d->u_);
 
 	d->setStatus(status);
@@ -346,6 +361,22 @@ QIcon PsiContact::picture() const
 	return account()->avatarFactory()->getAvatar(jid().bare());
 }
 
+/**
+ * Returns contact's avatar for the roster. It's kept until the avatar
+ * factory reports a change, so painting doesn't look it up again.
+ */
+QPixmap PsiContact::avatar() const
+{
+	if (!account())
+		return QPixmap();
+	if (!d->avatarCached_) {
+		AvatarFactory* factory = account()->avatarFactory();
+		d->avatar_ = isPrivate() ? factory->getMucAvatar(jid()) : factory->getAvatar(jid());
+		d->avatarCached_ = true;
+	}
+	return d->avatar_;
+}
+
 /**
  * Creates a menu with actions for this contact.
  */
@@ -918,6 +949,7 @@ void PsiContact::avatarChanged(const Jid& j)
 {
 	if (!j.compare(jid(), false))
 		return;
+	d->avatarCached_ = false;
 	emit updated();
 }
 
@@ -951,15 +983,23 @@ bool PsiContact::compare(const ContactListItem* other) const
 
 	const PsiContact* contact = dynamic_cast<const PsiContact*>(other);
 	if (contact) {
-		int rank = rankStatus(d->oldStatus_.type()) - rankStatus(contact->d->oldStatus_.type());
-		if (rank == 0)
-			rank = QString::localeAwareCompare(comparisonName().toLower(), contact->comparisonName().toLower());
-		return rank < 0;
+		return lessThan(contact, true);
 	}
 
 	return ContactListItem::compare(other);
 }
 
+/**
+ * Returns true if the contact is sorted before \a other, by status
+ * and then by name if \a byStatus is true, and by name otherwise.
+ */
+bool PsiContact::lessThan(const PsiContact* other, bool byStatus) const
+{
+	const ContactSortKey& key = d->sortKey();
+	const ContactSortKey& otherKey = other->d->sortKey();
+	return byStatus ? key.lessByStatus(otherKey) : key.lessByName(otherKey);
+}
+
 // FIXME
 #ifdef YAPSI
 static YaPrivacyManager* privacyManager(PsiAccount* account)
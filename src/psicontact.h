@@ -104,6 +104,7 @@ public:
 	virtual bool isEditable() const;
 	virtual bool isDragEnabled() const;
 	virtual bool compare(const ContactListItem* other) const;
+	bool lessThan(const PsiContact* other, bool byStatus) const;
 	virtual bool isRemovable() const;
 
 	virtual XMPP::Jid jid() const;
@@ -111,6 +112,7 @@ public:
 	virtual QString statusText() const;
 	virtual QString toolTip() const;
 	virtual QIcon picture() const;
+	QPixmap avatar() const;
 	virtual QIcon alertPicture() const;
 
 #ifdef YAPSI
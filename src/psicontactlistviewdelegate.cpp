@@ -22,6 +22,7 @@
 
 #include <QPainter>
 #include <QTimer>
+#include <QEvent>
 
 #include "psiiconset.h"
 #include "psioptions.h"
@@ -31,62 +32,70 @@
 #include "avatars.h"
 #include "mood.h"
 #include "activity.h"
-
-static const QString contactListFontOptionPath = "options.ui.look.font.contactlist";
-static const QString slimGroupsOptionPath = "options.ui.look.contactlist.use-slim-group-headings";
-static const QString outlinedGroupsOptionPath = "options.ui.look.contactlist.use-outlined-group-headings";
-static const QString contactListBackgroundOptionPath = "options.ui.look.colors.contactlist.background";
-static const QString showStatusMessagesOptionPath = "options.ui.contactlist.status-messages.show";
-static const QString statusSingleOptionPath = "options.ui.contactlist.status-messages.single-line";
-static const QString showClientIconsPath = "options.ui.contactlist.show-client-icons";
-static const QString showMoodIconsPath = "options.ui.contactlist.show-mood-icons";
-static const QString showGeolocIconsPath = "options.ui.contactlist.show-geolocation-icons";
-static const QString showActivityIconsPath = "options.ui.contactlist.show-activity-icons";
-static const QString showTuneIconsPath = "options.ui.contactlist.show-tune-icons";
-static const QString avatarSizeOptionPath = "options.ui.contactlist.avatars.size";
-static const QString avatarRadiusOptionPath = "options.ui.contactlist.avatars.radius";
-static const QString showAvatarsPath = "options.ui.contactlist.avatars.show";
-static const QString useDefaultAvatarPath = "options.ui.contactlist.avatars.use-default-avatar";
-static const QString avatarAtLeftOptionPath = "options.ui.contactlist.avatars.avatars-at-left";
-static const QString showStatusIconsPath = "options.ui.contactlist.show-status-icons";
-static const QString statusIconsOverAvatarsPath = "options.ui.contactlist.status-icon-over-avatar";
-static const QString allClientsOptionPath = "options.ui.contactlist.show-all-client-icons";
-static const QString enableGroupsOptionPath = "options.ui.contactlist.enable-groups";
-static const QString statusIconsetOptionPath = "options.iconsets.status";
+#include "alertable.h"
+
+static const OptionKey contactListFontOptionPath("options.ui.look.font.contactlist");
+static const OptionKey slimGroupsOptionPath("options.ui.look.contactlist.use-slim-group-headings");
+static const OptionKey outlinedGroupsOptionPath("options.ui.look.contactlist.use-outlined-group-headings");
+static const OptionKey contactListBackgroundOptionPath("options.ui.look.colors.contactlist.background");
+static const OptionKey showStatusMessagesOptionPath("options.ui.contactlist.status-messages.show");
+static const OptionKey statusSingleOptionPath("options.ui.contactlist.status-messages.single-line");
+static const OptionKey showClientIconsPath("options.ui.contactlist.show-client-icons");
+static const OptionKey showMoodIconsPath("options.ui.contactlist.show-mood-icons");
+static const OptionKey showGeolocIconsPath("options.ui.contactlist.show-geolocation-icons");
+static const OptionKey showActivityIconsPath("options.ui.contactlist.show-activity-icons");
+static const OptionKey showTuneIconsPath("options.ui.contactlist.show-tune-icons");
+static const OptionKey avatarSizeOptionPath("options.ui.contactlist.avatars.size");
+static const OptionKey avatarRadiusOptionPath("options.ui.contactlist.avatars.radius");
+static const OptionKey showAvatarsPath("options.ui.contactlist.avatars.show");
+static const OptionKey useDefaultAvatarPath("options.ui.contactlist.avatars.use-default-avatar");
+static const OptionKey avatarAtLeftOptionPath("options.ui.contactlist.avatars.avatars-at-left");
+static const OptionKey showStatusIconsPath("options.ui.contactlist.show-status-icons");
+static const OptionKey statusIconsOverAvatarsPath("options.ui.contactlist.status-icon-over-avatar");
+static const OptionKey allClientsOptionPath("options.ui.contactlist.show-all-client-icons");
+static const OptionKey enableGroupsOptionPath("options.ui.contactlist.enable-groups");
+static const OptionKey statusIconsetOptionPath("options.iconsets.status");
+
+// memory for the avatars rendered for the roster, in KiB
+static const int avatarCacheSize = 8192;
 
 PsiContactListViewDelegate::PsiContactListViewDelegate(ContactListView* parent) :
     ContactListViewDelegate(parent),
     fontMetrics_(0),
-    statusFontMetrics_(0)
+    statusFontMetrics_(0),
+    alertsShown_(false)
 {
 	alertTimer_.setInterval(100);
 	alertTimer_.setSingleShot(false);
 	connect(&alertTimer_, SIGNAL(timeout()), SLOT(updateAlerts()));
+	parent->installEventFilter(this);
+
+	avatarCache_.setMaxCost(avatarCacheSize);
 
 	connect(PsiOptions::instance(), SIGNAL(optionChanged(const QString&)), SLOT(optionChanged(const QString&)));
 	connect(PsiIconset::instance(), SIGNAL(rosterIconsSizeChanged(int)), SLOT(rosterIconsSizeChanged(int)));
 	statusIconSize_ = PsiIconset::instance()->roster.value(PsiOptions::instance()->getOption(statusIconsetOptionPath).toString())->iconSize();
 	bulkOptUpdate = true;
-	optionChanged(slimGroupsOptionPath);
-	optionChanged(outlinedGroupsOptionPath);
-	optionChanged(contactListFontOptionPath);
-	optionChanged(contactListBackgroundOptionPath);
-	optionChanged(showStatusMessagesOptionPath);
-	optionChanged(statusSingleOptionPath);
-	optionChanged(showClientIconsPath);
-	optionChanged(showMoodIconsPath);
-	optionChanged(showGeolocIconsPath);
-	optionChanged(showActivityIconsPath);
-	optionChanged(showTuneIconsPath);
-	optionChanged(avatarSizeOptionPath);
-	optionChanged(avatarRadiusOptionPath);
-	optionChanged(showAvatarsPath);
-	optionChanged(useDefaultAvatarPath);
-	optionChanged(avatarAtLeftOptionPath);
-	optionChanged(showStatusIconsPath);
-	optionChanged(statusIconsOverAvatarsPath);
-	optionChanged(allClientsOptionPath);
-	optionChanged(enableGroupsOptionPath);
+	optionChanged(slimGroupsOptionPath.name());
+	optionChanged(outlinedGroupsOptionPath.name());
+	optionChanged(contactListFontOptionPath.name());
+	optionChanged(contactListBackgroundOptionPath.name());
+	optionChanged(showStatusMessagesOptionPath.name());
+	optionChanged(statusSingleOptionPath.name());
+	optionChanged(showClientIconsPath.name());
+	optionChanged(showMoodIconsPath.name());
+	optionChanged(showGeolocIconsPath.name());
+	optionChanged(showActivityIconsPath.name());
+	optionChanged(showTuneIconsPath.name());
+	optionChanged(avatarSizeOptionPath.name());
+	optionChanged(avatarRadiusOptionPath.name());
+	optionChanged(showAvatarsPath.name());
+	optionChanged(useDefaultAvatarPath.name());
+	optionChanged(avatarAtLeftOptionPath.name());
+	optionChanged(showStatusIconsPath.name());
+	optionChanged(statusIconsOverAvatarsPath.name());
+	optionChanged(allClientsOptionPath.name());
+	optionChanged(enableGroupsOptionPath.name());
 	bulkOptUpdate = false;
 	recomputeGeometry();
 	contactList()->viewport()->update();
@@ -94,6 +103,8 @@ PsiContactListViewDelegate::PsiContactListViewDelegate(ContactListView* parent)
 
 PsiContactListViewDelegate::~PsiContactListViewDelegate()
 {
+	if (alertsShown_)
+		Alertable::removeView();
 	delete fontMetrics_;
 	delete statusFontMetrics_;
 }
@@ -174,7 +185,16 @@ QPixmap PsiContactListViewDelegate::avatarIcon(const QModelIndex& index) const
 	if(av.isNull() && useDefaultAvatar_)
 		av = IconsetFactory::iconPixmap("psi/default_avatar");
 
-	return AvatarFactory::roundedAvatar(av, avatarRadius_, avSize);
+	// scaling and rounding is too slow to be done on every paint, so the result
+	// is kept for the pixmap. A changed avatar is a new pixmap, so it's never stale.
+	const RenderedAvatarKey key = { av.cacheKey(), avSize, avatarRadius_ };
+	const QPixmap* cached = avatarCache_.object(key);
+	if (cached)
+		return *cached;
+
+	const QPixmap rendered = AvatarFactory::roundedAvatar(av, avatarRadius_, avSize);
+	avatarCache_.insert(key, new QPixmap(rendered), qMax(1, rendered.width() * rendered.height() * 4 / 1024));
+	return rendered;
 }
 
 QSize PsiContactListViewDelegate::sizeHint(const QStyleOptionViewItem& /*option*/, const QModelIndex& index) const
@@ -775,7 +795,7 @@ void PsiContactListViewDelegate::optionChanged(const QString& option)
 	bool updateGeometry = false;
 	bool updateViewport = false;
 
-	if (option == contactListFontOptionPath) {
+	if (option == contactListFontOptionPath.name()) {
 		font_.fromString(PsiOptions::instance()->getOption(contactListFontOptionPath).toString());
 		delete fontMetrics_;
 		delete statusFontMetrics_;
@@ -785,82 +805,84 @@ void PsiContactListViewDelegate::optionChanged(const QString& option)
 
 		updateGeometry = true;
 	}
-	else if (option == contactListBackgroundOptionPath) {
+	else if (option == contactListBackgroundOptionPath.name()) {
 		QPalette p = contactList()->palette();
-		p.setColor(QPalette::Base, ColorOpt::instance()->color(contactListBackgroundOptionPath));
+		p.setColor(QPalette::Base, ColorOpt::instance()->color(contactListBackgroundOptionPath.name()));
 		const_cast<ContactListView*>(contactList())->setPalette(p);
 		updateViewport = true;
 	}
-	else if (option == showStatusMessagesOptionPath) {
+	else if (option == showStatusMessagesOptionPath.name()) {
 		showStatusMessages_ = PsiOptions::instance()->getOption(showStatusMessagesOptionPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showClientIconsPath) {
+	else if(option == showClientIconsPath.name()) {
 		showClientIcons_ = PsiOptions::instance()->getOption(showClientIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showMoodIconsPath) {
+	else if(option == showMoodIconsPath.name()) {
 		showMoodIcons_ = PsiOptions::instance()->getOption(showMoodIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showActivityIconsPath) {
+	else if(option == showActivityIconsPath.name()) {
 		showActivityIcons_ = PsiOptions::instance()->getOption(showActivityIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showTuneIconsPath) {
+	else if(option == showTuneIconsPath.name()) {
 		showTuneIcons_ = PsiOptions::instance()->getOption(showTuneIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showGeolocIconsPath) {
+	else if(option == showGeolocIconsPath.name()) {
 		showGeolocIcons_ = PsiOptions::instance()->getOption(showGeolocIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == showAvatarsPath) {
+	else if(option == showAvatarsPath.name()) {
 		showAvatars_ = PsiOptions::instance()->getOption(showAvatarsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == useDefaultAvatarPath) {
+	else if(option == useDefaultAvatarPath.name()) {
 		useDefaultAvatar_ = PsiOptions::instance()->getOption(useDefaultAvatarPath).toBool();
 		updateViewport = true;
 	}
-	else if(option == avatarAtLeftOptionPath) {
+	else if(option == avatarAtLeftOptionPath.name()) {
 		avatarAtLeft_ = PsiOptions::instance()->getOption(avatarAtLeftOptionPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == avatarSizeOptionPath) {
+	else if(option == avatarSizeOptionPath.name()) {
 	    int s = PsiOptions::instance()->getOption(avatarSizeOptionPath).toInt();
 		avatarRect_.setSize(QSize(s, s));
+		avatarCache_.clear();
 		updateGeometry = true;
 	}
-	else if(option == avatarRadiusOptionPath) {
+	else if(option == avatarRadiusOptionPath.name()) {
 		avatarRadius_ = PsiOptions::instance()->getOption(avatarRadiusOptionPath).toInt();
+		avatarCache_.clear();
 		updateViewport = true;
 	}
-	else if(option == showStatusIconsPath) {
+	else if(option == showStatusIconsPath.name()) {
 		showStatusIcons_ = PsiOptions::instance()->getOption(showStatusIconsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == statusIconsOverAvatarsPath) {
+	else if(option == statusIconsOverAvatarsPath.name()) {
 		statusIconsOverAvatars_ = PsiOptions::instance()->getOption(statusIconsOverAvatarsPath).toBool();
 		updateGeometry = true;
 	}
-	else if(option == allClientsOptionPath) {
+	else if(option == allClientsOptionPath.name()) {
 		allClients_= PsiOptions::instance()->getOption(allClientsOptionPath).toBool();
 		updateViewport = true;
 	}
-	else if(option == enableGroupsOptionPath) {
+	else if(option == enableGroupsOptionPath.name()) {
 		enableGroups_ = PsiOptions::instance()->getOption(enableGroupsOptionPath).toBool();
 		updateViewport = true;
 	}
-	else if(option == slimGroupsOptionPath) {
+	else if(option == slimGroupsOptionPath.name()) {
 		slimGroup_ = PsiOptions::instance()->getOption(slimGroupsOptionPath).toBool();
 		updateViewport = true;
 	}
-	else if(option == outlinedGroupsOptionPath) {
+	else if(option == outlinedGroupsOptionPath.name()) {
 		outlinedGroup_ = PsiOptions::instance()->getOption(outlinedGroupsOptionPath).toBool();
 		updateViewport = true;
 	}
-	else if(option == statusSingleOptionPath) {
+	else if(option == statusSingleOptionPath.name()) {
 		statusSingle_ = !PsiOptions::instance()->getOption(statusSingleOptionPath).toBool();
 		updateGeometry = true;
 	}
@@ -898,12 +920,35 @@ void PsiContactListViewDelegate::contactAlert(const QModelIndex& index)
 	else
 		alertingIndexes_.remove(index);
 
-	if (alertingIndexes_.isEmpty())
+	if (alertingIndexes_.isEmpty() || !alertsShown_)
 		alertTimer_.stop();
 	else
 		alertTimer_.start();
 }
 
+/**
+ * Animates the alerts, and repaints them, only while the contact list
+ * is visible.
+ */
+bool PsiContactListViewDelegate::eventFilter(QObject* object, QEvent* event)
+{
+	if (object != contactList())
+		return ContactListViewDelegate::eventFilter(object, event);
+
+	if (event->type() == QEvent::Show && !alertsShown_) {
+		alertsShown_ = true;
+		Alertable::addView();
+		if (!alertingIndexes_.isEmpty())
+			alertTimer_.start();
+	}
+	else if (event->type() == QEvent::Hide && alertsShown_) {
+		alertsShown_ = false;
+		Alertable::removeView();
+		alertTimer_.stop();
+	}
+	return false;
+}
+
 void PsiContactListViewDelegate::clearAlerts()
 {
 	alertingIndexes_.clear();
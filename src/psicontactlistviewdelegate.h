@@ -22,9 +22,28 @@
 #define PSICONTACTLISTVIEWDELEGATE_H
 
 #include <QTimer>
+#include <QCache>
 
 #include "contactlistviewdelegate.h"
 
+// identifies an avatar rendered for the roster
+struct RenderedAvatarKey
+{
+	qint64 source; // QPixmap::cacheKey() of the original avatar
+	int size;
+	int radius;
+
+	bool operator==(const RenderedAvatarKey& other) const
+	{
+		return source == other.source && size == other.size && radius == other.radius;
+	}
+};
+
+inline uint qHash(const RenderedAvatarKey& key)
+{
+	return qHash(key.source) ^ (uint(key.size) << 16) ^ uint(key.radius);
+}
+
 class PsiContactListViewDelegate : public ContactListViewDelegate
 {
 	Q_OBJECT
@@ -67,6 +86,9 @@ protected:
 
 	virtual void recomputeGeometry();
 
+	// reimplemented
+	bool eventFilter(QObject* object, QEvent* event);
+
 private slots:
 	void optionChanged(const QString& option);
 	void updateAlerts();
@@ -75,6 +97,8 @@ private slots:
 private:
 	mutable QTimer alertTimer_;
 	mutable QHash<QModelIndex, bool> alertingIndexes_;
+	bool alertsShown_; // registered as a view of the alerts
+	mutable QCache<RenderedAvatarKey, QPixmap> avatarCache_; // cost in KiB
 	bool bulkOptUpdate;
 
 	// options
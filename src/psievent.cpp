@@ -23,6 +23,9 @@
 #include <QDomElement>
 #include <QTextStream>
 #include <QList>
+#include <QHash>
+#include <QFile>
+#include <QDataStream>
 #include <QCoreApplication>
 
 #include "psicon.h"
@@ -827,6 +830,8 @@ EventQueue::EventQueue(PsiAccount *account)
 	: psi_(0)
 	, account_(0)
 	, enabled_(false)
+	, journalGen_(0)
+	, journalSize_(0)
 {
 	account_ = account;
 	psi_ = account_->psi();
@@ -837,6 +842,8 @@ EventQueue::EventQueue(const EventQueue &from)
 	, psi_(0)
 	, account_(0)
 	, enabled_(false)
+	, journalGen_(0)
+	, journalSize_(0)
 {
 	Q_ASSERT(false);
 	Q_UNUSED(from);
@@ -932,6 +939,7 @@ void EventQueue::enqueue(const PsiEvent::Ptr &e)
 	if ( !found )
 		list_.append(i);
 
+	journal(JournalEnqueue, i);
 	emit queueChanged();
 }
 
@@ -946,6 +954,7 @@ void EventQueue::dequeue(const PsiEvent::Ptr &e)
 				GlobalEventQueue::instance()->dequeue(i);
 			}
 			list_.removeAll(i);
+			journal(JournalDequeue, i);
 			emit queueChanged();
 			delete i;
 			return;
@@ -963,6 +972,7 @@ PsiEvent::Ptr EventQueue::dequeue(const Jid &j, bool compareRes)
 				GlobalEventQueue::instance()->dequeue(i);
 			}
 			list_.removeAll(i);
+			journal(JournalDequeue, i);
 			emit queueChanged();
 			delete i;
 			return e;
@@ -998,6 +1008,7 @@ PsiEvent::Ptr EventQueue::dequeueNext()
 		GlobalEventQueue::instance()->dequeue(i);
 	}
 	list_.removeAll(i);
+	journal(JournalDequeue, i);
 	emit queueChanged();
 	delete i;
 	return e;
@@ -1058,6 +1069,7 @@ void EventQueue::extractChats(QList<PsiEvent::Ptr> *el, const Jid &j, bool compa
 				GlobalEventQueue::instance()->dequeue(ei);
 			}
 			it = list_.erase(it);
+			journal(JournalDequeue, ei);
 			delete ei;
 			changed = true;
 			continue;
@@ -1090,6 +1102,7 @@ void EventQueue::extractByType(int type, QList<PsiEvent::Ptr> *el)
 				GlobalEventQueue::instance()->dequeue(ei);
 			}
 			it = list_.erase(it);
+			journal(JournalDequeue, ei);
 			delete ei;
 			changed = true;
 			continue;
@@ -1117,6 +1130,8 @@ void EventQueue::clear()
 		delete i;
 	}
 
+	// an empty snapshot is as cheap as a journal record
+	compact();
 	emit queueChanged();
 }
 
@@ -1134,6 +1149,7 @@ void EventQueue::clear(const Jid &j, bool compareRes)
 				GlobalEventQueue::instance()->dequeue(ei);
 			}
 			it = list_.erase(it);
+			journal(JournalDequeue, ei);
 			delete ei;
 			changed = true;
 		}
@@ -1149,17 +1165,19 @@ QDomElement EventQueue::toXml(QDomDocument *doc) const
 {
 	QDomElement e = doc->createElement("eventQueue");
 	e.setAttribute("version", "1.0");
+	e.setAttribute("journal", QString::number(journalGen_));
 	e.appendChild(textTag(doc, "progver", ApplicationInfo::version()));
 
 	foreach(EventItem *i, list_) {
 		QDomElement event = i->event()->toXml(doc);
+		event.setAttribute("queueId", QString::number(i->id()));
 		e.appendChild( event );
 	}
 
 	return e;
 }
 
-bool EventQueue::fromXml(const QDomElement *q)
+static bool isEventQueue(const QDomElement *q)
 {
 	if ( !q )
 		return false;
@@ -1170,6 +1188,36 @@ bool EventQueue::fromXml(const QDomElement *q)
 	if ( q->attribute("version") != "1.0" )
 		return false;
 
+	return true;
+}
+
+PsiEvent::Ptr EventQueue::eventFromElement(const QDomElement &e)
+{
+	PsiEvent::Ptr event;
+	QString eventType = e.attribute("type");
+	if ( eventType == "MessageEvent" ) {
+		event = MessageEvent::Ptr(new MessageEvent(0));
+		if ( !event->fromXml(psi_, account_, &e) ) {
+			//delete event;
+			event.clear();
+		}
+	}
+	else if ( eventType == "AuthEvent" ) {
+		event = AuthEvent::Ptr(new AuthEvent("", "", 0));
+		if ( !event->fromXml(psi_, account_, &e) ) {
+			//delete event;
+			event.clear();
+		}
+	}
+
+	return event;
+}
+
+bool EventQueue::fromXml(const QDomElement *q)
+{
+	if ( !isEventQueue(q) )
+		return false;
+
 	QString progver = subTagText(*q, "progver");
 
 	for(QDomNode n = q->firstChild(); !n.isNull(); n = n.nextSibling()) {
@@ -1180,23 +1228,7 @@ bool EventQueue::fromXml(const QDomElement *q)
 		if ( e.tagName() != "event" )
 			continue;
 
-		PsiEvent::Ptr event;
-		QString eventType = e.attribute("type");
-		if ( eventType == "MessageEvent" ) {
-			event = MessageEvent::Ptr(new MessageEvent(0));
-			if ( !event->fromXml(psi_, account_, &e) ) {
-				//delete event;
-				event.clear();
-			}
-		}
-		else if ( eventType == "AuthEvent" ) {
-			event = AuthEvent::Ptr(new AuthEvent("", "", 0));
-			if ( !event->fromXml(psi_, account_, &e) ) {
-				//delete event;
-				event.clear();
-			}
-		}
-
+		PsiEvent::Ptr event = eventFromElement(e);
 		if ( event )
 			emit eventFromXml( event );
 	}
@@ -1226,6 +1258,10 @@ bool EventQueue::toFile(const QString &fname)
 	return f.saveDocument(doc);
 }
 
+/**
+ * Loads the snapshot \a fname and replays the journal which was written
+ * next to it.  The events are passed on with eventFromXml().
+ */
 bool EventQueue::fromFile(const QString &fname)
 {
 	AtomicXmlFile f(fname);
@@ -1234,7 +1270,179 @@ bool EventQueue::fromFile(const QString &fname)
 		return false;
 
 	QDomElement base = doc.documentElement();
-	return fromXml(&base);
+	if ( !isEventQueue(&base) )
+		return false;
+
+	journalGen_ = base.attribute("journal").toUInt();
+
+	QList<QDomElement> events;
+	for(QDomNode n = base.firstChild(); !n.isNull(); n = n.nextSibling()) {
+		QDomElement e = n.toElement();
+		if ( !e.isNull() && e.tagName() == "event" )
+			events += e;
+	}
+	replayJournal(fname, &doc, &events);
+
+	foreach(const QDomElement &e, events) {
+		PsiEvent::Ptr event = eventFromElement(e);
+		if ( event )
+			emit eventFromXml( event );
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// EventQueue journal
+//
+// Rewriting the whole queue on every change gets expensive once thousands
+// of events are pending, so changes are appended to a journal instead:
+//
+//   header:  quint32 magic, quint32 generation
+//   record:  quint8 op, qint32 queue id [, QString event xml for enqueue]
+//
+// The generation is also stored in the snapshot, so a journal which is left
+// over from an older snapshot (e.g. after a crash during compact()) is
+// ignored.  The queue ids of the snapshot are the ids of the queue which
+// wrote it, which is why the queue is compacted right after loading.
+//----------------------------------------------------------------------------
+
+static const quint32 EVENTQUEUE_JOURNAL_MAGIC = 0x5053514a; // "PSQJ"
+
+static QString journalName(const QString &fname)
+{
+	return fname + ".journal";
+}
+
+QString EventQueue::journalFile() const
+{
+	return journalFile_;
+}
+
+/**
+ * Persists all further changes to the queue in the journal of the snapshot
+ * \a fname.  Call compact() to write the snapshot itself.  An empty name
+ * turns journalling off.
+ */
+void EventQueue::setJournalFile(const QString &fname)
+{
+	journalFile_ = fname;
+	journalSize_ = 0;
+}
+
+/**
+ * Writes a snapshot of the queue and starts a new, empty journal.
+ */
+bool EventQueue::compact()
+{
+	if (journalFile_.isEmpty())
+		return false;
+
+	++journalGen_;
+	if (!toFile(journalFile_)) {
+		--journalGen_;
+		return false;
+	}
+	journalSize_ = 0;
+
+	QFile file(journalName(journalFile_));
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << EVENTQUEUE_JOURNAL_MAGIC << journalGen_;
+	return out.status() == QDataStream::Ok;
+}
+
+void EventQueue::journal(JournalOp op, const EventItem *i)
+{
+	if (journalFile_.isEmpty())
+		return;
+
+	// the journal is created by compact(), so a missing one means that the
+	// queue file was deleted
+	QFile file(journalName(journalFile_));
+	if (!file.exists() || !file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << quint8(op) << qint32(i->id());
+	if (op == JournalEnqueue) {
+		QDomDocument doc;
+		doc.appendChild(i->event()->toXml(&doc));
+		out << doc.toString(-1);
+	}
+	file.close();
+
+	// fold the journal into the snapshot once replaying it costs more than
+	// loading the queue, which keeps the cost per change constant
+	if (++journalSize_ > qMax(64, 2 * list_.count()))
+		compact();
+}
+
+/**
+ * Applies the journal of the snapshot \a fname to the event elements
+ * \a events, which were read from that snapshot into \a doc.
+ */
+bool EventQueue::replayJournal(const QString &fname, QDomDocument *doc, QList<QDomElement> *events)
+{
+	QFile file(journalName(fname));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_4_6);
+	quint32 magic, gen;
+	in >> magic >> gen;
+	if (in.status() != QDataStream::Ok || magic != EVENTQUEUE_JOURNAL_MAGIC || gen != journalGen_)
+		return false;
+
+	QHash<int, int> index; // queue id -> position in events
+	for (int n = 0; n < events->count(); ++n) {
+		bool ok;
+		int id = events->at(n).attribute("queueId").toInt(&ok);
+		if (ok)
+			index.insert(id, n);
+	}
+
+	// stop at the first incomplete record, which is where a crash cut it off
+	while (!in.atEnd()) {
+		quint8 op;
+		qint32 id;
+		in >> op >> id;
+		if (in.status() != QDataStream::Ok)
+			break;
+
+		if (op == JournalEnqueue) {
+			QString xml;
+			in >> xml;
+			QDomDocument record;
+			if (in.status() != QDataStream::Ok || !record.setContent(xml))
+				break;
+			index.insert(id, events->count());
+			events->append(doc->importNode(record.documentElement(), true).toElement());
+		}
+		else if (op == JournalDequeue) {
+			QHash<int, int>::Iterator it = index.find(id);
+			if (it != index.end()) {
+				(*events)[it.value()] = QDomElement();
+				index.erase(it);
+			}
+		}
+		else {
+			break;
+		}
+	}
+
+	QList<QDomElement>::Iterator it = events->begin();
+	while (it != events->end()) {
+		if (it->isNull())
+			it = events->erase(it);
+		else
+			++it;
+	}
+	return true;
 }
 
 #include "psievent.moc"
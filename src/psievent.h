@@ -417,15 +417,28 @@ public:
 	bool toFile(const QString &fname);
 	bool fromFile(const QString &fname);
 
+	QString journalFile() const;
+	void setJournalFile(const QString &fname);
+	bool compact();
+
 signals:
 	void eventFromXml(const PsiEvent::Ptr &);
 	void queueChanged();
 
 private:
+	enum JournalOp { JournalEnqueue = 1, JournalDequeue };
+
+	PsiEvent::Ptr eventFromElement(const QDomElement &e);
+	void journal(JournalOp op, const EventItem *i = 0);
+	bool replayJournal(const QString &fname, QDomDocument *doc, QList<QDomElement> *events);
+
 	QList<EventItem*> list_;
 	PsiCon* psi_;
 	PsiAccount* account_;
 	bool enabled_;
+	QString journalFile_;
+	quint32 journalGen_;
+	int journalSize_;
 };
 
 
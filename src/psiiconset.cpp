@@ -30,6 +30,8 @@
 #include <QFileInfo>
 #include <QCoreApplication>
 #include <QSet>
+#include <QHash>
+#include <QVector>
 #include <QTextStream>
 
 using namespace XMPP;
@@ -41,6 +43,84 @@ struct ClientIconCheck
 };
 typedef QMap<QString, QList<ClientIconCheck> > ClientIconMap;
 
+//----------------------------------------------------------------------------
+// EmoticonMatcher
+//----------------------------------------------------------------------------
+
+// Trie of the texts of all emoticons, so that a string can be searched for
+// all of them at once.  The edges of all nodes share one hash, keyed by the
+// node and the next character; node 0 is the root.
+class EmoticonMatcher
+{
+public:
+	EmoticonMatcher()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		edges.clear();
+		icons.clear();
+		icons.append(0);
+	}
+
+	// texts which are already taken keep their first icon
+	void add(const QString &text, PsiIcon *icon)
+	{
+		if(text.isEmpty())
+			return;
+
+		int node = 0;
+		foreach(const QChar &c, text) {
+			int next = edges.value(key(node, c));
+			if(!next) {
+				next = icons.count();
+				icons.append(0);
+				edges.insert(key(node, c), next);
+			}
+			node = next;
+		}
+		if(!icons[node])
+			icons[node] = icon;
+	}
+
+	PsiIcon *find(const QString &str, int from, int *pos, int *len) const
+	{
+		for(int n = from; n < str.length(); ++n) {
+			// there must be whitespace at least on one side of the emoticon
+			bool leftSpace = n == 0 || str[n-1].isSpace();
+
+			PsiIcon *found = 0;
+			int node = 0;
+			for(int k = n; k < str.length(); ++k) {
+				node = edges.value(key(node, str[k]));
+				if(!node)
+					break;
+				if(icons[node] && (leftSpace || k+1 == str.length() || str[k+1].isSpace())) {
+					found = icons[node];
+					*len = k+1 - n;
+				}
+			}
+
+			if(found) {
+				*pos = n;
+				return found;
+			}
+		}
+		return 0;
+	}
+
+private:
+	static quint64 key(int node, QChar c)
+	{
+		return (quint64(node) << 16) | c.unicode();
+	}
+
+	QHash<quint64, int> edges;
+	QVector<PsiIcon*> icons; // icon of the text ending in each node
+};
+
 
 //----------------------------------------------------------------------------
 // PsiIconset
@@ -55,6 +135,7 @@ public:
 	ClientIconMap client2icon;
 	QString cur_system, cur_status, cur_moods, cur_clients, cur_activity, cur_affiliations;
 	QStringList cur_emoticons;
+	EmoticonMatcher emoticonMatcher;
 	QMap<QString, QString> cur_service_status;
 	QMap<QString, QString> cur_custom_status;
 
@@ -76,6 +157,9 @@ public:
 	}
 
 	void stripFirstAnimFrame(Iconset &is) {
+		// all icons would be decoded one by one below otherwise
+		is.decode();
+
 		QListIterator<PsiIcon*> it = is.iterator();
 		while (it.hasNext()) {
 			it.next()->stripFirstAnimFrame();
@@ -96,6 +180,8 @@ public:
 			return;
 		}
 
+		from->decode();
+
 		QListIterator<PsiIcon*> it = from->iterator();
 		while( it.hasNext()) {
 			PsiIcon *icon = it.next();
@@ -441,11 +527,33 @@ void PsiIconset::loadEmoticons()
 		emoticons.clear();
 		emoticons = d->emoticons();
 
+		d->emoticonMatcher.clear();
+		foreach(Iconset *is, emoticons) {
+			QListIterator<PsiIcon*> it = is->iterator();
+			while (it.hasNext()) {
+				PsiIcon *icon = it.next();
+				foreach(const PsiIcon::IconText &t, icon->text())
+					d->emoticonMatcher.add(t.text, icon);
+			}
+		}
+
 		d->cur_emoticons = cur_emoticons;
 		emit emoticonsChanged();
 	}
 }
 
+/**
+ * Finds the leftmost emoticon in \a str, starting at \a from, with
+ * whitespace on at least one side.  Of the emoticons at the same position
+ * the longest is taken, and of those the one from the first iconset.
+ * Returns 0 if there is none, otherwise the icon, with its position and
+ * length in \a pos and \a len.
+ */
+PsiIcon *PsiIconset::findEmoticon(const QString &str, int from, int *pos, int *len) const
+{
+	return d->emoticonMatcher.find(str, from, pos, len);
+}
+
 bool PsiIconset::loadMoods()
 {
 	bool ok = true;
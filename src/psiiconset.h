@@ -51,6 +51,7 @@ public:
 	const Iconset &system() const;
 	void stripFirstAnimFrame(Iconset *);
 	static void removeAnimation(Iconset *);
+	PsiIcon *findEmoticon(const QString &str, int from, int *pos, int *len) const;
 
 	PsiIcon *event2icon(const PsiEvent::Ptr &e);
 
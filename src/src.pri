@@ -117,6 +117,9 @@ HEADERS += \
 	$$PWD/applicationinfo.h \
 	$$PWD/pgptransaction.h \
 	$$PWD/userlist.h \
+	$$PWD/jidindex.h \
+	$$PWD/contactsortkey.h \
+	$$PWD/xmlringbuffer.h \
 	$$PWD/mainwin.h \
 	$$PWD/mainwin_p.h \
 	$$PWD/psitrayicon.h \
@@ -149,6 +152,8 @@ HEADERS += \
 	$$PWD/infodlg.h \
 	$$PWD/translationmanager.h \
 	$$PWD/eventdb.h \
+	$$PWD/edbtextindex.h \
+	$$PWD/edbsegmentfile.h \
 	$$PWD/historydlg.h \
 	$$PWD/tipdlg.h \
 	$$PWD/searchdlg.h \
@@ -285,6 +290,8 @@ SOURCES += \
 	$$PWD/infodlg.cpp \
 	$$PWD/translationmanager.cpp \
 	$$PWD/eventdb.cpp \
+	$$PWD/edbtextindex.cpp \
+	$$PWD/edbsegmentfile.cpp \
 	$$PWD/historydlg.cpp \
 	$$PWD/searchdlg.cpp \
 	$$PWD/registrationdlg.cpp \
@@ -344,6 +351,7 @@ SOURCES += \
 	$$PWD/psicontactlist.cpp \
 	$$PWD/psicon.cpp \
 	$$PWD/psiaccount.cpp \
+	$$PWD/xmlringbuffer.cpp \
 	$$PWD/accountlabel.cpp \
 	$$PWD/bookmarkmanagedlg.cpp \
 	$$PWD/vcardphotodlg.cpp \
@@ -363,10 +371,12 @@ filetransfer {
 	DEFINES += FILETRANSFER
 
 	HEADERS += \
-		$$PWD/filetransdlg.h
+		$$PWD/filetransdlg.h \
+		$$PWD/filetransferio.h
 
 	SOURCES += \
-		$$PWD/filetransdlg.cpp
+		$$PWD/filetransdlg.cpp \
+		$$PWD/filetransferio.cpp
 
 	FORMS += \
 		$$PWD/filetrans.ui
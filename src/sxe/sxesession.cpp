@@ -29,6 +29,15 @@ enum {MAXCHDATA = 1024};
 
 using namespace XMPP;
 
+// QDomNode has no qHash(), but two nodes are the same iff they share their
+// private data, so its address is used as the key of the node lookup tables.
+class SxeNodeKey : public QDomNode {
+	public:
+		static const void* of(const QDomNode &node) {
+			return node.*(&SxeNodeKey::impl);
+		}
+};
+
 //----------------------------------------------------------------------------
 // SxeSession
 //----------------------------------------------------------------------------
@@ -66,8 +75,10 @@ void SxeSession::initializeDocument(const QDomDocument &doc) {
 	doc_ = QDomDocument();
 	foreach(SxeRecord* meta, recordByNodeId_.values())
 		meta->deleteLater();
-	// recordByNode_.clear();
+	recordByNode_.clear();
 	recordByNodeId_.clear();
+	childrenByNode_.clear();
+	placementByRecord_.clear();
 	queuedIncomingEdits_.clear();
 	queuedOutgoingEdits_.clear();
 
@@ -99,13 +110,13 @@ void SxeSession::processIncomingSxeElement(const QDomElement &sxe, const QString
 
 bool SxeSession::processSxe(const QDomElement &sxe, const QString &id) {
 	// Don't accept duplicates
-	if(!id.isEmpty() && usedSxeIds_.contains(id)) {
+	if(!id.isEmpty() && usedSxeIdSet_.contains(id)) {
 		qDebug() << QString("Tried to process a duplicate %1 (received: %2).").arg(sxe.attribute("id")).arg(usedSxeIds_.size()).toLatin1();
 		return false;
 	}
 
 	if(!id.isEmpty())
-		usedSxeIds_ += id;
+		addUsedSxeId(id);
 
 	// store incoming edits when queueing
 	if(queueing_) {
@@ -609,27 +620,21 @@ void SxeSession::reposition(const QDomNode &node, bool remote) {
 		return;
 	}
 
-	// get the list of siblings
-	QDomNodeList children = parentNode.childNodes();
+	// find the sibling with the smallest weight greater than the weight of the node itself
+	// if any, insert the node before that node
+	unplace(meta);
+	QMap<SiblingKey, SxeRecord*> &siblings = childrenByNode_[nodeKey(parentNode)];
+	SiblingKey key(meta->primaryWeight(), meta->rid());
 
-	// default to appending
 	QDomNode before;
-	bool insertLast = true;
-	if(children.length() > 0) {
-		// find the child with the smallest weight greater than the weight of the node itself
-		// if any, insert the node before that node
-		for(uint i=0; i < children.length(); i++) {
-			if(children.item(i) != node) {
-				SxeRecord* siblingMeta = record(children.item(i));
-				if(siblingMeta && *meta < *siblingMeta) {
-					// qDebug() << QString("%1 (pw: %2) is less than %3 (pw: %4)").arg(meta->name()).arg(meta->primaryWeight()).arg(siblingMeta->name()).arg(siblingMeta->primaryWeight()).toLatin1();
-					before = children.item(i);
-					insertLast = false;
-					break;
-				}
-			}
-		}
-	}
+	QMap<SiblingKey, SxeRecord*>::ConstIterator next = siblings.upperBound(key);
+	if(next != siblings.constEnd())
+		before = next.value()->node();
+	bool insertLast = before.isNull() || before.parentNode() != parentNode;
+
+	siblings.insert(key, meta);
+	Placement placement = { nodeKey(parentNode), key };
+	placementByRecord_[meta] = placement;
 
 	if(insertLast) {
 		// qDebug() << QString("Repositioning '%1' (pw: %2) as last.").arg(node.nodeName()).arg(meta->primaryWeight()).toLatin1();
@@ -640,12 +645,11 @@ void SxeSession::reposition(const QDomNode &node, bool remote) {
 	}
 }
 
-// void SxeSession::addToLookup(const QDomNode &node, bool, const QString &rid) {
-	// recordByNode_[node]
-	//	 = recordByNodeId_[rid];
-// }
+void SxeSession::handleNodeToBeAdded(const QDomNode &node, bool remote, const QString &rid) {
+	SxeRecord* meta = record(rid);
+	if(meta)
+		recordByNode_[nodeKey(node)] = meta;
 
-void SxeSession::handleNodeToBeAdded(const QDomNode &node, bool remote) {
 	emit nodeToBeAdded(node, remote);
 	reposition(node, remote);
 	emit nodeAdded(node, remote);
@@ -664,14 +668,27 @@ void SxeSession::handleNodeToBeRemoved(const QDomNode &node, bool remote) {
 
 
 void SxeSession::removeRecord(const QDomNode &node) {
-	QMutableHashIterator<QString, SxeRecord*> i(recordByNodeId_);
+	SxeRecord* meta = recordByNode_.take(nodeKey(node));
+	if(!meta)
+		return;
 
-	while(i.hasNext()) {
-		if(node == i.next().value()->node()) {
-			i.remove();
-			return;
-		}
+	unplace(meta);
+	childrenByNode_.remove(nodeKey(node));
+	recordByNodeId_.remove(meta->rid());
+}
+
+void SxeSession::unplace(SxeRecord* meta) {
+	QHash<SxeRecord*, Placement>::Iterator placement = placementByRecord_.find(meta);
+	if(placement == placementByRecord_.end())
+		return;
+
+	QHash<const void*, QMap<SiblingKey, SxeRecord*> >::Iterator siblings = childrenByNode_.find(placement->parent);
+	if(siblings != childrenByNode_.end()) {
+		siblings->remove(placement->key);
+		if(siblings->isEmpty())
+			childrenByNode_.erase(siblings);
 	}
+	placementByRecord_.erase(placement);
 }
 
 bool SxeSession::removeSmaller(SxeRecord* meta1, SxeRecord* meta2) {
@@ -693,6 +710,7 @@ bool SxeSession::removeSmaller(SxeRecord* meta1, SxeRecord* meta2) {
 
 void SxeSession::addUsedSxeId(QString id) {
 	usedSxeIds_ += id;
+	usedSxeIdSet_ += id;
 }
 
 QList<QString> SxeSession::usedSxeIds() {
@@ -715,14 +733,12 @@ SxeRecord* SxeSession::createRecord(const QString &id) {
 	SxeRecord* m = new SxeRecord(id);
 	recordByNodeId_[id] = m;
 
-	// once the node is actually created, add it to the lookup table
-	// connect(m, SIGNAL(nodeAdded(QDomNode, bool, QString)), SLOT(addToLookup(const QDomNode &, bool, const QString &)));
-
 	// remove the node in case of a conflicting edit
 	connect(m, SIGNAL(nodeRemovalRequired(QDomNode)), SLOT(removeNode(QDomNode)));
 
-	// reposition and emit public signals as needed when record is changed
-	connect(m, SIGNAL(nodeToBeAdded(QDomNode, bool, QString)), SLOT(handleNodeToBeAdded(const QDomNode &, bool)));
+	// add the node to the lookup table once it's created, reposition and
+	// emit public signals as needed when record is changed
+	connect(m, SIGNAL(nodeToBeAdded(QDomNode, bool, QString)), SLOT(handleNodeToBeAdded(const QDomNode &, bool, const QString &)));
 	connect(m, SIGNAL(nodeToBeMoved(QDomNode, bool)), SLOT(handleNodeToBeMoved(const QDomNode &, bool)));
 	connect(m, SIGNAL(nodeToBeRemoved(QDomNode, bool)), SLOT(handleNodeToBeRemoved(const QDomNode &, bool)));
 	connect(m, SIGNAL(chdataToBeChanged(QDomNode, bool)), SIGNAL(chdataToBeChanged(const QDomNode &, bool)));
@@ -740,14 +756,7 @@ SxeRecord* SxeSession::record(const QDomNode &node) const {
 	if(node.isNull())
 		return NULL;
 
-	// go through all the SxeRecord's
-	foreach(SxeRecord* meta, recordByNodeId_.values()) {
-		// qDebug() << QString("id: %1").arg(meta->rid()).toLatin1();
-		if(node == meta->node())
-			return meta;
-	}
-
-	return NULL;
+	return recordByNode_.value(nodeKey(node));
 }
 
 void SxeSession::setUUIDPrefix(const QString uuidPrefix) {
@@ -768,6 +777,10 @@ QString SxeSession::generateUUID() {
 	return fullstring.mid(start, fullstring.lastIndexOf("}") - start);
 }
 
+const void* SxeSession::nodeKey(const QDomNode &node) {
+	return SxeNodeKey::of(node);
+}
+
 QString SxeSession::parseProlog(const QDomDocument &doc) {
 	QString prolog;
 	QTextStream stream(&prolog);
@@ -26,6 +26,10 @@
 
 #include <QObject>
 #include <QList>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QSet>
 #include <QPointer>
 #include <QDomNode>
 
@@ -56,6 +60,14 @@ class SxeSession : public QObject {
 			QDomElement xml;
 		};
 
+		/*! \brief Position of a node among its siblings: primary-weight and rid (the secondary weight).*/
+		typedef QPair<double, QString> SiblingKey;
+
+		struct Placement {
+			const void* parent;
+			SiblingKey key;
+		};
+
 	public:
 		/*! \brief Constructor.
 		*  Creates a new session for the specified jid and session identifier.
@@ -113,6 +125,8 @@ class SxeSession : public QObject {
 		static QString generateUUID();
 		/*! \brief Returns the prolog of the document as a string. */
 		static QString parseProlog(const QDomDocument &doc);
+		/*! \brief Returns a key which identifies \a node, for use in hash tables. */
+		static const void* nodeKey(const QDomNode &node);
 
 	public slots:
 		/*! \brief Ends the session.*/
@@ -170,20 +184,20 @@ class SxeSession : public QObject {
 		void sessionEnded(SxeSession*);
 
 	private slots:
-		/*! \brief Adds \a node to the document tree and emits the appropriate public signals. */
-		void handleNodeToBeAdded(const QDomNode &node, bool remote);
+		/*! \brief Adds \a node to the lookup table and the document tree and emits the appropriate public signals. */
+		void handleNodeToBeAdded(const QDomNode &node, bool remote, const QString &rid);
 		/*! \brief Moves \a node in the document tree and emits the appropriate public signals. */
 		void handleNodeToBeMoved(const QDomNode &node, bool remote);
 		/*! \brief Remove the record entry from the lookup tables and emit the appropriate public signals. */
 		void handleNodeToBeRemoved(const QDomNode &node, bool remote);
-		/*! \brief Add a node node to the lookup table. */
-		// void addToLookup(const QDomNode &node, bool, const QString &rid);
 
 	private:
 		/*! \brief Inserts or moves a node according to it's record (parent and primary-weight). */
 		void reposition(const QDomNode &node, bool remote);
 		/*! \brief Remove the record associated with \a node from the lookup tables. */
 		void removeRecord(const QDomNode &node);
+		/*! \brief Remove \a meta from the ordered children of its parent. */
+		void unplace(SxeRecord* meta);
 		/*! \brief Remove the item with smaller secondary weight.
 			Returns true iff \a meta1 was removed. */
 		bool removeSmaller(SxeRecord* meta1, SxeRecord* meta2);
@@ -225,6 +239,12 @@ class SxeSession : public QObject {
 				QString,
 				SxeRecord*
 			 > recordByNodeId_;
+		/*! \brief Hash used for node -> SxeRecord* lookups, keyed by the node's private data.*/
+		QHash<const void*, SxeRecord*> recordByNode_;
+		/*! \brief The records of the children of each node, ordered like the children themselves.*/
+		QHash<const void*, QMap<SiblingKey, SxeRecord*> > childrenByNode_;
+		/*! \brief Where each record is kept in childrenByNode_.*/
+		QHash<SxeRecord*, Placement> placementByRecord_;
 		/*! \brief List of queued incoming sxe elements.*/
 		QList<IncomingEdit> queuedIncomingEdits_;
 		/*! \brief List of queued outgoing sxe elements.*/
@@ -243,6 +263,7 @@ class SxeSession : public QObject {
 		QList<QString> features_;
 		 /*! \brief Identifiers for the <sxe/> elements that have been processed already.*/
 		QList<QString> usedSxeIds_;
+		QSet<QString> usedSxeIdSet_;
 		/*! \brief A unique id is generated as "uuidPrefix.counter".*/
 		QString uuidPrefix_;
 		int uuidMaxPostfix_;
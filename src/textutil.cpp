@@ -221,29 +221,114 @@ QString TextUtil::resolveEntities(const QString &in)
 }
 
 
-static bool linkify_pmatch(const QString &str1, int at, const QString &str2)
+static bool linkify_pmatch(const QString &str1, int at, const char *str2)
 {
-	if(str2.length() > (str1.length()-at))
+	int len = qstrlen(str2);
+	if(len > (str1.length()-at))
 		return false;
 
-	for(int n = 0; n < (int)str2.length(); ++n) {
-		if(str1.at(n+at).toLower() != str2.at(n).toLower())
+	for(int n = 0; n < len; ++n) {
+		if(str1.at(n+at).toLower() != QChar(QLatin1Char(str2[n])).toLower())
 			return false;
 	}
 
 	return true;
 }
 
-static bool linkify_isOneOf(const QChar &c, const QString &charlist)
+static bool linkify_isOneOf(const QChar &c, const char *charlist)
 {
-	for(int i = 0; i < (int)charlist.length(); ++i) {
-		if(c == charlist.at(i))
+	for(; *charlist; ++charlist) {
+		if(c == QLatin1Char(*charlist))
 			return true;
 	}
 
 	return false;
 }
 
+// index of a bracket in the counters of linkify(), with the opening
+// brackets at even and the closing ones at odd indices, or -1
+static int linkify_bracket(const QChar &c)
+{
+	switch(c.unicode()) {
+		case '(': return 0;
+		case ')': return 1;
+		case '[': return 2;
+		case ']': return 3;
+		case '{': return 4;
+		case '}': return 5;
+	}
+	return -1;
+}
+
+enum { Linkify_None, Linkify_Url, Linkify_AtStyle };
+
+// Recognizes the start of a link at 'at' by its first character.  'skip' is
+// set to the length of the scheme, which the link is only accepted after,
+// and 'prefix' to what has to be put in front of the link in the href.
+static int linkify_scheme(const QString &str, int at, int *skip, const char **prefix)
+{
+	*skip = 0;
+	*prefix = "";
+
+	switch(str.at(at).toLower().unicode()) {
+		case 'x':
+			if(linkify_pmatch(str, at, "xmpp:")) {
+				*skip = 5;
+				return Linkify_Url;
+			}
+			break;
+		case 'm':
+			if(linkify_pmatch(str, at, "mailto:") || linkify_pmatch(str, at, "magnet:")) {
+				*skip = 7;
+				return Linkify_Url;
+			}
+			break;
+		case 'h':
+			if(linkify_pmatch(str, at, "http://")) {
+				*skip = 7;
+				return Linkify_Url;
+			}
+			if(linkify_pmatch(str, at, "https://")) {
+				*skip = 8;
+				return Linkify_Url;
+			}
+			break;
+		case 'f':
+			if(linkify_pmatch(str, at, "ftp://")) {
+				*skip = 6;
+				return Linkify_Url;
+			}
+			if(linkify_pmatch(str, at, "ftp.")) {
+				*prefix = "ftp://";
+				return Linkify_Url;
+			}
+			break;
+		case 'n':
+			if(linkify_pmatch(str, at, "news://")) {
+				*skip = 7;
+				return Linkify_Url;
+			}
+			break;
+		case 'e':
+			if(linkify_pmatch(str, at, "ed2k://")) {
+				*skip = 7;
+				return Linkify_Url;
+			}
+			break;
+		case 'w':
+			if(linkify_pmatch(str, at, "www.")) {
+				*prefix = "http://";
+				return Linkify_Url;
+			}
+			break;
+		case '@':
+			*prefix = "x-psi-atstyle:";
+			return Linkify_AtStyle;
+	}
+
+	return Linkify_None;
+}
+
 // encodes a few dangerous html characters
 static QString linkify_htmlsafe(const QString &in)
 {
@@ -290,237 +375,136 @@ static bool linkify_okEmail(const QString &addy)
 	return true;
 }
 
+static bool linkify_isAtStyleChar(const QChar &c)
+{
+	return c.isLetterOrNumber() || linkify_isOneOf(c, "_.-+");
+}
+
 /**
  * takes a richtext string and heuristically adds links for uris of common protocols
  * @return a richtext string with link markup added
  */
 QString TextUtil::linkify(const QString &in)
 {
-	QString out = in;
-	int x1, x2;
-	bool isUrl, isAtStyle;
-	QString linked, link, href;
-
-	for(int n = 0; n < (int)out.length(); ++n) {
-		isUrl = false;
-		isAtStyle = false;
-		x1 = n;
-
-		if(linkify_pmatch(out, n, "xmpp:")) {
-			n += 5;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "mailto:")) {
-			n += 7;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "http://")) {
-			n += 7;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "https://")) {
-			n += 8;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "ftp://")) {
-			n += 6;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "news://")) {
-			n += 7;
-			isUrl = true;
-			href = "";
-		}
-		else if (linkify_pmatch(out, n, "ed2k://")) {
-			n += 7;
-			isUrl = true;
-			href = "";
-		}
-		else if (linkify_pmatch(out, n, "magnet:")) {
-			n += 7;
-			isUrl = true;
-			href = "";
-		}
-		else if(linkify_pmatch(out, n, "www.")) {
-			isUrl = true;
-			href = "http://";
-		}
-		else if(linkify_pmatch(out, n, "ftp.")) {
-			isUrl = true;
-			href = "ftp://";
-		}
-		else if(linkify_pmatch(out, n, "@")) {
-			isAtStyle = true;
-			href = "x-psi-atstyle:";
-		}
+	QString out;
+	out.reserve(in.length() + in.length() / 2);
+	int copied = 0; // everything before this is in out already
 
-		if(isUrl) {
+	for(int n = 0; n < in.length(); ++n) {
+		int x1 = n, x2;
+		int skip;
+		const char *prefix;
+		int type = linkify_scheme(in, n, &skip, &prefix);
+		n += skip;
+
+		if(type == Linkify_Url) {
 			// make sure the previous char is not alphanumeric
-			if(x1 > 0 && out.at(x1-1).isLetterOrNumber())
+			if(x1 > 0 && in.at(x1-1).isLetterOrNumber())
 				continue;
 
 			// find whitespace (or end)
-			QMap<QChar, int> brackets;
-			brackets['('] = brackets[')'] = brackets['['] = brackets[']'] = brackets['{'] = brackets['}'] = 0;
-			QMap<QChar, QChar> openingBracket;
-			openingBracket[')'] = '(';
-			openingBracket[']'] = '[';
-			openingBracket['}'] = '{';
-			for(x2 = n; x2 < (int)out.length(); ++x2) {
-				if(out.at(x2).isSpace() || linkify_isOneOf(out.at(x2), "\"\'`<>")
-					|| linkify_pmatch(out, x2, "&quot;")  || linkify_pmatch(out, x2, "&apos;")
-					|| linkify_pmatch(out, x2, "&gt;") || linkify_pmatch(out, x2, "&lt;") ) {
+			int brackets[6] = { 0, 0, 0, 0, 0, 0 };
+			for(x2 = n; x2 < in.length(); ++x2) {
+				const QChar &c = in.at(x2);
+				if(c.isSpace() || linkify_isOneOf(c, "\"\'`<>"))
+					break;
+				if(c == '&' && (linkify_pmatch(in, x2, "&quot;") || linkify_pmatch(in, x2, "&apos;")
+					|| linkify_pmatch(in, x2, "&gt;") || linkify_pmatch(in, x2, "&lt;"))) {
 					break;
 				}
-				if(brackets.keys().contains(out.at(x2))) {
-					++brackets[out.at(x2)];
-				}
+				int b = linkify_bracket(c);
+				if(b != -1)
+					++brackets[b];
 			}
-			int len = x2-x1;
-			QString pre = resolveEntities(out.mid(x1, x2-x1));
+			QString pre = resolveEntities(in.mid(x1, x2-x1));
 
 			// go backward hacking off unwanted punctuation
 			int cutoff;
 			for(cutoff = pre.length()-1; cutoff >= 0; --cutoff) {
-				if(!linkify_isOneOf(pre.at(cutoff), "!?,.()[]{}<>\""))
+				const QChar &c = pre.at(cutoff);
+				if(!linkify_isOneOf(c, "!?,.()[]{}<>\""))
 					break;
-				if(linkify_isOneOf(pre.at(cutoff), ")]}")
-					&& brackets[pre.at(cutoff)] - brackets[openingBracket[pre.at(cutoff)]] <= 0 ) {
+				int b = linkify_bracket(c);
+				if(b != -1 && (b & 1) && brackets[b] - brackets[b-1] <= 0)
 					break;	// in theory, there could be == above, but these are urls, not math ;)
-				}
-				if(brackets.keys().contains(pre.at(cutoff))) {
-					--brackets[pre.at(cutoff)];
-				}
-
+				if(b != -1)
+					--brackets[b];
 			}
 			++cutoff;
-			//++x2;
 
-			link = pre.mid(0, cutoff);
+			QString link = pre.left(cutoff);
 			if(!linkify_okUrl(link)) {
 				n = x1 + link.length();
 				continue;
 			}
-			href += link;
 			// attributes need to be encoded too.
-			href = escape(href);
-			href = linkify_htmlsafe(href);
-			//printf("link: [%s], href=[%s]\n", link.latin1(), href.latin1());
-			linked = QString("<a href=\"%1\">").arg(href) + escape(link) + "</a>" + escape(pre.mid(cutoff));
-			out.replace(x1, len, linked);
-			n = x1 + linked.length() - 1;
+			QString href = linkify_htmlsafe(escape(QString::fromLatin1(prefix) + link));
+
+			out.append(in.midRef(copied, x1 - copied));
+			out += "<a href=\"";
+			out += href;
+			out += "\">";
+			out += escape(link);
+			out += "</a>";
+			out += escape(pre.mid(cutoff));
+			copied = x2;
+			n = x2 - 1;
 		}
-		else if(isAtStyle) {
-			// go backward till we find the beginning
+		else if(type == Linkify_AtStyle) {
+			// go backward till we find the beginning, which can't be in a
+			// link that has been added already
 			if(x1 == 0)
 				continue;
-			--x1;
-			for(; x1 >= 0; --x1) {
-				if(!linkify_isOneOf(out.at(x1), "_.-+") && !out.at(x1).isLetterOrNumber())
-					break;
-			}
+			for(--x1; x1 >= copied && linkify_isAtStyleChar(in.at(x1)); --x1)
+				;
 			++x1;
 
 			// go forward till we find the end
-			x2 = n + 1;
-			for(; x2 < (int)out.length(); ++x2) {
-				if(!linkify_isOneOf(out.at(x2), "_.-+") && !out.at(x2).isLetterOrNumber())
-					break;
-			}
-
-			int len = x2-x1;
-			link = out.mid(x1, len);
-			//link = resolveEntities(link);
+			for(x2 = n + 1; x2 < in.length() && linkify_isAtStyleChar(in.at(x2)); ++x2)
+				;
 
+			QString link = in.mid(x1, x2-x1);
 			if(!linkify_okEmail(link)) {
 				n = x1 + link.length();
 				continue;
 			}
 
-			href += link;
-			//printf("link: [%s], href=[%s]\n", link.latin1(), href.latin1());
-			linked = QString("<a href=\"%1\">").arg(href) + link + "</a>";
-			out.replace(x1, len, linked);
-			n = x1 + linked.length() - 1;
+			out.append(in.midRef(copied, x1 - copied));
+			out += "<a href=\"";
+			out += prefix;
+			out += link;
+			out += "\">";
+			out += link;
+			out += "</a>";
+			copied = x2;
+			n = x2 - 1;
 		}
 	}
 
+	out.append(in.midRef(copied));
 	return out;
 }
 
-// sickening
 QString TextUtil::emoticonify(const QString &in)
 {
+	PsiIconset *iconset = PsiIconset::instance();
+
 	RTParse p(in);
 	while ( !p.atEnd() ) {
 		// returns us the first chunk as a plaintext string
 		QString str = p.next();
 
 		int i = 0;
-		while ( i >= 0 ) {
-			// find closest emoticon
-			int ePos = -1;
-			PsiIcon *closest = 0;
-
-			int foundPos = -1, foundLen = -1;
-
-			foreach(const Iconset* iconset, PsiIconset::instance()->emoticons) {
-				QListIterator<PsiIcon*> it = iconset->iterator();
-				while ( it.hasNext()) {
-					PsiIcon *icon = it.next();
-					if ( icon->regExp().isEmpty() )
-						continue;
-
-					// some hackery
-					int iii = i;
-					bool searchAgain;
-
-					do {
-						searchAgain = false;
-
-						// find the closest match
-						const QRegExp &rx = icon->regExp();
-						int n = rx.indexIn(str, iii);
-						if ( n == -1 )
-							continue;
-
-						if(ePos == -1 || n < ePos || (rx.matchedLength() > foundLen && n < ePos + foundLen)) {
-							bool leftSpace  = n == 0 || (n > 0 && str[n-1].isSpace());
-							bool rightSpace = (n+rx.matchedLength() == (int)str.length()) || (n+rx.matchedLength() < (int)str.length() && str[n+rx.matchedLength()].isSpace());
-							// there must be whitespace at least on one side of the emoticon
-							if (leftSpace || rightSpace) {
-								ePos = n;
-								closest = icon;
-
-								foundPos = n;
-								foundLen = rx.matchedLength();
-								break;
-							}
-
-							searchAgain = true;
-						}
-
-						iii = n + rx.matchedLength();
-					} while ( searchAgain );
-				}
-			}
-
-			QString s;
-			if(ePos == -1)
-				s = str.mid(i);
-			else
-				s = str.mid(i, ePos-i);
-			p.putPlain(s);
-
-			if ( !closest )
+		while ( 1 ) {
+			int foundPos, foundLen;
+			PsiIcon *icon = iconset->findEmoticon(str, i, &foundPos, &foundLen);
+			if ( !icon ) {
+				p.putPlain(str.mid(i));
 				break;
+			}
 
-			p.putRich( QString("<icon name=\"%1\" text=\"%2\">").arg(TextUtil::escape(closest->name())).arg(TextUtil::escape(str.mid(foundPos, foundLen))) );
+			p.putPlain(str.mid(i, foundPos-i));
+			p.putRich( QString("<icon name=\"%1\" text=\"%2\">").arg(TextUtil::escape(icon->name())).arg(TextUtil::escape(str.mid(foundPos, foundLen))) );
 			i = foundPos + foundLen;
 		}
 	}
@@ -28,6 +28,8 @@
 #include <QBuffer>
 #include <QImage>
 #include <QThread>
+#include <QHash>
+#include <QElapsedTimer>
 
 /**
  * \class Anim
@@ -41,15 +43,52 @@
 
 static QThread *animMainThread = 0;
 
+// frames are never advanced more often than this (in ms)
+#define ANIM_MIN_INTERVAL 40
+
 //! \if _hide_doc_
-class Anim::Private : public QObject, public QSharedData
+/**
+ * Drives all running animations which are shown somewhere from a single
+ * timer.  Frames which are due at about the same time are advanced on the
+ * same tick, so widgets showing several animations get a single repaint
+ * for all of them.
+ */
+class AnimClock : public QObject
 {
 	Q_OBJECT
 public:
-	QTimer *frametimer;
+	static AnimClock *instance();
+
+	void schedule(Anim::Private *anim, int interval);
+	void unschedule(Anim::Private *anim);
+	bool isScheduled(const Anim::Private *anim) const;
+
+private slots:
+	void tick();
+
+private:
+	AnimClock();
+	void startTimer();
+
+	struct Entry {
+		qint64 due;
+		int interval;
+	};
 
+	QTimer timer_;
+	QElapsedTimer elapsed_;
+	qint64 lastTick_;
+	bool ticking_;
+	QHash<Anim::Private *, Entry> anims_;
+};
+
+class Anim::Private : public QObject, public QSharedData
+{
+	Q_OBJECT
+public:
 	bool empty;
 	bool paused;
+	int views; // visible ones, off the clock while there are none
 
 	int speed;
 	int lasttimerinterval;
@@ -68,12 +107,9 @@ public:
 public:
 	void init()
 	{
-		frametimer = new QTimer();
 		if (animMainThread && animMainThread != QThread::currentThread()) {
-			frametimer->moveToThread(animMainThread);
 			moveToThread(animMainThread);
 		}
-		QObject::connect(frametimer, SIGNAL(timeout()), this, SLOT(refresh()));
 
 		speed = 120;
 		lasttimerinterval = -1;
@@ -82,6 +118,7 @@ public:
 		loop = 0;
 		frame = 0;
 		paused = true;
+		views = 0;
 	}
 
 	Private()
@@ -153,14 +190,13 @@ public:
 
 	~Private()
 	{
-		if ( frametimer )
-			delete frametimer;
+		AnimClock::instance()->unschedule(this);
 	}
 
 	void pause()
 	{
 		paused = true;
-		frametimer->stop();
+		AnimClock::instance()->unschedule(this);
 	}
 
 	void unpause()
@@ -181,17 +217,30 @@ public:
 		return frames.count();
 	}
 
+	void addView()
+	{
+		if ( views++ == 0 )
+			restartTimer();
+	}
+
+	void removeView()
+	{
+		if ( views > 0 && --views == 0 )
+			AnimClock::instance()->unschedule(this);
+	}
+
 	void restartTimer()
 	{
-		if ( !paused && speed > 0 ) {
+		if ( !paused && speed > 0 && views > 0 ) {
 			int frameperiod = frames[frame].period;
 			int i = frameperiod >= 0 ? frameperiod * 100/speed : 0;
-			if ( i != lasttimerinterval || !frametimer->isActive() ) {
+			AnimClock *clock = AnimClock::instance();
+			if ( i != lasttimerinterval || !clock->isScheduled(this) ) {
 				lasttimerinterval = i;
-				frametimer->start( i );
+				clock->schedule(this, i);
 			}
 		} else {
-			frametimer->stop();
+			AnimClock::instance()->unschedule(this);
 		}
 	}
 
@@ -217,6 +266,93 @@ public slots:
 		restartTimer();
 	}
 };
+
+AnimClock::AnimClock()
+	: lastTick_(0)
+	, ticking_(false)
+{
+	timer_.setSingleShot(true);
+	connect(&timer_, SIGNAL(timeout()), SLOT(tick()));
+	elapsed_.start();
+}
+
+AnimClock *AnimClock::instance()
+{
+	static AnimClock *clock = 0;
+	if ( !clock ) {
+		clock = new AnimClock();
+		if (animMainThread && animMainThread != QThread::currentThread()) {
+			clock->moveToThread(animMainThread);
+		}
+	}
+	return clock;
+}
+
+void AnimClock::schedule(Anim::Private *anim, int interval)
+{
+	Entry e = { elapsed_.elapsed() + interval, interval };
+	anims_.insert(anim, e);
+	if ( !ticking_ ) {
+		startTimer();
+	}
+}
+
+void AnimClock::unschedule(Anim::Private *anim)
+{
+	if ( anims_.remove(anim) && anims_.isEmpty() ) {
+		timer_.stop();
+	}
+}
+
+bool AnimClock::isScheduled(const Anim::Private *anim) const
+{
+	return anims_.contains(const_cast<Anim::Private *>(anim));
+}
+
+void AnimClock::startTimer()
+{
+	if ( anims_.isEmpty() ) {
+		timer_.stop();
+		return;
+	}
+
+	qint64 next = -1;
+	foreach(const Entry &e, anims_) {
+		if ( next < 0 || e.due < next ) {
+			next = e.due;
+		}
+	}
+	next = qMax(next, lastTick_ + ANIM_MIN_INTERVAL);
+	timer_.start(int(qMax(next - elapsed_.elapsed(), qint64(0))));
+}
+
+void AnimClock::tick()
+{
+	qint64 now = elapsed_.elapsed();
+	lastTick_ = now;
+
+	// frames which would be due before the next tick are advanced now,
+	// this keeps animations with similar frame periods in phase
+	QList<Anim::Private *> due;
+	QHash<Anim::Private *, Entry>::Iterator it = anims_.begin();
+	for ( ; it != anims_.end(); ++it) {
+		if ( it.value().due < now + ANIM_MIN_INTERVAL / 2 ) {
+			it.value().due = now + it.value().interval;
+			due += it.key();
+		}
+	}
+
+	ticking_ = true;
+	foreach(Anim::Private *anim, due) {
+		// receivers of previous updates could have stopped or deleted it
+		if ( anims_.contains(anim) ) {
+			anim->refresh();
+		}
+	}
+	ticking_ = false;
+
+	startTimer();
+}
 //! \endif
 
 /**
@@ -341,6 +477,26 @@ void Anim::restart()
 		d->restart();
 }
 
+/**
+ * Tells the animation that one more view shows it.  Frames only advance
+ * while it's unpaused and at least one view is visible, every call must
+ * be matched by removeView() once the view is hidden or goes away.
+ * Shared copies count their views together.
+ */
+void Anim::addView()
+{
+	d->addView();
+}
+
+/**
+ * Tells the animation that a view which showed it is hidden now.
+ * \sa addView()
+ */
+void Anim::removeView()
+{
+	d->removeView();
+}
+
 /**
  * Connects internal signal with specified slot \a member of object \a receiver, which
  * is emitted when animation changes its frame.
@@ -53,6 +53,9 @@ public:
 
 	void restart();
 
+	void addView();
+	void removeView();
+
 	void stripFirstFrame();
 
 	static QThread *mainThread();
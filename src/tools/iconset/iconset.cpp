@@ -32,6 +32,9 @@
 #include <QCoreApplication>
 #include <QLocale>
 #include <QBuffer>
+#include <QImageReader>
+#include <QSet>
+#include <QtConcurrentMap>
 
 #include <QTextCodec>
 
@@ -250,6 +253,7 @@ public:
 		anim = 0;
 		icon = 0;
 		activatedCount = 0;
+		dataIsAnim = false;
 	}
 
 	~Private()
@@ -274,17 +278,90 @@ public:
 		rawData = from.rawData;
 		anim = from.anim ? new Anim ( *from.anim ) : 0;
 		icon = 0;
-		activatedCount = from.activatedCount;
+		activatedCount = 0; // the copy isn't shown anywhere yet
+		data = from.data;
+		dataIsAnim = from.dataIsAnim;
 	}
 
 	void unloadAnim()
 	{
 		if ( anim ) {
+			detachViews();
 			delete anim;
 		}
 		anim = 0;
 	}
 
+	// each activation is a view of the animation, these hand them over
+	// when the animation is replaced
+	void attachViews()
+	{
+		if ( anim && activatedCount > 0 ) {
+			anim->unpause();
+			for ( int n = 0; n < activatedCount; ++n ) {
+				anim->addView();
+			}
+			anim->connectUpdate(this, SLOT(animUpdate()));
+		}
+	}
+
+	void detachViews()
+	{
+		if ( anim && activatedCount > 0 ) {
+			anim->disconnectUpdate(this, SLOT(animUpdate()));
+			for ( int n = 0; n < activatedCount; ++n ) {
+				anim->removeView();
+			}
+		}
+	}
+
+	// decodes the data passed to PsiIcon::loadFromData() on first use
+	void decode() const
+	{
+		if ( data.isNull() ) {
+			return;
+		}
+
+		Anim *a = 0;
+		QImage image;
+		decodeData(data, dataIsAnim, &a, &image);
+		const_cast<Private *>(this)->setDecoded(a, image);
+	}
+
+	// could be called from any thread, setDecoded() should be called
+	// with the results in the thread of the icon
+	static void decodeData(const QByteArray &ba, bool isAnim, Anim **a, QImage *image)
+	{
+		if ( isAnim ) {
+			*a = new Anim(ba);
+			if ( (*a)->numFrames() > 0 ) {
+				return;
+			}
+		}
+
+		image->loadFromData(ba);
+	}
+
+	void setDecoded(Anim *a, const QImage &image)
+	{
+		data = QByteArray();
+
+		unloadAnim();
+		if ( a && a->numFrames() > 0 ) {
+			impix = a->frame(0);
+			if ( a->numFrames() > 1 ) {
+				anim = a;
+				a = 0;
+			}
+		}
+		else {
+			impix = image;
+		}
+		delete a;
+
+		attachViews();
+	}
+
 	void connectInstance(PsiIcon *icon)
 	{
 		connect(this, SIGNAL(pixmapChanged()), icon, SIGNAL(pixmapChanged()));
@@ -304,6 +381,7 @@ signals:
 public:
 	const QPixmap &pixmap() const
 	{
+		decode();
 		if ( anim ) {
 			return anim->framePixmap();
 		}
@@ -324,6 +402,9 @@ public:
 	QIcon *icon;
 	mutable QByteArray rawData;
 
+	QByteArray data; // not yet decoded image data
+	bool dataIsAnim;
+
 	int activatedCount;
 	friend class PsiIcon;
 };
@@ -393,6 +474,7 @@ void PsiIcon::detach()
  */
 bool PsiIcon::isAnimated() const
 {
+	d->decode();
 	return d->anim != 0;
 }
 
@@ -409,6 +491,7 @@ const QPixmap &PsiIcon::pixmap() const
  */
 const QImage &PsiIcon::image() const
 {
+	d->decode();
 	if ( d->anim ) {
 		return d->anim->frameImage();
 	}
@@ -421,6 +504,7 @@ const QImage &PsiIcon::image() const
  */
 const Impix &PsiIcon::impix() const
 {
+	d->decode();
 	return d->impix;
 }
 
@@ -430,6 +514,7 @@ const Impix &PsiIcon::impix() const
  */
 const Impix &PsiIcon::frameImpix() const
 {
+	d->decode();
 	if ( d->anim ) {
 		return d->anim->frameImpix();
 	}
@@ -446,6 +531,7 @@ const QIcon &PsiIcon::icon() const
 		return *d->icon;
 	}
 
+	d->decode();
 	const_cast<Private*>(d.data())->icon = new QIcon( d->impix.pixmap() );
 	return *d->icon;
 }
@@ -478,6 +564,12 @@ void PsiIcon::setImpix(const Impix &impix, bool doDetach)
 		detach();
 	}
 
+	// the animation is kept, so it has to be decoded before
+	if ( d->dataIsAnim ) {
+		d->decode();
+	}
+	d->data = QByteArray();
+
 	d->impix = impix;
 	if ( d->icon ) {
 		delete d->icon;
@@ -493,6 +585,7 @@ void PsiIcon::setImpix(const Impix &impix, bool doDetach)
  */
 const Anim *PsiIcon::anim() const
 {
+	d->decode();
 	return d->anim;
 }
 
@@ -507,6 +600,7 @@ void PsiIcon::setAnim(const Anim &anim, bool doDetach)
 		detach();
 	}
 
+	d->data = QByteArray();
 	d->unloadAnim();
 	d->anim = new Anim(anim);
 
@@ -519,10 +613,7 @@ void PsiIcon::setAnim(const Anim &anim, bool doDetach)
 		d->anim = 0;
 	}
 
-	if ( d->anim && d->activatedCount > 0 ) {
-		d->activatedCount = 0;
-		activated(false); // restart the animation, but don't play the sound
-	}
+	d->attachViews();
 
 	emit d->pixmapChanged();
 	emit d->iconModified();
@@ -538,15 +629,12 @@ void PsiIcon::removeAnim(bool doDetach)
 		detach();
 	}
 
+	d->decode();
 	if ( !d->anim ) {
 		return;
 	}
 
-	d->activatedCount = 0;
-	stop();
-
-	delete d->anim;
-	d->anim = 0;
+	d->unloadAnim();
 
 	emit d->pixmapChanged();
 	//emit d->iconModified();
@@ -558,6 +646,7 @@ void PsiIcon::removeAnim(bool doDetach)
  */
 int PsiIcon::frameNumber() const
 {
+	d->decode();
 	if ( d->anim ) {
 		return d->anim->frameNumber();
 	}
@@ -700,27 +789,34 @@ bool PsiIcon::blockSignals(bool b)
 /**
  * Initializes PsiIcon's Impix (or Anim, if \a isAnim equals \c true).
  * Iconset::load uses this function.
+ *
+ * Only the format of the data is checked here, the data is decoded
+ * when the icon is used for the first time (or by Iconset::decode()).
  */
 bool PsiIcon::loadFromData(const QByteArray &ba, bool isAnim)
 {
 	detach();
-#ifdef WEBKIT
-	if (isAnim) {
-		d->rawData = ba;
-	}
-#endif
-	bool ret = false;
-	if ( isAnim ) {
-		Anim *anim = new Anim(ba);
-		setAnim(*anim);
-		ret = anim->numFrames() > 0;
-		delete anim; // shared data rules ;)
-	}
 
-	if ( !ret && d->impix.loadFromData(ba) )
-		ret = true;
+	QBuffer buffer;
+	buffer.setData(ba);
+	buffer.open(QIODevice::ReadOnly);
+	bool ret = QImageReader(&buffer).canRead();
 
 	if ( ret ) {
+#ifdef WEBKIT
+		if (isAnim) {
+			d->rawData = ba;
+		}
+#endif
+		d->unloadAnim();
+		d->impix.unload();
+		if ( d->icon ) {
+			delete d->icon;
+			d->icon = 0;
+		}
+		d->data = ba;
+		d->dataIsAnim = isAnim;
+
 		emit d->pixmapChanged();
 		emit d->iconModified();
 	}
@@ -740,6 +836,7 @@ bool PsiIcon::loadFromData(const QByteArray &ba, bool isAnim)
  */
 void PsiIcon::activated(bool playSound)
 {
+	d->decode();
 	d->activatedCount++;
 
 #ifdef ICONSET_SOUND
@@ -757,6 +854,7 @@ void PsiIcon::activated(bool playSound)
 
 	if ( d->anim ) {
 		d->anim->unpause();
+		d->anim->addView();
 
 		d->anim->disconnectUpdate (d, SLOT(animUpdate())); // ensure, that we're connected to signal exactly one time
 		d->anim->connectUpdate (d, SLOT(animUpdate()));
@@ -772,14 +870,15 @@ void PsiIcon::activated(bool playSound)
  */
 void PsiIcon::stop()
 {
-	d->activatedCount--;
-
 	if ( d->activatedCount <= 0 ) {
-		d->activatedCount = 0;
-		if ( d->anim ) {
-			d->anim->pause();
-			d->anim->restart();
-		}
+		return;
+	}
+
+	// copies of the icon share the animation, it stops once none of
+	// them is shown anymore
+	d->activatedCount--;
+	if ( d->anim ) {
+		d->anim->removeView();
 	}
 }
 
@@ -791,8 +890,13 @@ void PsiIcon::stripFirstAnimFrame()
 {
 	detach();
 
+	d->decode();
 	if ( d->anim ) {
+		// the frames are detached from the other copies, and so are
+		// the views
+		d->detachViews();
 		d->anim->stripFirstFrame();
+		d->attachViews();
 	}
 }
 
@@ -1029,6 +1133,9 @@ private:
 		//creation = "1900-01-01";
 		homeUrl = QString::null;
 		iconSize_ = 16;
+#ifdef ICONSET_ZIP
+		zip = 0;
+#endif
 	}
 
 public:
@@ -1038,6 +1145,9 @@ public:
 	QList<PsiIcon *> list;          // sorted list
 	QHash<QString, QString> info;
 	int iconSize_;
+#ifdef ICONSET_ZIP
+	UnZip *zip; // archive being read by Iconset::load()
+#endif
 
 public:
 	Private()
@@ -1111,15 +1221,23 @@ public:
 		}
 #ifdef ICONSET_ZIP
 		else { // else its zip or jisp file
-			UnZip z(dir);
-			if ( !z.open() ) {
-				return ba;
+			// the archive is opened only once for all files of the iconset
+			UnZip *z = zip;
+			if ( !z ) {
+				z = openZip(dir);
+				if ( !z ) {
+					return ba;
+				}
 			}
 
 			QString n = fi.completeBaseName() + '/' + fileName;
-			if ( !z.readFile(n, &ba) ) {
+			if ( !z->readFile(n, &ba) ) {
 				n = "/" + fileName;
-				z.readFile(n, &ba);
+				z->readFile(n, &ba);
+			}
+
+			if ( z != zip ) {
+				delete z;
 			}
 		}
 #endif
@@ -1127,6 +1245,18 @@ public:
 		return ba;
 	}
 
+#ifdef ICONSET_ZIP
+	static UnZip *openZip(const QString &dir)
+	{
+		UnZip *z = new UnZip(dir);
+		if ( !z->open() ) {
+			delete z;
+			return 0;
+		}
+		return z;
+	}
+#endif
+
 	void loadMeta(const QDomElement &i, const QString &dir)
 	{
 		Q_UNUSED(dir);
@@ -1532,6 +1662,13 @@ bool Iconset::load(const QString &dir)
 	bool ret = false;
 	d->id = dir.section('/', -2);
 
+#ifdef ICONSET_ZIP
+	QFileInfo fi(dir);
+	if ( !fi.isDir() && Iconset::isSourceAllowed(fi) ) {
+		d->zip = Private::openZip(dir);
+	}
+#endif
+
 	QByteArray ba;
 	ba = d->loadData ("icondef.xml", dir);
 	if ( !ba.isEmpty() ) {
@@ -1550,11 +1687,59 @@ bool Iconset::load(const QString &dir)
 		qWarning("Iconset::load(\"%s\"): Failed to load icondef.xml", qPrintable(dir));
 	}
 
+#ifdef ICONSET_ZIP
+	delete d->zip;
+	d->zip = 0;
+#endif
+
 	//QPixmap::setDefaultOptimization( optimization );
 
 	return ret;
 }
 
+//! \if _hide_doc_
+struct IconDecodeJob
+{
+	const PsiIcon::Private *icon;
+	QByteArray data;
+	bool isAnim;
+	Anim *anim;
+	QImage image;
+};
+
+static void decodeIconJob(IconDecodeJob &job)
+{
+	PsiIcon::Private::decodeData(job.data, job.isAnim, &job.anim, &job.image);
+}
+//! \endif
+
+/**
+ * Decodes all icons which weren't used yet, in parallel on the global
+ * QThreadPool.  Icons are decoded on first use anyway, so this is only
+ * worth it for iconsets which are going to be shown right away.
+ */
+void Iconset::decode() const
+{
+	QList<IconDecodeJob> jobs;
+	QSet<const PsiIcon::Private *> queued;
+	foreach(const PsiIcon *icon, d->list) {
+		const PsiIcon::Private *p = icon->d.constData();
+		if ( p->data.isNull() || queued.contains(p) ) {
+			continue;
+		}
+		queued += p;
+
+		IconDecodeJob job = { p, p->data, p->dataIsAnim, 0, QImage() };
+		jobs += job;
+	}
+
+	QtConcurrent::blockingMap(jobs, decodeIconJob);
+
+	foreach(const IconDecodeJob &job, jobs) {
+		const_cast<PsiIcon::Private *>(job.icon)->setDecoded(job.anim, job.image);
+	}
+}
+
 /**
  * Returns pointer to PsiIcon, if PsiIcon with name \a name was found in Iconset, or \a 0 otherwise.
  * \sa setIcon()
@@ -179,6 +179,7 @@ public:
 	class Private;
 private:
 	QSharedDataPointer<Private> d;
+	friend class Iconset;
 };
 
 class Iconset
@@ -195,6 +196,7 @@ public:
 	int count() const;
 
 	bool load(const QString &dir);
+	void decode() const;
 
 	const PsiIcon *icon(const QString &) const;
 	void setIcon(const QString &, const PsiIcon &);
@@ -1,6 +1,8 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH  += $$PWD
 
+greaterThan(QT_MAJOR_VERSION, 4):QT += concurrent
+
 SOURCES += \
 	$$PWD/iconset.cpp \
 	$$PWD/anim.cpp
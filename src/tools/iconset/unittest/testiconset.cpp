@@ -173,6 +173,30 @@ private slots:
 		delete is;
 	}
 
+	void testDecode()
+	{
+		// icons decoded on the thread pool must look exactly like
+		// the ones decoded on first use
+		Iconset *lazy = new Iconset();
+		QVERIFY(lazy->load("iconsets/emoticons/puz.jisp"));
+		Iconset *decoded = new Iconset();
+		QVERIFY(decoded->load("iconsets/emoticons/puz.jisp"));
+		decoded->decode();
+
+		QListIterator<PsiIcon*> it = lazy->iterator();
+		QListIterator<PsiIcon*> it2 = decoded->iterator();
+		while (it.hasNext()) {
+			const PsiIcon *icon = it.next();
+			const PsiIcon *icon2 = it2.next();
+			QCOMPARE(icon->isAnimated(), icon2->isAnimated());
+			QVERIFY(!icon->image().isNull());
+			QCOMPARE(icon->image(), icon2->image());
+		}
+
+		delete lazy;
+		delete decoded;
+	}
+
 	void testMultipleIconTextStrings()
 	{
 		// all puz iconset icons contain multiple
@@ -28,11 +28,72 @@
 #include "optionstreereader.h"
 #include "optionstreewriter.h"
 
+/**
+ * \brief Slot of option \a name, owned by \a parent.
+ * The value is filled in by OptionsTree.
+ */
+OptionSlot::OptionSlot(const QString &name, QObject *parent)
+	: QObject(parent)
+	, name_(name)
+	, exists_(false)
+{
+}
+
+/**
+ * Full path of the option
+ */
+const QString &OptionSlot::name() const
+{
+	return name_;
+}
+
+/**
+ * Returns true if the option is currently set
+ */
+bool OptionSlot::exists() const
+{
+	return exists_;
+}
+
+/**
+ * Current value of the option, VariantTree::missingValue if it isn't set
+ */
+const QVariant &OptionSlot::value() const
+{
+	return value_;
+}
+
+
+OptionKey::OptionKey(const char *name)
+	: name_(QString::fromLatin1(name))
+	, tree_(0)
+	, slot_(0)
+{
+}
+
+OptionKey::OptionKey(const QString &name)
+	: name_(name)
+	, tree_(0)
+	, slot_(0)
+{
+}
+
+const QString &OptionKey::name() const
+{
+	return name_;
+}
+
+
+// tells trees apart for OptionKey, even when one is allocated where an
+// older one used to be
+static int lastTreeSerial = 0;
+
 /**
  * Default constructor
  */
 OptionsTree::OptionsTree(QObject *parent)
 	: QObject(parent)
+	, serial_(++lastTreeSerial)
 {
 
 }
@@ -52,14 +113,58 @@ OptionsTree::~OptionsTree()
  */
 QVariant OptionsTree::getOption(const QString& name, const QVariant &defaultValue) const
 {
-	QVariant value=tree_.getValue(name);
-	if (value==VariantTree::missingValue) {
-		value = defaultValue;
-		if (!value.isValid()) {
-			qWarning("Accessing missing option %s", qPrintable(name));
-		}
+	const OptionSlot *slot = slots_.value(name);
+	return valueOrDefault(name, slot ? slot->value_ : tree_.getValue(name), defaultValue);
+}
+
+/**
+ * \overload
+ * Only the first lookup of \a key in this tree resolves its path.
+ */
+QVariant OptionsTree::getOption(const OptionKey &key, const QVariant &defaultValue) const
+{
+	const OptionSlot *slot = optionSlot(key);
+	return valueOrDefault(slot->name_, slot->value_, defaultValue);
+}
+
+QVariant OptionsTree::valueOrDefault(const QString &name, const QVariant &value, const QVariant &defaultValue) const
+{
+	if (value != VariantTree::missingValue) {
+		return value;
+	}
+	if (!defaultValue.isValid()) {
+		qWarning("Accessing missing option %s", qPrintable(name));
 	}
-	return value;
+	return defaultValue;
+}
+
+/**
+ * \brief Returns the slot which caches the option \a name.
+ * The slot is created on the first lookup of \a name, whether the option
+ * exists or not.
+ */
+OptionSlot *OptionsTree::optionSlot(const QString &name) const
+{
+	OptionSlot *slot = slots_.value(name);
+	if (!slot) {
+		slot = new OptionSlot(name, const_cast<OptionsTree*>(this));
+		slot->value_ = tree_.getValue(name);
+		slot->exists_ = slot->value_ != VariantTree::missingValue;
+		slots_.insert(name, slot);
+	}
+	return slot;
+}
+
+/**
+ * \overload
+ */
+OptionSlot *OptionsTree::optionSlot(const OptionKey &key) const
+{
+	if (key.tree_ != serial_) {
+		key.slot_ = optionSlot(key.name_);
+		key.tree_ = serial_;
+	}
+	return key.slot_;
 }
 
 /**
@@ -74,18 +179,66 @@ QVariant OptionsTree::getOption(const QString& name, const QVariant &defaultValu
  */
 void OptionsTree::setOption(const QString& name, const QVariant& value)
 {
-	const QVariant &prev = tree_.getValue(name);
+	setValue(name, slots_.value(name), value);
+}
+
+/**
+ * \overload
+ */
+void OptionsTree::setOption(const OptionKey &key, const QVariant& value)
+{
+	OptionSlot *slot = optionSlot(key);
+	setValue(slot->name_, slot, value);
+}
+
+/**
+ * Sets option \a name and updates its \a slot, if the option has one.
+ */
+void OptionsTree::setValue(const QString &name, OptionSlot *slot, const QVariant &value)
+{
+	QVariant prev = slot ? slot->value_ : tree_.getValue(name);
 	if ( prev == value ) {
 		return;
 	}
-	if (!prev.isValid()) {
+	bool inserted = !prev.isValid();
+	if (inserted) {
 		emit optionAboutToBeInserted(name);
 	}
 	tree_.setValue(name, value);
-	if (!prev.isValid()) {
+	if (slot) {
+		// the tree refuses values in place of subtrees
+		slot->value_ = tree_.getValue(name);
+		slot->exists_ = slot->value_ != VariantTree::missingValue;
+	}
+	if (inserted) {
 		emit optionInserted(name);
 	}
 	emit optionChanged(name);
+	if (slot) {
+		emit slot->changed();
+	}
+}
+
+/**
+ * Rereads the slots of option \a name and all options below it from the
+ * tree, or all slots if \a name is empty.
+ */
+void OptionsTree::updateSlots(const QString &name)
+{
+	QString prefix = name + '.';
+	foreach (OptionSlot *slot, slots_) {
+		if (!name.isEmpty() && slot->name_ != name && !slot->name_.startsWith(prefix)) {
+			continue;
+		}
+		QVariant value = tree_.getValue(slot->name_);
+		bool exists = value != VariantTree::missingValue;
+		if (exists == slot->exists_ && value == slot->value_) {
+			continue;
+		}
+		slot->value_ = value;
+		slot->exists_ = exists;
+		emit slot->changed();
+	}
 }
 
 
@@ -120,6 +273,7 @@ bool OptionsTree::removeOption(const QString &name, bool internal_nodes)
 {
 	emit optionAboutToBeRemoved(name);
 	bool ok = tree_.remove(name, internal_nodes);
+	updateSlots(name);
 	emit optionRemoved(name);
 	return ok;
 }
@@ -287,7 +441,9 @@ bool OptionsTree::loadOptions(const QString& fileName, const QString& configName
 	AtomicXmlFile f(fileName);
 	if (streamReader) {
 		OptionsTreeReader reader(this);
-		return f.loadDocument(&reader);
+		bool ok = f.loadDocument(&reader);
+		updateSlots();
+		return ok;
 	}
 
 	QDomDocument doc;
@@ -329,5 +485,6 @@ bool OptionsTree::loadOptions(const QDomElement& base, const QString& configName
 
 	// Convert
 	tree_.fromXml(base);
+	updateSlots();
 	return true;
 }
@@ -23,6 +23,65 @@
 
 #include "varianttree.h"
 
+class OptionsTree;
+
+/**
+ * \class OptionSlot
+ * \brief Cached value of one option
+ * OptionsTree keeps a slot for every option path that was asked for with
+ * optionSlot() or an OptionKey, so that reading the option again doesn't
+ * walk the tree.  Reading or setting an option by its path uses the slot if
+ * there is one, but doesn't create it.  Slots belong to their tree and stay
+ * valid as long as it exists, also when the option is removed.
+ * changed() is emitted along with OptionsTree::optionChanged() for this
+ * option only.
+ */
+class OptionSlot : public QObject
+{
+	Q_OBJECT
+public:
+	const QString &name() const;
+	bool exists() const;
+	const QVariant &value() const;
+
+signals:
+	void changed();
+
+private:
+	OptionSlot(const QString &name, QObject *parent);
+
+	QString name_;
+	QVariant value_;
+	bool exists_;
+	friend class OptionsTree;
+};
+
+/**
+ * \class OptionKey
+ * \brief Option path which is resolved only once
+ * The first lookup binds the key to the OptionSlot of the option in that
+ * tree, and getOption() doesn't touch the path after that.  Keys are meant
+ * to be kept around, usually as statics:
+ * \code
+ * static const OptionKey showAvatars("options.ui.contactlist.avatars.show");
+ * bool show = PsiOptions::instance()->getOption(showAvatars).toBool();
+ * \endcode
+ */
+class OptionKey
+{
+public:
+	explicit OptionKey(const char *name);
+	explicit OptionKey(const QString &name);
+
+	const QString &name() const;
+
+private:
+	QString name_;
+	mutable int tree_; // serial number of the tree slot_ belongs to
+	mutable OptionSlot *slot_;
+	friend class OptionsTree;
+};
+
 /**
  * \class OptionsTree
  * \brief Dynamic hierachical options structure
@@ -37,7 +96,11 @@ public:
 	~OptionsTree();
 
 	QVariant getOption(const QString& name, const QVariant &defaultValue = QVariant::Invalid) const;
+	QVariant getOption(const OptionKey &key, const QVariant &defaultValue = QVariant::Invalid) const;
 	void setOption(const QString& name, const QVariant& value);
+	void setOption(const OptionKey &key, const QVariant& value);
+	OptionSlot *optionSlot(const QString &name) const;
+	OptionSlot *optionSlot(const OptionKey &key) const;
 	bool isInternalNode(const QString &node) const;
 	void setComment(const QString& name, const QString& comment);
 	QString getComment(const QString& name) const;
@@ -70,7 +133,13 @@ signals:
 	void optionRemoved(const QString& option);
 
 private:
+	QVariant valueOrDefault(const QString &name, const QVariant &value, const QVariant &defaultValue) const;
+	void setValue(const QString &name, OptionSlot *slot, const QVariant &value);
+	void updateSlots(const QString &name = QString());
+
 	VariantTree tree_;
+	int serial_;
+	mutable QHash<QString, OptionSlot*> slots_;
 	friend class OptionsTreeReader;
 	friend class OptionsTreeWriter;
 };
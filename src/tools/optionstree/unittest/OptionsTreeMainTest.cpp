@@ -5,6 +5,8 @@
 #include <QMapIterator>
 #include <QDebug>
 #include <QTime>
+#include <QDomDocument>
+#include <QSignalSpy>
 
 #include "qttestutil/qttestutil.h"
 
@@ -104,6 +106,94 @@ private slots:
 		verifyTree(&tree2);
 	}
 
+	void optionKeyTest() {
+		OptionsTree tree;
+		initTree(&tree);
+
+		OptionKey romeo("verona.montague.romeo");
+		QCOMPARE(tree.getOption(romeo), goodValues_["verona.montague.romeo"]);
+
+		QSignalSpy spy(tree.optionSlot(romeo), SIGNAL(changed()));
+		tree.setOption("verona.montague.romeo", QVariant(QString("alive")));
+		QCOMPARE(tree.getOption(romeo), QVariant(QString("alive")));
+		QCOMPARE(spy.count(), 1);
+
+		tree.setOption(romeo, QVariant(QString("alive")));
+		QCOMPARE(spy.count(), 1);
+
+		tree.removeOption("verona", true);
+		QVERIFY(!tree.optionSlot(romeo)->exists());
+		QCOMPARE(tree.getOption(romeo, QVariant(false)), QVariant(false));
+		QCOMPARE(spy.count(), 2);
+
+		tree.setOption(romeo, QVariant(QString("again")));
+		QCOMPARE(tree.getOption("verona.montague.romeo"), QVariant(QString("again")));
+		QCOMPARE(spy.count(), 3);
+
+		// the same key can be used with another tree
+		OptionsTree tree2;
+		initTree(&tree2);
+		QCOMPARE(tree2.getOption(romeo), goodValues_["verona.montague.romeo"]);
+	}
+
+	void getOptionNoSlotTest() {
+		OptionsTree tree;
+		initTree(&tree);
+
+		QCOMPARE(tree.getOption("verona.montague.romeo"), goodValues_["verona.montague.romeo"]);
+		QCOMPARE(tree.getOption("nowhere", QVariant(false)), QVariant(false));
+		QVERIFY(tree.findChildren<OptionSlot*>().isEmpty());
+
+		// a slot that is there is used
+		OptionKey romeo("verona.montague.romeo");
+		tree.getOption(romeo);
+		QCOMPARE(tree.findChildren<OptionSlot*>().count(), 1);
+		tree.setOption(romeo, QVariant(QString("alive")));
+		QCOMPARE(tree.getOption("verona.montague.romeo"), QVariant(QString("alive")));
+	}
+
+	void optionSlotLoadTest() {
+		OptionsTree tree;
+		initTree(&tree);
+
+		OptionKey paris("paris");
+		OptionKey rome("rome");
+		QCOMPARE(tree.getOption(paris), goodValues_["paris"]);
+		QVERIFY(!tree.getOption(rome, QVariant()).isValid());
+
+		QDomDocument doc;
+		QDomElement base = doc.createElement("OptionsTest");
+		QDomElement e = doc.createElement("paris");
+		e.setAttribute("type", "QString");
+		e.appendChild(doc.createTextNode("loaded"));
+		base.appendChild(e);
+		e = doc.createElement("rome");
+		e.setAttribute("type", "int");
+		e.appendChild(doc.createTextNode("753"));
+		base.appendChild(e);
+		QVERIFY(tree.loadOptions(base, "OptionsTest"));
+
+		QCOMPARE(tree.getOption(paris), QVariant(QString("loaded")));
+		QCOMPARE(tree.getOption(rome), QVariant(753));
+	}
+
+	void benchGetOption() {
+		OptionsTree tree;
+		initTree(&tree);
+		QBENCHMARK {
+			tree.getOption("verona.montague.romeo");
+		}
+	}
+
+	void benchGetOptionKey() {
+		OptionsTree tree;
+		initTree(&tree);
+		OptionKey romeo("verona.montague.romeo");
+		QBENCHMARK {
+			tree.getOption(romeo);
+		}
+	}
+
 #if 0
 	void stressTest() {
 		bench_.startIteration();
@@ -0,0 +1,164 @@
+#include <QtTest/QtTest>
+#include <QAbstractItemModel>
+#include <QtCrypto>
+
+#include "psicon.h"
+#include "psiaccount.h"
+#include "psicontact.h"
+#include "psicontactlist.h"
+#include "profiles.h" // for UserAccount
+#include "userlist.h" // for UserListItem
+#include "contactlistmodel.h"
+#include "contactlistgroup.h"
+#include "contactlistitemproxy.h"
+#include "contactlistproxymodel.h"
+
+// makes the comparison the roster is sorted with public
+class SortProxyModel : public ContactListProxyModel
+{
+public:
+	SortProxyModel() : ContactListProxyModel(0) {}
+	using ContactListProxyModel::lessThan;
+};
+
+// hands out indexes which point to an item proxy, as the ones of
+// ContactListModel do
+class ItemProxyIndexes : public QAbstractItemModel
+{
+public:
+	QModelIndex indexOf(ContactListItemProxy* proxy) const { return createIndex(0, 0, proxy); }
+
+	QModelIndex index(int, int, const QModelIndex&) const { return QModelIndex(); }
+	QModelIndex parent(const QModelIndex&) const { return QModelIndex(); }
+	int rowCount(const QModelIndex&) const { return 0; }
+	int columnCount(const QModelIndex&) const { return 1; }
+	QVariant data(const QModelIndex&, int) const { return QVariant(); }
+};
+
+class TestContactSortKey: public QObject
+{
+	Q_OBJECT
+private:
+	PsiCon *psi;
+	PsiAccount *account;
+	QCA::Initializer *qca_init;
+
+	static UserListItem item(const QString& jid, const QString& name, XMPP::Status::Type status)
+	{
+		UserListItem u;
+		u.setJid(jid);
+		u.setName(name);
+		u.setInList(true);
+		if (status != XMPP::Status::Offline) {
+			UserResource ur;
+			ur.setName("Psi");
+			ur.setStatus(XMPP::Status(status));
+			u.userResourceList().append(ur);
+		}
+		return u;
+	}
+
+private slots:
+	void initTestCase()
+	{
+		qca_init = new QCA::Initializer();
+		QCA::keyStoreManager()->start();
+		QCA::keyStoreManager()->waitForBusyFinished();
+
+		psi = new PsiCon();
+		psi->init();
+		UserAccount userAccount;
+		account = new PsiAccount(userAccount, psi);
+	}
+
+	void cleanupTestCase()
+	{
+		delete psi;
+		QCA::unloadAllPlugins();
+		delete qca_init;
+	}
+
+	void testLessThanByName()
+	{
+		PsiContact bob(item("bob@example.org", "bob", XMPP::Status::Online), account);
+		PsiContact alice(item("alice@example.org", "Alice", XMPP::Status::Offline), account);
+
+		QVERIFY(alice.lessThan(&bob, false));
+		QVERIFY(!bob.lessThan(&alice, false));
+		QVERIFY(!alice.lessThan(&alice, false));
+	}
+
+	void testLessThanByStatus()
+	{
+		PsiContact zed(item("zed@example.org", "Zed", XMPP::Status::Online), account);
+		PsiContact alice(item("alice@example.org", "Alice", XMPP::Status::Offline), account);
+		PsiContact bob(item("bob@example.org", "Bob", XMPP::Status::Offline), account);
+
+		QVERIFY(zed.lessThan(&alice, true));
+		QVERIFY(!alice.lessThan(&zed, true));
+		// the same status is sorted by name
+		QVERIFY(alice.lessThan(&bob, true));
+		QVERIFY(!bob.lessThan(&alice, true));
+
+		// compare() sorts by status as well
+		QVERIFY(zed.compare(&alice));
+		QVERIFY(!alice.compare(&zed));
+	}
+
+	void testUpdateInvalidatesKey()
+	{
+		PsiContact a(item("a@example.org", "Anne", XMPP::Status::Online), account);
+		PsiContact b(item("b@example.org", "Bert", XMPP::Status::Online), account);
+		QVERIFY(a.lessThan(&b, false));
+
+		a.update(item("a@example.org", "Zoe", XMPP::Status::Online));
+		QVERIFY(b.lessThan(&a, false));
+		QVERIFY(!a.lessThan(&b, false));
+	}
+
+	void testStatusChangeInvalidatesKey()
+	{
+		PsiContact a(item("a@example.org", "Anne", XMPP::Status::Online), account);
+		PsiContact b(item("b@example.org", "Bert", XMPP::Status::Offline), account);
+		QVERIFY(a.lessThan(&b, true));
+
+		a.update(item("a@example.org", "Anne", XMPP::Status::Offline));
+		b.update(item("b@example.org", "Bert", XMPP::Status::Online));
+		QVERIFY(b.lessThan(&a, true));
+		QVERIFY(!a.lessThan(&b, true));
+	}
+
+	void testProxyModel()
+	{
+		psi->contactList()->setContactSortStyle("alpha");
+		ContactListModel model(psi->contactList());
+		SortProxyModel proxy;
+		proxy.setSourceModel(&model);
+
+		PsiContact zed(item("zed@example.org", "Zed", XMPP::Status::Online), account);
+		PsiContact alice(item("alice@example.org", "alice", XMPP::Status::Offline), account);
+		ContactListGroup group(&model, 0);
+		ContactListItemProxy zedProxy(&group, &zed);
+		ContactListItemProxy aliceProxy(&group, &alice);
+		ItemProxyIndexes indexes;
+		QModelIndex zedIndex = indexes.indexOf(&zedProxy);
+		QModelIndex aliceIndex = indexes.indexOf(&aliceProxy);
+
+		QVERIFY(proxy.lessThan(aliceIndex, zedIndex));
+		QVERIFY(!proxy.lessThan(zedIndex, aliceIndex));
+
+		// the proxy picks up the new sort style
+		psi->contactList()->setContactSortStyle("status");
+		QVERIFY(proxy.lessThan(zedIndex, aliceIndex));
+		QVERIFY(!proxy.lessThan(aliceIndex, zedIndex));
+
+		// and the new status of a contact
+		zed.update(item("zed@example.org", "Zed", XMPP::Status::Offline));
+		QVERIFY(proxy.lessThan(aliceIndex, zedIndex));
+
+		psi->contactList()->setContactSortStyle("alpha");
+	}
+};
+
+QTEST_MAIN(TestContactSortKey)
+#include "testcontactsortkey.moc"
@@ -0,0 +1,4 @@
+TARGET = testcontactsortkey
+SOURCES += testcontactsortkey.cpp
+
+include(../half_of_psi.pri)
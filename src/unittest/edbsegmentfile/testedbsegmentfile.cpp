@@ -0,0 +1,157 @@
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+
+#include "edbsegmentfile.h"
+
+class TestEDBSegmentFile: public QObject
+{
+	Q_OBJECT
+private:
+	QString fileName;
+	XMPP::Jid jid;
+#ifdef Q_OS_UNIX
+	struct rlimit savedLimit;
+#endif
+
+	// a history line which doesn't compress much
+	static QString line(int n, int size)
+	{
+		static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		QString text;
+		uint x = n + 1;
+		while(text.size() < size) {
+			x = x * 1103515245 + 12345;
+			text += QChar(chars[(x >> 16) & 63]);
+		}
+		return QString("|2026-10-16T18:00:00|1|from|N---|%1|%2").arg(n).arg(text);
+	}
+
+	QString activeLog() const
+	{
+		return EDBSegmentFile::Store::dirName(fileName) + "/active.log";
+	}
+
+	// makes writes past \a size fail, for every file
+	void limitFileSize(qint64 size)
+	{
+#ifdef Q_OS_UNIX
+		struct rlimit rl = savedLimit;
+		rl.rlim_cur = size;
+		QVERIFY(setrlimit(RLIMIT_FSIZE, &rl) == 0);
+#else
+		Q_UNUSED(size);
+#endif
+	}
+
+	void unlimitFileSize()
+	{
+#ifdef Q_OS_UNIX
+		setrlimit(RLIMIT_FSIZE, &savedLimit);
+#endif
+	}
+
+	void removeHistory()
+	{
+		QDir dir(EDBSegmentFile::Store::dirName(fileName));
+		foreach(const QString &f, dir.entryList(QDir::Files))
+			dir.remove(f);
+		QDir().rmdir(dir.path());
+		QFile::remove(fileName);
+	}
+
+private slots:
+	void initTestCase()
+	{
+#ifdef Q_OS_UNIX
+		// a write past the limit then fails with EFBIG, instead of killing us
+		signal(SIGXFSZ, SIG_IGN);
+		getrlimit(RLIMIT_FSIZE, &savedLimit);
+#endif
+		fileName = QDir::tempPath() + "/testedbsegmentfile.history";
+		jid = XMPP::Jid("test@example.com");
+	}
+
+	void init()
+	{
+		removeHistory();
+	}
+
+	void cleanup()
+	{
+		unlimitFileSize();
+		removeHistory();
+	}
+
+	// the write failures are only simulated on unix
+#ifdef Q_OS_UNIX
+	void testFailedFlushDropsLines()
+	{
+		{
+			EDBSegmentFile::Store store(jid, fileName);
+			for(int n = 0; n < 10; ++n)
+				QVERIFY(store.append(line(n, 50), QString(), false));
+			qint64 size = QFileInfo(activeLog()).size();
+
+			// only part of the line makes it to the file
+			limitFileSize(size + 20);
+			QVERIFY(!store.append(line(10, 50), QString(), false));
+			unlimitFileSize();
+			QCOMPARE(store.total(), 10);
+			QCOMPARE(QFileInfo(activeLog()).size(), size);
+
+			QVERIFY(store.append(line(11, 50), QString(), false));
+			QCOMPARE(store.total(), 11);
+		}
+
+		EDBSegmentFile::Store store(jid, fileName);
+		QCOMPARE(store.total(), 11);
+
+		QFile f(activeLog());
+		QVERIFY(f.open(QIODevice::ReadOnly));
+		QByteArray data = f.readAll();
+		QVERIFY(!data.contains(line(10, 50).toUtf8()));
+		QVERIFY(data.endsWith(line(11, 50).toUtf8() + '\n'));
+	}
+
+	void testFailedSealDropsLine()
+	{
+		int sealed;
+		{
+			EDBSegmentFile::Store store(jid, fileName);
+
+			// a big first block, so the next one is written past the limit
+			int n = 0;
+			while(QFileInfo(EDBSegmentFile::Store::dirName(fileName) + "/00000000.seg").size() == 0)
+				QVERIFY(store.append(line(n++, 1000), QString(), false));
+			sealed = store.total();
+
+			// one line short of a full block
+			for(int k = 0; k < 255; ++k)
+				QVERIFY(store.append(line(n++, 20), QString(), false));
+			QCOMPARE(store.total(), sealed + 255);
+
+			limitFileSize(QFileInfo(activeLog()).size() + 200);
+			QVERIFY(!store.append(line(n, 20), QString(), false));
+			unlimitFileSize();
+			QCOMPARE(store.total(), sealed + 255);
+
+			// the line which failed isn't sealed along with the next one
+			QVERIFY(store.append(line(n + 1, 20), QString(), false));
+			QCOMPARE(store.total(), sealed + 256);
+			QCOMPARE(QFileInfo(activeLog()).size(), qint64(QByteArray("#" + QByteArray::number(sealed + 256) + '\n').size()));
+		}
+
+		EDBSegmentFile::Store store(jid, fileName);
+		QCOMPARE(store.total(), sealed + 256);
+	}
+#endif
+};
+
+QTEST_MAIN(TestEDBSegmentFile)
+#include "testedbsegmentfile.moc"
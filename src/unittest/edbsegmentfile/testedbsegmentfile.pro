@@ -0,0 +1,4 @@
+TARGET = testedbsegmentfile
+SOURCES += testedbsegmentfile.cpp
+
+include(../half_of_psi.pri)
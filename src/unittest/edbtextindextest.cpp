@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+
+#include "qttestutil/qttestutil.h"
+#include "edbtextindex.h"
+
+class EDBTextIndexTest : public QObject
+{
+		Q_OBJECT
+
+	private:
+		QString fileName_;
+
+		static QList<int> ids(const QList<EDBTextIndex::Hit> &hits) {
+			QList<int> list;
+			foreach(const EDBTextIndex::Hit &hit, hits)
+				list += hit.first;
+			return list;
+		}
+
+		static void addAll(EDBTextIndex *index) {
+			index->add(0, "Hello world");
+			index->add(1, "the world is round, the world is big");
+			index->add(2, "Wonderful weather");
+			index->add(3, "a whole new world");
+		}
+
+	private slots:
+		void initTestCase() {
+			fileName_ = QDir::temp().filePath("edbtextindextest.fts");
+		}
+
+		void cleanupTestCase() {
+			QFile::remove(fileName_);
+		}
+
+		void testWordPrefix() {
+			EDBTextIndex index(fileName_);
+			addAll(&index);
+			QCOMPARE(ids(index.find("wor")), QList<int>() << 1 << 3 << 0);
+			QCOMPARE(ids(index.find("WONDER")), QList<int>() << 2);
+			QVERIFY(index.find("orld").isEmpty());
+		}
+
+		void testPhrase() {
+			EDBTextIndex index(fileName_);
+			addAll(&index);
+			// the first word may be the end of a word, the last one the
+			// beginning, the ones in between have to match whole
+			QCOMPARE(ids(index.find("ole new wo")), QList<int>() << 3);
+			QCOMPARE(ids(index.find("he world is ro")), QList<int>() << 1);
+			QVERIFY(index.find("whole ne world").isEmpty());
+			QVERIFY(index.find("world hello").isEmpty());
+		}
+
+		void testRanking() {
+			EDBTextIndex index(fileName_);
+			addAll(&index);
+			QList<EDBTextIndex::Hit> hits = index.find("the world");
+			QCOMPARE(hits.count(), 1);
+			QCOMPARE(hits[0], EDBTextIndex::Hit(1, 2));
+
+			// most occurrences first, then the newer event
+			hits = index.find("world");
+			QCOMPARE(hits.count(), 3);
+			QCOMPARE(hits[0], EDBTextIndex::Hit(1, 2));
+			QCOMPARE(hits[1], EDBTextIndex::Hit(3, 1));
+			QCOMPARE(hits[2], EDBTextIndex::Hit(0, 1));
+		}
+
+		void testTermsAddedAfterFind() {
+			EDBTextIndex index(fileName_);
+			addAll(&index);
+			QVERIFY(index.find("zebra").isEmpty());
+			index.add(4, "a zebra crossing");
+			QCOMPARE(ids(index.find("zeb")), QList<int>() << 4);
+			QCOMPARE(ids(index.find("ebra cross")), QList<int>() << 4);
+		}
+
+		void testSaveLoad() {
+			EDBTextIndex index(fileName_);
+			addAll(&index);
+			QVERIFY(index.save());
+			QVERIFY(index.journal(4, "worldly goods"));
+
+			EDBTextIndex loaded(fileName_);
+			QVERIFY(loaded.load());
+			QCOMPARE(loaded.count(), 5);
+			QCOMPARE(loaded.journalSize(), 1);
+			QCOMPARE(ids(loaded.find("world")), QList<int>() << 1 << 4 << 3 << 0);
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(EDBTextIndexTest);
+#include "edbtextindextest.moc"
@@ -0,0 +1,200 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QCryptographicHash>
+
+#include "qttestutil/qttestutil.h"
+#include "filetransferio.h"
+
+// what FileTransfer::dataSizeNeeded() asks for at most
+#define BLOCK_SIZE 65536
+
+class FileTransferIOTest : public QObject
+{
+		Q_OBJECT
+
+	private:
+		QString source_, target_;
+
+		void createSource(qint64 size) {
+			qsrand(1);
+			QFile f(source_);
+			QVERIFY(f.open(QIODevice::WriteOnly | QIODevice::Truncate));
+			QByteArray block(BLOCK_SIZE, 0);
+			for(qint64 n = 0; n < size; n += block.size()) {
+				for(int i = 0; i < block.size(); ++i)
+					block[i] = char(qrand());
+				f.write(block.constData(), int(qMin<qint64>(block.size(), size - n)));
+			}
+		}
+
+		static void waitFor(QObject *o, const char *signal) {
+			QEventLoop loop;
+			QObject::connect(o, signal, &loop, SLOT(quit()));
+			loop.exec();
+		}
+
+		// the sending end feeding the receiving one
+		void copyThreaded(qint64 offset) {
+			FileTransferIO in(source_), out(target_);
+			QVERIFY(in.open(QIODevice::ReadOnly, offset));
+			QVERIFY(out.open(QIODevice::ReadWrite | QIODevice::Truncate, 0));
+			pump(in, out);
+		}
+
+		static void pump(FileTransferIO &in, FileTransferIO &out) {
+			while(!in.atEnd()) {
+				QByteArray a = in.read(BLOCK_SIZE);
+				if(a.isEmpty()) {
+					if(!in.atEnd())
+						waitFor(&in, SIGNAL(readyRead()));
+					continue;
+				}
+				out.write(a);
+			}
+			out.flush();
+			waitFor(&out, SIGNAL(flushed()));
+		}
+
+		// the hasher goes on after close() and flushed()
+		static QByteArray waitForHash(FileTransferIO &io) {
+			while(io.hash().isEmpty() && io.isHashing())
+				waitFor(&io, SIGNAL(hashReady()));
+			return io.hash();
+		}
+
+		bool sameContents(qint64 offset) {
+			QFile a(source_), b(target_);
+			if(!a.open(QIODevice::ReadOnly) || !b.open(QIODevice::ReadOnly) || !a.seek(offset))
+				return false;
+			return a.readAll() == b.readAll();
+		}
+
+		QByteArray sourceHash() {
+			QFile f(source_);
+			if(!f.open(QIODevice::ReadOnly))
+				return QByteArray();
+#if QT_VERSION >= 0x050000
+			return QCryptographicHash::hash(f.readAll(), QCryptographicHash::Sha256);
+#else
+			return QCryptographicHash::hash(f.readAll(), QCryptographicHash::Sha1);
+#endif
+		}
+
+	private slots:
+		void initTestCase() {
+			source_ = QDir::temp().filePath("filetransferiotest.in");
+			target_ = QDir::temp().filePath("filetransferiotest.out");
+		}
+
+		void cleanupTestCase() {
+			QFile::remove(source_);
+			QFile::remove(target_);
+		}
+
+		void testCopy() {
+			createSource(5 * BLOCK_SIZE + 123);
+			copyThreaded(0);
+			QVERIFY(sameContents(0));
+		}
+
+		void testResume() {
+			createSource(3 * BLOCK_SIZE + 17);
+			copyThreaded(BLOCK_SIZE + 5);
+			QVERIFY(sameContents(BLOCK_SIZE + 5));
+		}
+
+		void testHash() {
+			createSource(4 * BLOCK_SIZE + 1);
+			FileTransferIO in(source_), out(target_);
+			QVERIFY(in.open(QIODevice::ReadOnly, 0));
+			QVERIFY(out.open(QIODevice::ReadWrite | QIODevice::Truncate, 0));
+			QVERIFY(in.hash().isEmpty());
+			pump(in, out);
+			in.close();
+			QCOMPARE(waitForHash(in), sourceHash());
+			QCOMPARE(waitForHash(out), sourceHash());
+		}
+
+		void testResumeHash() {
+			// the receiving end has the head of the file already
+			qint64 offset = 2 * BLOCK_SIZE + 7;
+			createSource(3 * BLOCK_SIZE + 17);
+			QFile src(source_), part(target_);
+			QVERIFY(src.open(QIODevice::ReadOnly) && part.open(QIODevice::WriteOnly | QIODevice::Truncate));
+			part.write(src.read(offset));
+			part.close();
+
+			FileTransferIO in(source_), out(target_);
+			QVERIFY(in.open(QIODevice::ReadOnly, offset));
+			QVERIFY(out.open(QIODevice::ReadWrite, offset));
+			pump(in, out);
+			in.close();
+			QVERIFY(sameContents(0));
+			QCOMPARE(waitForHash(in), sourceHash());
+			QCOMPARE(waitForHash(out), sourceHash());
+		}
+
+		void testWriteMoreThanQueued() {
+			// more than the worker writes at once, in one piece and in
+			// blocks
+			createSource(10 * BLOCK_SIZE + 3);
+			QFile f(source_);
+			QVERIFY(f.open(QIODevice::ReadOnly));
+			QByteArray data = f.readAll();
+			FileTransferIO out(target_);
+			QVERIFY(out.open(QIODevice::ReadWrite | QIODevice::Truncate, 0));
+			out.write(data);
+			for(int n = 0; n < data.size(); n += BLOCK_SIZE)
+				out.write(data.mid(n, BLOCK_SIZE));
+			out.flush();
+			waitFor(&out, SIGNAL(flushed()));
+
+			QFile g(target_);
+			QVERIFY(g.open(QIODevice::ReadOnly));
+			QCOMPARE(g.readAll(), data + data);
+		}
+
+		void testWriteLimit() {
+			// more than may wait for the disk, 16 MB
+			FileTransferIO out(target_);
+			QVERIFY(out.open(QIODevice::ReadWrite | QIODevice::Truncate, 0));
+			QSignalSpy spy(&out, SIGNAL(error(const QString &)));
+			out.write(QByteArray(17 * 1024 * 1024, 'x'));
+			QCOMPARE(spy.count(), 0);
+			waitFor(&out, SIGNAL(error(const QString &)));
+			QVERIFY(!out.errorString().isEmpty());
+		}
+
+		void testPartialReads() {
+			createSource(2 * BLOCK_SIZE);
+			FileTransferIO in(source_);
+			QVERIFY(in.open(QIODevice::ReadOnly, 0));
+			QByteArray data;
+			while(!in.atEnd()) {
+				QByteArray a = in.read(1000);
+				if(a.isEmpty() && !in.atEnd())
+					waitFor(&in, SIGNAL(readyRead()));
+				QVERIFY(a.size() <= 1000);
+				data += a;
+			}
+			QFile f(source_);
+			QVERIFY(f.open(QIODevice::ReadOnly));
+			QCOMPARE(data, f.readAll());
+		}
+
+		void testOpenError() {
+			FileTransferIO io(QDir::temp().filePath("filetransferiotest.missing/file"));
+			QVERIFY(!io.open(QIODevice::ReadOnly, 0));
+			QVERIFY(!io.errorString().isEmpty());
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(FileTransferIOTest);
+#include "filetransferiotest.moc"
@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+#include "qttestutil/qttestutil.h"
+#include "jidindex.h"
+
+using XMPP::Jid;
+
+class JidIndexTest : public QObject
+{
+		Q_OBJECT
+
+	private:
+		struct Item
+		{
+			Item(const Jid &j) : j_(j) {}
+			const Jid &jid() const { return j_; }
+			Jid j_;
+		};
+
+	private slots:
+		void testLookups() {
+			Item a(Jid("a@example.org")), roomNick(Jid("room@conference.example.org/nick")),
+				bHome(Jid("b@example.org/home")), room(Jid("room@conference.example.org")),
+				b(Jid("b@example.org")), a2(Jid("a@example.org")),
+				roomOther(Jid("room@conference.example.org/other"));
+			JidIndex<Item> index;
+			index.insert(&a);
+			index.insert(&roomNick);
+			index.insert(&bHome);
+			index.insert(&room);
+			index.insert(&b);
+			index.insert(&a2);
+			index.insert(&roomOther);
+
+			// the first one with the same full jid
+			QCOMPARE(index.find(Jid("a@example.org")), &a);
+			QVERIFY(!index.find(Jid("a@example.org/res")));
+			QCOMPARE(index.find(Jid("b@example.org/home")), &bHome);
+			QVERIFY(!index.find(Jid("b@example.org/work")));
+			QCOMPARE(index.find(Jid("room@conference.example.org")), &room);
+			QCOMPARE(index.find(Jid("room@conference.example.org/nick")), &roomNick);
+			QVERIFY(!index.find(Jid("c@example.org")));
+			QVERIFY(!index.find(Jid("example.org")));
+
+			// the bare jid, and the same resource, in the order of insertion
+			QCOMPARE(index.findRelevant(Jid("a@example.org")), QList<Item*>() << &a << &a2);
+			QCOMPARE(index.findRelevant(Jid("a@example.org/res")), QList<Item*>() << &a << &a2);
+			QCOMPARE(index.findRelevant(Jid("b@example.org")), QList<Item*>() << &b);
+			QCOMPARE(index.findRelevant(Jid("b@example.org/home")), QList<Item*>() << &bHome << &b);
+			QCOMPARE(index.findRelevant(Jid("b@example.org/work")), QList<Item*>() << &b);
+			QCOMPARE(index.findRelevant(Jid("room@conference.example.org")), QList<Item*>() << &room);
+			QCOMPARE(index.findRelevant(Jid("room@conference.example.org/nick")), QList<Item*>() << &roomNick << &room);
+			QCOMPARE(index.findRelevant(Jid("room@conference.example.org/other")), QList<Item*>() << &room << &roomOther);
+			QVERIFY(index.findRelevant(Jid("c@example.org")).isEmpty());
+			QVERIFY(index.findRelevant(Jid("example.org")).isEmpty());
+		}
+
+		void testRemove() {
+			Item a(Jid("a@example.org")), a2(Jid("a@example.org")), ar(Jid("a@example.org/res"));
+			JidIndex<Item> index;
+			index.insert(&a);
+			index.insert(&ar);
+			index.insert(&a2);
+
+			index.remove(&a);
+			QCOMPARE(index.find(Jid("a@example.org")), &a2);
+			QCOMPARE(index.findRelevant(Jid("a@example.org/res")), QList<Item*>() << &ar << &a2);
+
+			index.remove(&ar);
+			index.remove(&a2);
+			QVERIFY(!index.find(Jid("a@example.org")));
+			QVERIFY(index.findRelevant(Jid("a@example.org/res")).isEmpty());
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(JidIndexTest);
+#include "jidindextest.moc"
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QColor>
+
+#include "qttestutil/qttestutil.h"
+#include "jsutil.h"
+
+class JSUtilTest : public QObject
+{
+		Q_OBJECT
+
+	private slots:
+		void testEscapeString() {
+			QString s("a\r\n\"b\"\\c\rd%1e");
+			s = s.arg(QChar(8232));
+			// line breaks of any kind are escaped as a backslash and \n
+			QCOMPARE(JSUtil::escapeStringCopy(s),
+				QString("a" "\\\n" "\\\"b\\\"" "\\\\" "c" "\\\n" "d" "\\\n" "e"));
+			QCOMPARE(JSUtil::escapeStringCopy(QString()), QString());
+		}
+
+		void testMap() {
+			QVariantMap nested;
+			nested["k"] = true;
+
+			QVariantMap m;
+			m["b"] = "x\"y";
+			m["a"] = 1;
+			m["c"] = QStringList() << "p" << "q\nr";
+			m["d"] = QDate(2026, 1, 2);
+			m["e"] = QDateTime(QDate(2026, 10, 16), QTime(12, 34, 5));
+			m["f"] = QColor(Qt::red);
+			m["g"] = nested;
+			m["h \"q\""] = 1.5;
+			m["i"] = QString();
+
+			QString json = "{\"a\":1,\"b\":\"x\\\"y\",\"c\":[\"p\",\"q\\\nr\"],"
+				"\"d\":new Date(2026,1-1,2),\"e\":new Date(2026,10-1,16,12,34,5),"
+				"\"f\":\"#ff0000\",\"g\":{\"k\":true},\"h \\\"q\\\"\":1.5,\"i\":\"\"}";
+			QCOMPARE(JSUtil::map2json(m), json);
+			QCOMPARE(JSUtil::variant2js(m), json);
+			QCOMPARE(JSUtil::map2json(QVariantMap()), QString("{}"));
+		}
+
+		void testList() {
+			QVariantMap m;
+			m["a"] = "x";
+			QVariantList list;
+			list << m << "s" << 2 << QVariantList();
+			QCOMPARE(JSUtil::variant2js(list), QString("[{\"a\":\"x\"},\"s\",2,[]]"));
+			QCOMPARE(JSUtil::variant2js(QVariantList()), QString("[]"));
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(JSUtilTest);
+#include "jsutiltest.moc"
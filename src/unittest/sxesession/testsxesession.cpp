@@ -0,0 +1,121 @@
+#include <QtTest/QtTest>
+#include <QDomDocument>
+
+#include "sxe/sxesession.h"
+
+// Replays a synthetic SXE edit log like the one of a whiteboard with a
+// lot of paths: the paths are created in random order of their weights,
+// then some are moved and removed.
+class TestSxeSession : public QObject
+{
+	Q_OBJECT
+private:
+	QDomDocument doc;
+	QList<QDomElement> log;
+	QMap<QPair<double, QString>, QString> expected; // weight, rid -> id attribute
+	QHash<QString, double> weights;
+	QHash<QString, int> versions;
+
+	void add(const QString &name, const QHash<QString, QString> &attributes)
+	{
+		QDomElement sxe = doc.createElementNS(SXENS, "sxe");
+		QDomElement edit = doc.createElement(name);
+		foreach(const QString &a, attributes.keys())
+			edit.setAttribute(a, attributes[a]);
+		sxe.appendChild(edit);
+		log += sxe;
+	}
+
+	void newNode(const QString &rid, const QString &type, const QString &name, const QString &parent, double weight, const QString &chdata = QString())
+	{
+		QHash<QString, QString> a;
+		a["rid"] = rid;
+		a["type"] = type;
+		a["name"] = name;
+		a["parent"] = parent;
+		a["primary-weight"] = QString::number(weight, 'g', 17);
+		if(!chdata.isNull())
+			a["chdata"] = chdata;
+		add("new", a);
+	}
+
+	void generate(int paths, int moves, int removes)
+	{
+		doc = QDomDocument();
+		log.clear();
+		expected.clear();
+		weights.clear();
+		versions.clear();
+		qsrand(1);
+
+		newNode("root", "element", "svg", QString(), 0);
+		for(int n = 0; n < paths; ++n) {
+			QString rid = QString("p%1").arg(n);
+			double weight = qrand() % (paths * 4);
+			newNode(rid, "element", "path", "root", weight);
+			newNode(QString("a%1").arg(n), "attr", "id", rid, 0, rid);
+			weights[rid] = weight;
+			versions[rid] = 0;
+		}
+
+		for(int n = 0; n < moves; ++n) {
+			QString rid = QString("p%1").arg(qrand() % paths);
+			double weight = qrand() % (paths * 4) + 0.5;
+			QHash<QString, QString> a;
+			a["rid"] = rid;
+			a["version"] = QString::number(++versions[rid]);
+			a["primary-weight"] = QString::number(weight, 'g', 17);
+			add("set", a);
+			weights[rid] = weight;
+		}
+
+		for(int n = 0; n < removes; ++n) {
+			QString rid = QString("p%1").arg(qrand() % paths);
+			if(!weights.contains(rid))
+				continue;
+			QHash<QString, QString> a;
+			a["rid"] = QString("a%1").arg(rid.mid(1));
+			add("remove", a);
+			a["rid"] = rid;
+			add("remove", a);
+			weights.remove(rid);
+		}
+
+		foreach(const QString &rid, weights.keys())
+			expected.insert(qMakePair(weights[rid], rid), rid);
+	}
+
+	SxeSession *replay()
+	{
+		SxeSession *session = new SxeSession(0, XMPP::Jid("peer@example.org"), "session", XMPP::Jid("me@example.org"), false, true, QList<QString>());
+		for(int n = 0; n < log.count(); ++n)
+			session->processIncomingSxeElement(log[n], QString::number(n));
+		return session;
+	}
+
+private slots:
+	void testOrder()
+	{
+		generate(300, 300, 100);
+		SxeSession *session = replay();
+
+		QStringList ids;
+		QDomNodeList children = session->document().documentElement().childNodes();
+		for(int n = 0; n < children.count(); ++n)
+			ids += children.at(n).toElement().attribute("id");
+		QCOMPARE(ids, QStringList(expected.values()));
+
+		delete session;
+	}
+
+	void benchReplay()
+	{
+		generate(3000, 3000, 500);
+		QBENCHMARK {
+			delete replay();
+		}
+	}
+};
+
+QTEST_MAIN(TestSxeSession)
+#include "testsxesession.moc"
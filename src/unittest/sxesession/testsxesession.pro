@@ -0,0 +1,5 @@
+TARGET = testsxesession
+SOURCES += testsxesession.cpp
+
+CONFIG += whiteboarding
+include(../half_of_psi.pri)
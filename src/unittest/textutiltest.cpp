@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+#include "qttestutil/qttestutil.h"
+#include "textutil.h"
+#include "psiiconset.h"
+
+// textutil.cpp needs these for emoticonify(), which isn't tested here
+PsiIconset *PsiIconset::instance()
+{
+	return 0;
+}
+
+PsiIcon *PsiIconset::findEmoticon(const QString &, int, int *, int *) const
+{
+	return 0;
+}
+
+class TextUtilTest : public QObject
+{
+		Q_OBJECT
+
+	private slots:
+		// The expected output is what linkify() produced before it was
+		// rewritten as a single pass, quirks included.
+		void testLinkify_data() {
+			QTest::addColumn<QString>("input");
+			QTest::addColumn<QString>("output");
+
+			QTest::newRow("plain") << QString("no links here")
+				<< QString("no links here");
+			QTest::newRow("empty") << QString("")
+				<< QString("");
+			QTest::newRow("http") << QString("see http://psi-im.org for more")
+				<< QString("see <a href=\"http://psi-im.org\">http://psi-im.org</a> for more");
+			QTest::newRow("https") << QString("https://example.com/path?a=1&amp;b=2")
+				<< QString("<a href=\"https://example.com/path?a=1&amp;b=2\">https://example.com/path?a=1&amp;b=2</a>");
+			QTest::newRow("uppercaseScheme") << QString("HTTP://EXAMPLE.COM/")
+				<< QString("<a href=\"HTTP://EXAMPLE.COM/\">HTTP://EXAMPLE.COM/</a>");
+			QTest::newRow("www") << QString("www.example.com")
+				<< QString("<a href=\"http://www.example.com\">www.example.com</a>");
+			QTest::newRow("wwwOnly") << QString("www.")
+				<< QString("<a href=\"http://www\">www</a>.");
+			QTest::newRow("ftpHost") << QString("get it from ftp.example.org/pub")
+				<< QString("get it from <a href=\"ftp://ftp.example.org/pub\">ftp.example.org/pub</a>");
+			QTest::newRow("ftpUrl") << QString("ftp://ftp.example.org/pub/file.tar.gz")
+				<< QString("<a href=\"ftp://ftp.example.org/pub/file.tar.gz\">ftp://ftp.example.org/pub/file.tar.gz</a>");
+			QTest::newRow("xmpp") << QString("join xmpp:room@conference.example.com?join now")
+				<< QString("join <a href=\"xmpp:room@conference.example.com?join\">xmpp:room@conference.example.com?join</a> now");
+			QTest::newRow("mailto") << QString("mailto:someone@example.com")
+				<< QString("<a href=\"mailto:someone@example.com\">mailto:someone@example.com</a>");
+			QTest::newRow("magnet") << QString("magnet:?xt=urn:btih:abc")
+				<< QString("<a href=\"magnet:?xt=urn:btih:abc\">magnet:?xt=urn:btih:abc</a>");
+			QTest::newRow("ed2k") << QString("ed2k://|file|a.iso|1|")
+				<< QString("<a href=\"ed2k://|file|a.iso|1|\">ed2k://|file|a.iso|1|</a>");
+			QTest::newRow("news") << QString("news://news.example.com/group")
+				<< QString("<a href=\"news://news.example.com/group\">news://news.example.com/group</a>");
+			QTest::newRow("trailingDot") << QString("http://example.com.")
+				<< QString("<a href=\"http://example.com\">http://example.com</a>.");
+			QTest::newRow("trailingPunctuation") << QString("Did you see http://example.com/page?!")
+				<< QString("Did you see <a href=\"http://example.com/page\">http://example.com/page</a>?!");
+			QTest::newRow("trailingComma") << QString("http://a.com/x, http://b.com/y")
+				<< QString("<a href=\"http://a.com/x\">http://a.com/x</a>, <a href=\"http://b.com/y\">http://b.com/y</a>");
+			QTest::newRow("parenthesized") << QString("(see http://example.com/)")
+				<< QString("(see <a href=\"http://example.com/\">http://example.com/</a>)");
+			QTest::newRow("balancedParens") << QString("http://en.wikipedia.org/wiki/Psi_(instant_messenger)")
+				<< QString("<a href=\"http://en.wikipedia.org/wiki/Psi_(instant_messenger)\">http://en.wikipedia.org/wiki/Psi_(instant_messenger)</a>");
+			QTest::newRow("balancedParensInParens") << QString("(http://en.wikipedia.org/wiki/Psi_(client))")
+				<< QString("(<a href=\"http://en.wikipedia.org/wiki/Psi_(client)\">http://en.wikipedia.org/wiki/Psi_(client)</a>)");
+			QTest::newRow("brackets") << QString("[http://example.com/a[1]]")
+				<< QString("[<a href=\"http://example.com/a[1]\">http://example.com/a[1]</a>]");
+			QTest::newRow("braces") << QString("{http://example.com/}")
+				<< QString("{<a href=\"http://example.com/\">http://example.com/</a>}");
+			QTest::newRow("quoted") << QString("&quot;http://example.com/&quot;")
+				<< QString("&quot;<a href=\"http://example.com/\">http://example.com/</a>&quot;");
+			QTest::newRow("quotedApos") << QString("&apos;http://example.com/&apos;")
+				<< QString("&apos;<a href=\"http://example.com/\">http://example.com/</a>&apos;");
+			QTest::newRow("angle") << QString("&lt;http://example.com/&gt;")
+				<< QString("&lt;<a href=\"http://example.com/\">http://example.com/</a>&gt;");
+			QTest::newRow("rawQuote") << QString("\"http://example.com/\"")
+				<< QString("\"<a href=\"http://example.com/\">http://example.com/</a>\"");
+			QTest::newRow("backtick") << QString("`http://example.com/`")
+				<< QString("`<a href=\"http://example.com/\">http://example.com/</a>`");
+			QTest::newRow("apostropheInside") << QString("http://example.com/it's")
+				<< QString("<a href=\"http://example.com/it\">http://example.com/it</a>'s");
+			QTest::newRow("ampersandEntity") << QString("http://example.com/?a=1&amp;b=2&amp;c=3.")
+				<< QString("<a href=\"http://example.com/?a=1&amp;b=2&amp;c=3\">http://example.com/?a=1&amp;b=2&amp;c=3</a>.");
+			QTest::newRow("unknownEntity") << QString("http://example.com/&foo;bar")
+				<< QString("<a href=\"http://example.com/bar\">http://example.com/bar</a>");
+			QTest::newRow("danglingAmpersand") << QString("http://example.com/?a&b")
+				<< QString("<a href=\"http://example.com/?a\">http://example.com/?a</a>");
+			QTest::newRow("afterAlnum") << QString("foohttp://example.com")
+				<< QString("foohttp://example.com");
+			QTest::newRow("afterPunctuation") << QString("x:http://example.com")
+				<< QString("x:<a href=\"http://example.com\">http://example.com</a>");
+			QTest::newRow("twoLinks") << QString("http://a.example.com http://b.example.com")
+				<< QString("<a href=\"http://a.example.com\">http://a.example.com</a> <a href=\"http://b.example.com\">http://b.example.com</a>");
+			QTest::newRow("tabAndNewline") << QString("http://a.example.com\thttp://b.example.com\nwww.c.example.com")
+				<< QString("<a href=\"http://a.example.com\">http://a.example.com</a>\t<a href=\"http://b.example.com\">http://b.example.com</a>\n<a href=\"http://www.c.example.com\">www.c.example.com</a>");
+			QTest::newRow("email") << QString("mail me at someone@example.com.")
+				<< QString("mail me at <a href=\"x-psi-atstyle:someone@example.com.\">someone@example.com.</a>");
+			QTest::newRow("emailPlus") << QString("first.last+tag@sub.example.co.uk")
+				<< QString("<a href=\"x-psi-atstyle:first.last+tag@sub.example.co.uk\">first.last+tag@sub.example.co.uk</a>");
+			QTest::newRow("emailNoDot") << QString("user@localhost")
+				<< QString("user@localhost");
+			QTest::newRow("emailDoubleDot") << QString("user@example..com")
+				<< QString("user@example..com");
+			QTest::newRow("emailStart") << QString("@example.com")
+				<< QString("@example.com");
+			QTest::newRow("emailEndsInDot") << QString("user@example.")
+				<< QString("user@example.");
+			QTest::newRow("emailChain") << QString("a@b.c@d.e")
+				<< QString("<a href=\"x-psi-atstyle:a@b.c\">a@b.c</a>@d.e");
+			QTest::newRow("emailAfterLink") << QString("http://example.com/ me@example.com")
+				<< QString("<a href=\"http://example.com/\">http://example.com/</a> <a href=\"x-psi-atstyle:me@example.com\">me@example.com</a>");
+			QTest::newRow("emailInsideLink") << QString("http://user@example.com/")
+				<< QString("<a href=\"http://user@example.com/\">http://user@example.com/</a>");
+			QTest::newRow("emailAfterAngle") << QString("&lt;me@example.com&gt;")
+				<< QString("&lt;<a href=\"x-psi-atstyle:me@example.com\">me@example.com</a>&gt;");
+			QTest::newRow("richText") << QString("<b>http://example.com/</b> and <i>www.example.com</i>")
+				<< QString("<b><a href=\"http://example.com/\">http://example.com/</a></b> and <i><a href=\"http://www.example.com\">www.example.com</a></i>");
+			QTest::newRow("quoteInHref") << QString("http://example.com/'`x")
+				<< QString("<a href=\"http://example.com/\">http://example.com/</a>'`x");
+			QTest::newRow("onlyScheme") << QString("http://")
+				<< QString("<a href=\"http://\">http://</a>");
+			QTest::newRow("schemeThenDot") << QString("http://.")
+				<< QString("<a href=\"http://\">http://</a>.");
+			QTest::newRow("mixedCase") << QString("Www.Example.Com/Path")
+				<< QString("<a href=\"http://Www.Example.Com/Path\">Www.Example.Com/Path</a>");
+		}
+
+		void testLinkify() {
+			QFETCH(QString, input);
+			QFETCH(QString, output);
+			QCOMPARE(TextUtil::linkify(input), output);
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(TextUtilTest);
+#include "textutiltest.moc"
@@ -1,2 +1,8 @@
 SOURCES += \
-	$$PWD/commontest.cpp
+	$$PWD/commontest.cpp \
+	$$PWD/textutiltest.cpp \
+	$$PWD/jidindextest.cpp \
+	$$PWD/xmlringbuffertest.cpp \
+	$$PWD/filetransferiotest.cpp \
+	$$PWD/edbtextindextest.cpp \
+	$$PWD/jsutiltest.cpp
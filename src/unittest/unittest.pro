@@ -8,7 +8,15 @@ include($$IRIS_XMPP_JID_MODULE)
 include($$PSI_TOOLS_OPTIONSTREE_MODULE)
 include($$PSI_TOOLS_ATOMICXMLFILE_MODULE)
 QT += gui xml
-INCLUDEPATH += .. ../../iris/src/xmpp/xmpp-im
+INCLUDEPATH += .. ../tools/iconset ../../iris/src/xmpp/xmpp-im
 DEPENDPATH += ..
 SOURCES += \
-	$$PWD/../common.cpp
+	$$PWD/../common.cpp \
+	$$PWD/../textutil.cpp \
+	$$PWD/../rtparse.cpp \
+	$$PWD/../xmlringbuffer.cpp \
+	$$PWD/../filetransferio.cpp \
+	$$PWD/../edbtextindex.cpp \
+	$$PWD/../jsutil.cpp
+HEADERS += \
+	$$PWD/../filetransferio.h
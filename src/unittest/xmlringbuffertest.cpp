@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2026, Psi Team
+ */
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+#include "qttestutil/qttestutil.h"
+#include "xmlringbuffer.h"
+
+class XmlRingBufferTest : public QObject
+{
+		Q_OBJECT
+
+	private:
+		static QStringList texts(const XmlRingBuffer &buf) {
+			QStringList list;
+			foreach(const XmlRingBuffer::Entry &e, buf.entries())
+				list += e.xml;
+			return list;
+		}
+
+	private slots:
+		void testDisabled() {
+			XmlRingBuffer buf;
+			buf.append(0, "<iq/>");
+			QVERIFY(buf.entries().isEmpty());
+		}
+
+		void testAppend() {
+			XmlRingBuffer buf;
+			buf.setCapacity(1024);
+			buf.append(0, "<iq/>");
+			buf.append(1, QString::fromUtf8("<message><body>\xc3\xa4</body></message>"));
+
+			QList<XmlRingBuffer::Entry> entries = buf.entries();
+			QCOMPARE(entries.count(), 2);
+			QCOMPARE(entries[0].type, 0);
+			QCOMPARE(entries[0].xml, QString("<iq/>"));
+			QCOMPARE(entries[1].type, 1);
+			QCOMPARE(entries[1].xml, QString::fromUtf8("<message><body>\xc3\xa4</body></message>"));
+			QVERIFY(entries[1].time.isValid());
+		}
+
+		void testWrapKeepsNewest() {
+			XmlRingBuffer buf;
+			buf.setCapacity(500);
+			QStringList all;
+			for(int n = 0; n < 100; ++n) {
+				all += QString("<presence id='%1'/>").arg(n);
+				buf.append(0, all.last());
+			}
+
+			QStringList kept = texts(buf);
+			QVERIFY(!kept.isEmpty());
+			QVERIFY(kept.count() < all.count());
+			QCOMPARE(kept, all.mid(all.count() - kept.count()));
+		}
+
+		void testTruncatesLongEntry() {
+			XmlRingBuffer buf;
+			buf.setCapacity(100);
+			buf.append(0, "<a/>");
+			buf.append(0, QString(1000, 'x'));
+
+			QStringList kept = texts(buf);
+			QCOMPARE(kept.count(), 1);
+			QVERIFY(kept[0].length() < 100);
+			QVERIFY(kept[0].startsWith("xxx"));
+		}
+
+		void testClear() {
+			XmlRingBuffer buf;
+			buf.setCapacity(100);
+			buf.append(0, "<a/>");
+			buf.clear();
+			QVERIFY(buf.entries().isEmpty());
+			QCOMPARE(buf.capacity(), 100);
+		}
+};
+
+QTTESTUTIL_REGISTER_TEST(XmlRingBufferTest);
+#include "xmlringbuffertest.moc"
@@ -852,12 +852,37 @@ UserList::~UserList()
 {
 }
 
+void UserList::append(UserListItem *i)
+{
+	QList<UserListItem*>::append(i);
+	index_.insert(i);
+}
+
+int UserList::removeAll(UserListItem *i)
+{
+	int n = QList<UserListItem*>::removeAll(i);
+	for(int k = 0; k < n; ++k)
+		index_.remove(i);
+	return n;
+}
+
+void UserList::clear()
+{
+	QList<UserListItem*>::clear();
+	index_.clear();
+}
+
 UserListItem *UserList::find(const XMPP::Jid &j)
 {
-	foreach(UserListItem* i, *this) {
-		if(i->jid().compare(j))
-			return i;
-	}
-	return 0;
+	return index_.find(j);
+}
+
+/**
+ * Returns the items without a resource which have the bare jid of \a j,
+ * and the items with the full jid \a j.
+ */
+QList<UserListItem*> UserList::findRelevant(const XMPP::Jid &j) const
+{
+	return index_.findRelevant(j);
 }
 
@@ -31,6 +31,7 @@
 #include "activity.h"
 #include "geolocation.h"
 #include "maybe.h"
+#include "jidindex.h"
 
 class AvatarFactory;
 namespace XMPP {
@@ -179,13 +180,23 @@ private:
 
 typedef QListIterator<UserListItem*> UserListIt;
 
+// items have to be added and removed with append(), removeAll() and clear(),
+// so that the jid index is kept up to date
 class UserList : public QList<UserListItem*>
 {
 public:
 	UserList();
 	~UserList();
 
+	void append(UserListItem *);
+	int removeAll(UserListItem *);
+	void clear();
+
 	UserListItem *find(const XMPP::Jid &);
+	QList<UserListItem*> findRelevant(const XMPP::Jid &) const;
+
+private:
+	JidIndex<UserListItem> index_;
 };
 
 #endif
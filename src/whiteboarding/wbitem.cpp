@@ -59,12 +59,13 @@ void WbItemMenu::destructSelf() {
  *   WbItem
  */
 
-WbItem::WbItem(SxeSession* session, QSvgRenderer* renderer, QDomElement node, WbScene* scene, WbWidget* widget) : QGraphicsSvgItem() {
+WbItem::WbItem(SxeSession* session, QDomElement node, WbScene* scene, WbWidget* widget) : QGraphicsSvgItem() {
 	// Store a pointer to the underlying session, scene and node
 	session_ = session;
 	scene_ = scene;
 	widget_ = widget;
 	node_ = node;
+	renderer_ = 0;
 
 	// qDebug() << QString("constructing %1.").arg(id()).toLatin1();
 
@@ -84,8 +85,9 @@ WbItem::WbItem(SxeSession* session, QSvgRenderer* renderer, QDomElement node, Wb
 	// Don't cache the SVG
 	setCachingEnabled(false);
 
-	// Set the renderer for the item
-	setSharedRenderer(renderer);
+	// Render the item on its own so that an edit only needs to rerender the items it touches
+	renderer_ = new QSvgRenderer(this);
+	setSharedRenderer(renderer_);
 
 	// add the new item to the scene
 	addToScene();
@@ -264,6 +266,7 @@ void WbItem::addToScene() {
 	}
 
 	// Only render the indicated item
+	loadSvg();
 	setElementId(id);
 
 	// Set the position
@@ -283,16 +286,33 @@ void WbItem::removeFromScene() {
 void WbItem::resetPos() {
 	// set the x & y approriately;
 	setPos(renderer()->boundsOnElement(id()).topLeft());
+}
+
+void WbItem::rerender() {
+	// items without an 'id' are loaded again when added back to the scene
+	if(scene() != scene_)
+		return;
+
+	loadSvg();
+	// resetting elementId is necessary for rendering some updates to the element (e.g. adding child elements to <g/>)
+	setElementId(id());
+	resetPos();
+	update();
+}
 
-	// set the drawing order
-	// TODO: optimize
-	int i = 0;
-	QDomNodeList children = node_.parentNode().childNodes();
-	while(children.at(i) != node_) {
-		i++;
+void WbItem::loadSvg() {
+	// The root element and its <defs/> may affect how the node is rendered
+	QDomDocument doc;
+	QDomElement root = session_->document().documentElement();
+	QDomNode svg = doc.importNode(root, false);
+	doc.appendChild(svg);
+	for(QDomNode n = root.firstChild(); !n.isNull(); n = n.nextSibling()) {
+		if(n.nodeName() == "defs" && n != node_)
+			svg.appendChild(doc.importNode(n, true));
 	}
+	svg.appendChild(doc.importNode(node_, true));
 
-	setZValue(i);
+	renderer_->load(doc.toByteArray());
 }
 
 WbItemMenu* WbItem::constructContextMenu() {
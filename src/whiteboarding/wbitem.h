@@ -64,7 +64,7 @@ public:
 	/*! \brief Constructor
 	 *  Constructs a new whiteboard item that visualized \a node.
 	 */
-	WbItem(SxeSession* session, QSvgRenderer* renderer, QDomElement node, WbScene* scene, WbWidget* widget);
+	WbItem(SxeSession* session, QDomElement node, WbScene* scene, WbWidget* widget);
 	/*! \brief Destructor
 	 *  Makes sure that the item gets deleted from the underlying <svg/> document
 	 */
@@ -84,8 +84,12 @@ public:
 	/*! \brief Removes the item from the scene. */
 	void removeFromScene();
 
-	/*! \brief Resets the position of the item according to the SVG and clears any QGraphicsItem transformations.*/
+	/*! \brief Resets the position of the item according to the SVG and clears any QGraphicsItem transformations.
+	 *  The drawing order is set by WbWidget which knows the position of every item.
+	 */
 	void resetPos();
+	/*! \brief Renders the node again after it or the <svg/> root was edited.*/
+	void rerender();
 
 	/*! \brief Returns a QTransform based on \a string provided in the SVG 'transform' attribute format.*/
 	static QMatrix parseSvgTransform(QString string);
@@ -109,6 +113,8 @@ private:
 	 WbItemMenu* constructContextMenu();
 	 /*! \brief Return the center of the item in item coordinates.*/
 	 QPointF center();
+	 /*! \brief Loads the node, along with the root <svg/> and its <defs/>, into renderer_.*/
+	 void loadSvg();
 
 	// The session that the item belongs to
 	SxeSession* session_;
@@ -118,6 +124,8 @@ private:
 	WbWidget* widget_;
 	// The node SVG node that's being visualized
 	QDomElement node_;
+	// The renderer for node_ alone
+	QSvgRenderer* renderer_;
 
 };
 
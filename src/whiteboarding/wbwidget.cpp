@@ -26,6 +26,9 @@
 #include <QMouseEvent>
 #include <QApplication>
 
+// Interval for coalescing the rendering of edits, in ms
+enum { RENDER_INTERVAL = 20 };
+
 WbWidget::WbWidget(SxeSession* session, QWidget *parent) : QGraphicsView(parent) {
 	newWbItem_ = 0;
 	adding_ = 0;
@@ -34,6 +37,13 @@ WbWidget::WbWidget(SxeSession* session, QWidget *parent) : QGraphicsView(parent)
 	fillColor_ = Qt::transparent;
 	strokeWidth_ = 1;
 	session_ = session;
+	dirtyAll_ = false;
+	dirtyOrder_ = false;
+
+	renderTimer_ = new QTimer(this);
+	renderTimer_->setSingleShot(true);
+	renderTimer_->setInterval(RENDER_INTERVAL);
+	connect(renderTimer_, SIGNAL(timeout()), SLOT(rerender()));
 
 //	setCacheMode(CacheBackground);
 	setRenderHint(QPainter::Antialiasing);
@@ -53,9 +63,7 @@ WbWidget::WbWidget(SxeSession* session, QWidget *parent) : QGraphicsView(parent)
 	setResizeAnchor(AnchorViewCenter);
 	setScene(scene_);
 
-	// render the initial document
-	rerender();
-	// rerender on update
+	// add and remove items on update
 	connect(session_, SIGNAL(documentUpdated(bool)), SLOT(handleDocumentUpdated(bool)));
 
 	// add the initial items
@@ -67,6 +75,8 @@ WbWidget::WbWidget(SxeSession* session, QWidget *parent) : QGraphicsView(parent)
 		}
 	}
 	inspectNodes();
+	updateZValues();
+	dirtyOrder_ = false;
 
 	// add new items as nodes are added
 	// remove/add items if corresponding nodes are moved
@@ -79,6 +89,11 @@ WbWidget::WbWidget(SxeSession* session, QWidget *parent) : QGraphicsView(parent)
 	connect(session_, SIGNAL(nodeAdded(QDomNode, bool)), SLOT(checkForViewBoxChange(QDomNode)));
 	connect(session_, SIGNAL(nodeMoved(QDomNode, bool)), SLOT(checkForViewBoxChange(QDomNode)));
 	connect(session_, SIGNAL(chdataChanged(QDomNode, bool)), SLOT(checkForViewBoxChange(QDomNode)));
+	// rerender the items touched by edits
+	connect(session_, SIGNAL(nodeAdded(QDomNode, bool)), SLOT(invalidateNode(QDomNode)));
+	connect(session_, SIGNAL(nodeMoved(QDomNode, bool)), SLOT(invalidateNode(QDomNode)));
+	connect(session_, SIGNAL(nodeToBeRemoved(QDomNode, bool)), SLOT(invalidateNode(QDomNode)));
+	connect(session_, SIGNAL(chdataChanged(QDomNode, bool)), SLOT(invalidateNode(QDomNode)));
 
 	// set the default mode to select
 	setMode(Select);
@@ -321,17 +336,12 @@ void WbWidget::mouseReleaseEvent(QMouseEvent * event) {
 }
 
 WbItem* WbWidget::wbItem(const QDomNode &node) {
-	foreach(WbItem* wbitem, items_) {
-		if(wbitem->node() == node)
-			return wbitem;
-	}
-	return 0;
+	return itemsByNode_.value(SxeSession::nodeKey(node));
 }
 
 void WbWidget::handleDocumentUpdated(bool remote) {
 	Q_UNUSED(remote);
 	inspectNodes();
-	rerender();
 }
 
 void WbWidget::inspectNodes() {
@@ -352,8 +362,11 @@ void WbWidget::inspectNodes() {
 		//			  or it doesn't exist and needs to be added
 		if(item)
 			removeWbItem(item);
-		else
-			items_.append(new WbItem(session_, &renderer_, node.toElement(), scene_, this));
+		else {
+			item = new WbItem(session_, node.toElement(), scene_, this);
+			items_.append(item);
+			itemsByNode_.insert(SxeSession::nodeKey(node), item);
+		}
 	}
 }
 
@@ -371,6 +384,8 @@ void WbWidget::removeWbItem(WbItem *wbitem) {
 		qDebug("delete WbItem");
 		// Remove from the lookup table to avoid infinite loop of deletes
 		items_.removeAll(wbitem);
+		itemsByNode_.remove(SxeSession::nodeKey(wbitem->node()));
+		dirtyItems_.remove(wbitem);
 		// items_.takeAt(items_.indexOf(wbitem));
 
 		idlessItems_.removeAll(wbitem);
@@ -414,22 +429,61 @@ void WbWidget::checkForRemovalOfId(QDomNode node) {
 	}
 }
 
-void WbWidget::rerender() {
-	QString xmldump;
-	QTextStream stream(&xmldump);
-	session_->document().save(stream, 1);
+void WbWidget::invalidateNode(const QDomNode &node) {
+	QDomElement root = session_->document().documentElement();
+	if(node == root || (node.isAttr() && node.parentNode() == root)) {
+		// the attributes of the root affect all items
+		dirtyAll_ = true;
+		scheduleRender();
+		return;
+	}
+
+	// find the child of the root that node belongs to
+	QDomNode top = node;
+	while(!top.isNull() && top.parentNode() != root)
+		top = top.parentNode();
+	if(top.isNull())
+		return;
 
-	// qDebug("Document in WbWidget:");
-	// qDebug() << xmldump.toLatin1();
+	// a child of the root was added, moved or is being removed
+	if(top == node)
+		dirtyOrder_ = true;
 
-	renderer_.load(xmldump.toLatin1());
+	if(top.nodeName() == "defs")
+		dirtyAll_ = true;
+	else if(WbItem* wbitem = wbItem(top))
+		dirtyItems_.insert(wbitem);
 
-	// Update all positions if changed
-	foreach(WbItem* wbitem, items_) {
-		// resetting elementId is necessary for rendering some updates to the element (e.g. adding child elements to <g/>)
-		wbitem->setElementId(wbitem->id());
+	scheduleRender();
+}
+
+void WbWidget::scheduleRender() {
+	if(!renderTimer_->isActive())
+		renderTimer_->start();
+}
+
+void WbWidget::updateZValues() {
+	int i = 0;
+	for(QDomNode node = session_->document().documentElement().firstChild(); !node.isNull(); node = node.nextSibling(), i++) {
+		WbItem* wbitem = wbItem(node);
+		if(wbitem)
+			wbitem->setZValue(i);
+	}
+}
+
+void WbWidget::rerender() {
+	if(dirtyAll_) {
+		foreach(WbItem* wbitem, items_)
+			wbitem->rerender();
+	} else {
+		foreach(WbItem* wbitem, dirtyItems_)
+			wbitem->rerender();
+	}
+	dirtyItems_.clear();
+	dirtyAll_ = false;
 
-		// qDebug() << QString("Rerendering %1").arg((unsigned int) wbitem).toLatin1();
-		wbitem->resetPos();
+	if(dirtyOrder_) {
+		updateZValues();
+		dirtyOrder_ = false;
 	}
 }
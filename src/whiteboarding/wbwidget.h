@@ -32,6 +32,7 @@
 #include <QGraphicsView>
 #include <QTimer>
 #include <QTime>
+#include <QSet>
 #include <QFileDialog>
 
 
@@ -93,6 +94,10 @@ protected:
 private:
 	/*! \brief Returns the item representing the node (if any).*/
 	WbItem* wbItem(const QDomNode &node);
+	/*! \brief Starts renderTimer_ unless it's already running.*/
+	void scheduleRender();
+	/*! \brief Sets the drawing order of the items according to the order of the nodes.*/
+	void updateZValues();
 
 	/*! \brief The SxeSession synchronizing the document.*/
 	SxeSession* session_;
@@ -109,6 +114,8 @@ private:
 
 	/*! \brief A list of existing WbItems */
     QList<WbItem*> items_;
+	/*! \brief The existing WbItems by SxeSession::nodeKey() of their nodes. */
+	QHash<const void*, WbItem*> itemsByNode_;
     // /*! \brief A list of WbItems to be deleted. */
     //     QList<WbItem*> deletionQueue_;
 	/*! \brief A list of QDomNode's that were added since last documentUpdated() signal received. */
@@ -121,8 +128,14 @@ private:
 	bool addVertex_;
 	/*! \brief Timer used for forcing the addition of a new vertex.*/
 	QTimer* adding_;
-	/*! \brief The primary renderer used for rendering the document.*/
-    QSvgRenderer renderer_;
+	/*! \brief The items touched by edits since the last rerender().*/
+	QSet<WbItem*> dirtyItems_;
+	/*! \brief True if the root <svg/> or its <defs/> were edited since the last rerender().*/
+	bool dirtyAll_;
+	/*! \brief True if children of the root <svg/> were added, moved or removed since the last rerender().*/
+	bool dirtyOrder_;
+	/*! \brief Timer used for coalescing the edits to one rerender() per frame.*/
+	QTimer* renderTimer_;
 
 private slots:
 	/*! \brief Tries to add 'id' attributes to nodes in deletionQueue_ if they still don't have them.*/
@@ -150,11 +163,13 @@ private slots:
      *  If so, the scene size is adjusted accordingly.
      */
     void checkForViewBoxChange(const QDomNode &node);
+	/*! \brief Marks the item that \a node belongs to for rerendering at the next frame.*/
+	void invalidateNode(const QDomNode &node);
     // /*! \brief Deletes the WbItem's in the deletion queue. */
     // void flushDeletionQueue();
 
 
-	/*! \brief Rerenders the contents of the document.*/
+	/*! \brief Rerenders the items touched by edits since the last call.*/
 	void rerender();
 };
 
@@ -47,6 +47,8 @@ public:
 	IconLabel *label;
 	PsiIcon *icon;
 	bool copyIcon;
+	bool outdated;
+	bool viewing; // the icon is activated while the label is visible
 #ifdef WIDGET_PLUGIN
 	QString iconName;
 #endif
@@ -56,6 +58,9 @@ public:
 		label = l;
 		icon = 0;
 		copyIcon = false;
+		outdated = false;
+		viewing = false;
+		label->installEventFilter(this);
 	}
 
 	~Private()
@@ -101,7 +106,7 @@ protected:
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
 			disconnect(icon, 0, this, 0);
-			icon->stop();
+			hideIcon();
 		}
 #endif
 	}
@@ -110,14 +115,63 @@ protected:
 	{
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
-			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconUpdated()));
-			icon->activated(false); // TODO: should icon play sound when it's activated on icon?
+			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconChanged()));
+			if ( label->isVisible() )
+				showIcon();
 		}
 		iconUpdated();
 #endif
 	}
 
+	// the animation of the icon only runs while it's shown somewhere
+	void showIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( !viewing ) {
+			icon->activated(false); // TODO: should icon play sound when it's activated on icon?
+			viewing = true;
+		}
+#endif
+	}
+
+	void hideIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( viewing ) {
+			icon->stop();
+			viewing = false;
+		}
+#endif
+	}
+
+	bool eventFilter(QObject *, QEvent *e)
+	{
+		if ( e->type() == QEvent::Show ) {
+			if ( icon )
+				showIcon();
+			if ( outdated ) {
+				outdated = false;
+				iconUpdated();
+			}
+		}
+		else if ( e->type() == QEvent::Hide && icon ) {
+			hideIcon();
+		}
+		return false;
+	}
+
 private slots:
+	// animation frames aren't rendered while the label is hidden,
+	// it's updated when shown again
+	void iconChanged()
+	{
+		if ( !label->isVisible() ) {
+			outdated = true;
+			return;
+		}
+		iconUpdated();
+	}
+
 	void iconUpdated()
 	{
 #ifndef WIDGET_PLUGIN
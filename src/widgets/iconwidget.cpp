@@ -27,6 +27,7 @@
 #include <QApplication>
 #include <QPainter>
 #include <QBrush>
+#include <QEvent>
 
 #ifndef WIDGET_PLUGIN
 #	include "iconset.h"
@@ -528,6 +529,8 @@ public:
 	IconButton *button;
 	bool textVisible;
 	bool activate, forced;
+	bool outdated;
+	bool viewing; // the icon is activated while the button is visible
 #ifdef WIDGET_PLUGIN
 	QString iconName;
 #endif
@@ -539,6 +542,9 @@ public:
 		button = b;
 		textVisible = true;
 		forced = false;
+		outdated = false;
+		viewing = false;
+		button->installEventFilter(this);
 	}
 
 	~Private()
@@ -562,9 +568,11 @@ public:
 	{
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
-			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconUpdated()));
-			if ( activate )
+			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconChanged()));
+			if ( activate && button->isVisible() ) {
 				icon->activated(true); // FIXME: should icon play sound when it's activated on button?
+				viewing = true;
+			}
 		}
 
 		updateIcon();
@@ -576,8 +584,7 @@ public:
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
 			disconnect(icon, 0, this, 0 );
-			if ( activate )
-				icon->stop();
+			hideIcon();
 
 			delete icon;
 			icon = 0;
@@ -595,7 +602,55 @@ public:
 		iconUpdated();
 	}
 
+	// the animation of the icon only runs while it's shown somewhere
+	void showIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( activate && !viewing ) {
+			icon->activated(false);
+			viewing = true;
+		}
+#endif
+	}
+
+	void hideIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( viewing ) {
+			icon->stop();
+			viewing = false;
+		}
+#endif
+	}
+
+	bool eventFilter(QObject *, QEvent *e)
+	{
+		if ( e->type() == QEvent::Show ) {
+			if ( icon )
+				showIcon();
+			if ( outdated ) {
+				outdated = false;
+				iconUpdated();
+			}
+		}
+		else if ( e->type() == QEvent::Hide && icon ) {
+			hideIcon();
+		}
+		return false;
+	}
+
 public slots:
+	// animation frames aren't rendered while the button is hidden,
+	// it's updated when shown again
+	void iconChanged()
+	{
+		if ( !button->isVisible() ) {
+			outdated = true;
+			return;
+		}
+		iconUpdated();
+	}
+
 	void iconUpdated()
 	{
 		button->setUpdatesEnabled(false);
@@ -702,6 +757,8 @@ public:
 	PsiIcon *icon;
 	IconToolButton *button;
 	bool activate;
+	bool outdated;
+	bool viewing; // the icon is activated while the button is visible
 #ifdef WIDGET_PLUGIN
 	QString iconName;
 #endif
@@ -711,6 +768,9 @@ public:
 	{
 		icon = 0;
 		button = b;
+		outdated = false;
+		viewing = false;
+		button->installEventFilter(this);
 	}
 
 	~Private()
@@ -734,9 +794,11 @@ public:
 	{
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
-			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconUpdated()));
-			if ( activate )
+			connect(icon, SIGNAL(pixmapChanged()), SLOT(iconChanged()));
+			if ( activate && button->isVisible() ) {
 				icon->activated(true); // FIXME: should icon play sound when it's activated on button?
+				viewing = true;
+			}
 		}
 		iconUpdated();
 #endif
@@ -747,8 +809,7 @@ public:
 #ifndef WIDGET_PLUGIN
 		if ( icon ) {
 			disconnect(icon, 0, this, 0 );
-			if ( activate )
-				icon->stop();
+			hideIcon();
 
 			delete icon;
 			icon = 0;
@@ -761,7 +822,55 @@ public:
 		iconUpdated();
 	}
 
+	// the animation of the icon only runs while it's shown somewhere
+	void showIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( activate && !viewing ) {
+			icon->activated(false);
+			viewing = true;
+		}
+#endif
+	}
+
+	void hideIcon()
+	{
+#ifndef WIDGET_PLUGIN
+		if ( viewing ) {
+			icon->stop();
+			viewing = false;
+		}
+#endif
+	}
+
+	bool eventFilter(QObject *, QEvent *e)
+	{
+		if ( e->type() == QEvent::Show ) {
+			if ( icon )
+				showIcon();
+			if ( outdated ) {
+				outdated = false;
+				iconUpdated();
+			}
+		}
+		else if ( e->type() == QEvent::Hide && icon ) {
+			hideIcon();
+		}
+		return false;
+	}
+
 private slots:
+	// animation frames aren't rendered while the button is hidden,
+	// it's updated when shown again
+	void iconChanged()
+	{
+		if ( !button->isVisible() ) {
+			outdated = true;
+			return;
+		}
+		iconUpdated();
+	}
+
 	void iconUpdated()
 	{
 		button->setUpdatesEnabled(false);
@@ -399,6 +399,19 @@ void PsiRichText::appendText(QTextDocument *doc, QTextCursor &cursor, const QStr
 	cursor.endEditBlock();
 }
 
+/**
+ * Inserts text at the position of the cursor, without starting a new
+ * paragraph.
+ * \param text text to insert to the QTextDocument. Please note that if you
+ *             insert any <icon>s, attributes' values MUST be Qt::escaped.
+ */
+void PsiRichText::insertText(QTextDocument *doc, QTextCursor &cursor, const QString &text)
+{
+	cursor.beginEditBlock();
+	appendTextHelper(doc, text, cursor);
+	cursor.endEditBlock();
+}
+
 /**
  * Call this function on your QTextDocument to get plain text
  * representation, and all Icons will be replaced by their
@@ -31,6 +31,7 @@ public:
 	static void setText(QTextDocument *doc, const QString &text);
 	static void insertIcon(QTextCursor &cursor, const QString &iconName, const QString &iconText);
 	static void appendText(QTextDocument *doc, QTextCursor &cursor, const QString &text);
+	static void insertText(QTextDocument *doc, QTextCursor &cursor, const QString &text);
 	static QString convertToPlainText(const QTextDocument *doc);
 	static void addEmoticon(QTextEdit *textEdit, const QString &emoticon);
 	static void setAllowedImageDirs(const QStringList &);
@@ -0,0 +1,120 @@
+/*
+ * xmlringbuffer.cpp - bounded buffer of the recent xml traffic of an account
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include "xmlringbuffer.h"
+
+#include <string.h>
+
+XmlRingBuffer::XmlRingBuffer()
+	: head_(0)
+	, used_(0)
+{
+}
+
+int XmlRingBuffer::capacity() const
+{
+	return buf_.size();
+}
+
+/**
+ * Allocates a buffer of \a bytes and drops the current contents.
+ */
+void XmlRingBuffer::setCapacity(int bytes)
+{
+	if (bytes > int(sizeof(Header)))
+		buf_ = QByteArray(bytes, '\0');
+	else
+		buf_ = QByteArray();
+	clear();
+}
+
+void XmlRingBuffer::append(int type, const QString &xml)
+{
+	const int max = buf_.size() - int(sizeof(Header));
+	if (max <= 0)
+		return;
+
+	Header h;
+	h.time = QDateTime::currentMSecsSinceEpoch();
+	h.type = type;
+	h.size = qMin(xml.size() * int(sizeof(QChar)), max & ~1);
+	const int len = sizeof(Header) + h.size;
+
+	// drop the oldest entries to make room
+	while (used_ + len > buf_.size()) {
+		Header old;
+		read(head_, reinterpret_cast<char*>(&old), sizeof(Header));
+		head_ = (head_ + sizeof(Header) + old.size) % buf_.size();
+		used_ -= sizeof(Header) + old.size;
+	}
+
+	const int tail = (head_ + used_) % buf_.size();
+	write(tail, reinterpret_cast<const char*>(&h), sizeof(Header));
+	write((tail + sizeof(Header)) % buf_.size(), reinterpret_cast<const char*>(xml.unicode()), h.size);
+	used_ += len;
+}
+
+/**
+ * Returns the entries in the buffer, oldest first.
+ */
+QList<XmlRingBuffer::Entry> XmlRingBuffer::entries() const
+{
+	QList<Entry> list;
+	int pos = head_;
+	int left = used_;
+	while (left > 0) {
+		Header h;
+		read(pos, reinterpret_cast<char*>(&h), sizeof(Header));
+		pos = (pos + sizeof(Header)) % buf_.size();
+
+		Entry e;
+		e.type = h.type;
+		e.time = QDateTime::fromMSecsSinceEpoch(h.time);
+		e.xml.resize(h.size / sizeof(QChar));
+		read(pos, reinterpret_cast<char*>(e.xml.data()), h.size);
+		list += e;
+
+		pos = (pos + h.size) % buf_.size();
+		left -= sizeof(Header) + h.size;
+	}
+	return list;
+}
+
+void XmlRingBuffer::clear()
+{
+	head_ = 0;
+	used_ = 0;
+}
+
+void XmlRingBuffer::write(int pos, const char *data, int len)
+{
+	const int first = qMin(len, buf_.size() - pos);
+	char *buf = buf_.data();
+	memcpy(buf + pos, data, first);
+	memcpy(buf, data + first, len - first);
+}
+
+void XmlRingBuffer::read(int pos, char *data, int len) const
+{
+	const int first = qMin(len, buf_.size() - pos);
+	const char *buf = buf_.constData();
+	memcpy(data, buf + pos, first);
+	memcpy(data + first, buf, len - first);
+}
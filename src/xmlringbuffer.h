@@ -0,0 +1,70 @@
+/*
+ * xmlringbuffer.h - bounded buffer of the recent xml traffic of an account
+ * Copyright (C) 2026  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef XMLRINGBUFFER_H
+#define XMLRINGBUFFER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+/**
+ * Keeps the most recent xml of a stream in a buffer of a fixed number of
+ * bytes, which is allocated once.  The text is copied in as it is and
+ * only turned into entries when entries() is called, so appending doesn't
+ * allocate.  A capacity of 0 disables the buffer.
+ */
+class XmlRingBuffer
+{
+public:
+	struct Entry
+	{
+		int type;
+		QDateTime time;
+		QString xml;
+	};
+
+	XmlRingBuffer();
+
+	int capacity() const;
+	void setCapacity(int bytes);
+
+	void append(int type, const QString &xml);
+	QList<Entry> entries() const;
+	void clear();
+
+private:
+	struct Header
+	{
+		qint64 time;
+		qint32 type;
+		qint32 size;
+	};
+
+	QByteArray buf_;
+	int head_;
+	int used_;
+
+	void write(int pos, const char *data, int len);
+	void read(int pos, char *data, int len) const;
+};
+
+#endif
@@ -247,9 +247,15 @@ window[chatServer.jsNamespace()].util.updateObject(window[chatServer.jsNamespace
 			var ip = server.cache("Info.plist");
 			var prevGrouppingData = null;
 			var groupping = !(ip.DisableCombineConsecutive == true);
+			var scrollback = new chat.Scrollback(document.getElementById("Chat"), session);
+			var inBatch = false;
+			var scrollAfterBatch = false;
 
 			chat.adapter.receiveObject = function(data) {
 				cdata = data;
+				if (data.type == "message") {
+					scrollback.beginMessage();
+				}
 				try {
 					//chat.console(chat.util.props(data, true))
 					var template;
@@ -322,17 +328,71 @@ window[chatServer.jsNamespace()].util.updateObject(window[chatServer.jsNamespace
 								appendMessage(template.toString(data));
 							}
 							if (data.mtype == "message" && data.local) {
-								scrollToBottom();
+								if (inBatch) {
+									scrollAfterBatch = true;
+								} else {
+									scrollToBottom();
+								}
 							}
 						} else {
 							throw "Template not found";
 						}
+					} else if (data.type == "trim") {
+						if (nearBottom()) {
+							var count = scrollback.trim(data.keep);
+							if (count) {
+								session.messagesTrimmed(count);
+							}
+						}
+					} else if (data.type == "history") {
+						var htmls = [], i, m;
+						for (i = 0; i < data.messages.length; i++) {
+							m = data.messages[i];
+							if (m.mtype == "lastDate") {
+								m["message"] = m["date"];
+								m["time"] = "&nbsp; &nbsp; &nbsp; &nbsp; &nbsp;";
+								m.messageClasses = "event date_separator";
+								template = templates.status;
+							} else {
+								m.messageClasses = (m.local?"outgoing" : "incoming") + " history message";
+								template = m.local?templates.outgoingContent:templates.incomingContent;
+							}
+							htmls.push(template.toString(m));
+						}
+						scrollback.prepend(htmls);
 					} else if (data.type == "clear") {
 						prevGrouppingData = null; //groupping impossible
+						scrollback.clear();
 						trackbar = null;
 					}
 				} catch(e) {
 					chat.util.showCriticalError("APPEND ERROR: " + e + " \nline: " + e.line)
+				} finally {
+					if (data.type == "message") {
+						scrollback.endMessage();
+					}
+				}
+			};
+
+			// Unlike the psi adapter, messages are not put together in a
+			// DocumentFragment here. They are inserted by appendMessage() and
+			// appendNextMessage() of the theme's Template.html, which know where
+			// consecutive messages go, and may hold them back in a fragment of
+			// their own (the bundled Template.html does), so the adapter can't
+			// insert anything itself without breaking the order. A batch only
+			// scrolls once, after the last message.
+			chat.adapter.receiveObjects = function(list) {
+				inBatch = true;
+				scrollAfterBatch = false;
+				try {
+					for (var i = 0; i < list.length; i++) {
+						chat.adapter.receiveObject(list[i]);
+					}
+				} finally {
+					inBatch = false;
+					if (scrollAfterBatch) {
+						scrollToBottom();
+					}
 				}
 			};
 
@@ -20,6 +20,8 @@ window[chatServer.jsNamespace()].adapter = {
 			accountId : window.chatSession.account(),
 			dateFormat : "hh:mm:ss",
 			scroller : null,
+			scrollback : null,
+			batch : null, // fragment the messages go to in receiveObjects()
 			varHandlers : {},
 			prevGrouppingData : null,
 			groupping : false,
@@ -59,9 +61,24 @@ window[chatServer.jsNamespace()].adapter = {
 				if (nextEl) {
 					chat.util.siblingHtml(nextEl, html);
 				} else {
-					chat.util.appendHtml(shared.chatElement, html);
+					chat.util.appendHtml(shared.batch || shared.chatElement, html);
+				}
+				if (!shared.batch) {
+					shared.scroller.invalidate();
+				}
+			},
+
+			// looks in the document and in the batch not in it yet
+			findElement : function(id) {
+				return document.getElementById(id) ||
+					(shared.batch && shared.batch.querySelector("#" + id));
+			},
+
+			flushBatch : function() {
+				if (shared.batch && shared.batch.firstChild) {
+					shared.chatElement.appendChild(shared.batch);
+					shared.scroller.invalidate();
 				}
-				shared.scroller.invalidate();
 			},
 
 			stopGroupping : function() {
@@ -80,6 +97,7 @@ window[chatServer.jsNamespace()].adapter = {
 				shared.chatElement = config.chatElement;
 				shared.dateFormat = config.dateFormat || shared.dateFormat;
 				shared.scroller = config.scroller || new chat.WindowScroller(false);
+				shared.scrollback = new chat.Scrollback(shared.chatElement, shared.session);
 				shared.groupping = config.groupping || shared.groupping;
 				proxy = config.proxy;
 				shared.varHandlers = config.varHandlers || {};
@@ -172,6 +190,9 @@ window[chatServer.jsNamespace()].adapter = {
 				chat.util.showCriticalError("A try to output data while theme is not inited. output is impossible.\nCheck if your theme does not have errors.");
 				return;
 			}
+			if (data.type == "message") {
+				shared.scrollback.beginMessage(shared.batch);
+			}
 			try {
 				//shared.server.console(chat.util.props(data, true))
 				var template;
@@ -218,13 +239,16 @@ window[chatServer.jsNamespace()].adapter = {
 							shared.prevGrouppingData.nextEl:null); //force scroll on local messages
 						shared.stopGroupping();// safe clean up previous data
 						if (shared.cdata.nextEl) { //convert to DOM
-							shared.cdata.nextEl = document.getElementById(shared.cdata.nextEl);
+							shared.cdata.nextEl = shared.findElement(shared.cdata.nextEl);
 							shared.prevGrouppingData = shared.cdata;
 						}
 					} else {
 						throw "Template not found";
 					}
 				} else if (data.type == "trackbar") {
+					if (trackbar && trackbar.parentNode != shared.chatElement) {
+						trackbar = null; // trimmed
+					}
 					if (!trackbar) {
 						trackbar = document.createElement("div");
 						trackbar.innerHTML = shared.templates.trackbar.toString();
@@ -234,13 +258,60 @@ window[chatServer.jsNamespace()].adapter = {
 					shared.chatElement.appendChild(trackbar);
 					shared.scroller.invalidate();
 					shared.stopGroupping(); //groupping impossible
+				} else if (data.type == "trim") {
+					if (shared.scroller.atBottom) {
+						var count = shared.scrollback.trim(data.keep);
+						if (count) {
+							if (trackbar && trackbar.parentNode != shared.chatElement) {
+								trackbar = null;
+							}
+							shared.session.messagesTrimmed(count);
+						}
+					}
+				} else if (data.type == "history") {
+					var htmls = [], i, placeholders = [];
+					for (i = 0; i < data.messages.length; i++) {
+						shared.cdata = data.messages[i];
+						template = shared.cdata.mtype == "lastDate"? shared.templates.lastMsgDate :
+							(shared.cdata.local?shared.templates.sentMessage:shared.templates.receivedMessage);
+						htmls.push(template.toString());
+						if (shared.cdata.nextEl) { // no groupping with older messages
+							placeholders.push(shared.cdata.nextEl);
+						}
+					}
+					shared.scrollback.prepend(htmls);
+					for (i = 0; i < placeholders.length; i++) {
+						chat.util.ensureDeleted(placeholders[i]);
+					}
 				} else if (data.type == "clear") {
 					shared.stopGroupping(); //groupping impossible
 					shared.chatElement.innerHTML = "";
+					shared.scrollback.clear();
 					trackbar = null;
 				}
 			} catch(e) {
 				chat.util.showCriticalError("APPEND ERROR: " + e + " \nline: " + e.line)
+			} finally {
+				if (data.type == "message") {
+					shared.scrollback.endMessage(shared.batch);
+				}
+			}
+		};
+
+		// consecutive messages are put together in a fragment, which goes to
+		// the document at once. everything else needs them in the document
+		chat.adapter.receiveObjects = function(list) {
+			shared.batch = document.createDocumentFragment();
+			try {
+				for (var i = 0; i < list.length; i++) {
+					if (list[i].type != "message") {
+						shared.flushBatch();
+					}
+					chat.adapter.receiveObject(list[i]);
+				}
+				shared.flushBatch();
+			} finally {
+				shared.batch = null;
 			}
 		};
 
@@ -6,6 +6,12 @@ window[chatServer.jsNamespace()] = function() {
 		adapter : {
 			receiveObject : function(data) {
 				chat.util.showCriticalError("Adapter is not loaded. output impossible!\n\nData was:" + chat.util.props(data));
+			},
+			// all objects sent in one go. adapters may render them together
+			receiveObjects : function(list) {
+				for (var i = 0; i < list.length; i++) {
+					chat.adapter.receiveObject(list[i]);
+				}
 			}
 		},
 		util: {
@@ -186,6 +192,70 @@ window[chatServer.jsNamespace()] = function() {
 				o.atBottom = true;
 				o.invalidate();
 			}
+		},
+
+		// Remembers where each message starts in container, so the oldest
+		// ones can be trimmed and older history put before all others.
+		// Tells session when the view is scrolled to the top.
+		Scrollback : function(container, session) {
+			var o=this, starts = [], last = null;
+
+			window.addEventListener("scroll", function() {
+				if (window.pageYOffset == 0 && starts.length) {
+					session.scrolledToTop();
+				}
+			}, false);
+
+			//EXTERNAL API
+			// call before and after each message is appended, to container or
+			// to target which goes to its end later
+			o.beginMessage = function(target) {
+				last = (target || container).lastChild;
+			}
+
+			o.endMessage = function(target) {
+				target = target || container;
+				// null if it went into a node of a previous message (groupping)
+				starts.push(target.lastChild == last? null :
+					(last? last.nextSibling : target.firstChild));
+			}
+
+			// removes the oldest messages so that about keep are left, and
+			// returns how many were removed. messages in one node go together
+			o.trim = function(keep) {
+				var n = starts.length - keep;
+				while (n > 0 && n < starts.length && !starts[n]) n++;
+				if (n <= 0 || n >= starts.length) {
+					return 0;
+				}
+				while (container.firstChild != starts[n]) {
+					container.removeChild(container.firstChild);
+				}
+				starts.splice(0, n);
+				return n;
+			}
+
+			// puts html of each of older messages before all others, and keeps
+			// the view where it was
+			o.prepend = function(htmls) {
+				var first = container.firstChild, added = [], height = document.height;
+				for (var i = 0; i < htmls.length; i++) {
+					var prev = first? first.previousSibling : container.lastChild;
+					if (first) {
+						chat.util.siblingHtml(first, htmls[i]);
+					} else {
+						chat.util.appendHtml(container, htmls[i]);
+					}
+					var start = prev? prev.nextSibling : container.firstChild;
+					added.push(start == first? null : start);
+				}
+				starts = added.concat(starts);
+				window.scrollBy(0, document.height - height);
+			}
+
+			o.clear = function() {
+				starts = [];
+			}
 		}
 	}
 	return chat;